@@ -0,0 +1,58 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// CPU feature detection for the vectorized kernels.
+//
+// Modules with kernels for several instruction sets build all of them and pick the best one for the CPU the program runs on.
+// On x86 each kernel is compiled for its extensions with LW_CPU_TARGET, so the library needs no -m flags and still runs on CPUs
+// without them.
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#include <immintrin.h>
+	#define LW_CPU_X86
+	#define LW_CPU_TARGET(Features) __attribute__((target(Features)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+	#include <immintrin.h>
+	#define LW_CPU_X86
+	#define LW_CPU_TARGET(Features)
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define LW_CPU_NEON
+#endif
+
+// NOTE: Runs Function before main, so the kernels are selected and their tables built before any call, and no call needs to
+// check for initialization.
+#define LW_CPU_INITIALIZER(Function) static struct Function##Initializer { Function##Initializer() { Function(); } } Function##Instance
+
+#if defined(LW_CPU_X86)
+inline bool lwCpuHasAvx2() {
+#if defined(__GNUC__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#else
+	int info[4];
+	__cpuid(info, 1);
+
+	// NOTE: The OS must also save the AVX registers on context switches.
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 0x6) != 0x6) {
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+// Carry-less multiply with the SSSE3 byte shuffle.
+inline bool lwCpuHasPclmul() {
+#if defined(__GNUC__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+#else
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 1)) && (info[2] & (1 << 9));
+#endif
+}
+#endif
\ No newline at end of file
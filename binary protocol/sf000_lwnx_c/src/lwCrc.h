@@ -0,0 +1,47 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// CRC-16-CCITT (polynomial 0x1021, initial value 0) as used by the LWNX protocol.
+//
+// Several interchangeable implementations are provided. lwCrc16 selects the fastest one supported by the CPU at startup.
+// Define LW_CRC_SMALL to build only the 256 entry table, which is what small targets should use.
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__AVR__)
+	#define LW_CRC_SMALL
+#endif
+
+// Every implementation continues the CRC from Crc over Size bytes of Data, so a CRC can be built up in pieces.
+typedef uint16_t (*lwCrc16Func)(uint16_t Crc, const uint8_t* Data, uint32_t Size);
+
+// Reference implementation, one byte per iteration without a table.
+uint16_t lwCrc16Bitwise(uint16_t Crc, const uint8_t* Data, uint32_t Size);
+
+// One byte per iteration using a 256 entry table.
+uint16_t lwCrc16Table(uint16_t Crc, const uint8_t* Data, uint32_t Size);
+
+#ifndef LW_CRC_SMALL
+// Four and eight bytes per iteration using slicing tables.
+uint16_t lwCrc16Slice4(uint16_t Crc, const uint8_t* Data, uint32_t Size);
+uint16_t lwCrc16Slice8(uint16_t Crc, const uint8_t* Data, uint32_t Size);
+
+// Folds 64 bytes per iteration using carry-less multiply (PCLMULQDQ on x86, PMULL on ARMv8).
+// Only valid when lwCrc16FoldSupported returns true.
+uint16_t lwCrc16Fold(uint16_t Crc, const uint8_t* Data, uint32_t Size);
+bool lwCrc16FoldSupported();
+#endif
+
+// Table used by lwCrc16Byte.
+extern uint16_t lwCrc16ByteTable[256];
+
+// Continues the CRC over a single byte.
+inline uint16_t lwCrc16Byte(uint16_t Crc, uint8_t Data) {
+	return (uint16_t)(Crc << 8) ^ lwCrc16ByteTable[(Crc >> 8) ^ Data];
+}
+
+// Continues the CRC using the fastest implementation for the CPU and data size.
+uint16_t lwCrc16(uint16_t Crc, const uint8_t* Data, uint32_t Size);
+
+// Name of the implementation lwCrc16 uses for large buffers.
+const char* lwCrc16ImplementationName();
\ No newline at end of file
@@ -4,22 +4,7 @@ lwResponsePacket::lwResponsePacket() : size(0), payloadSize(0), parseState(0) {
 
 uint16_t lwnxCreateCrc(uint8_t* Data, uint16_t Size)
 {
-	uint16_t crc = 0;
-
-	for (uint32_t i = 0; i < Size; ++i)
-	{
-		uint16_t code = crc >> 8;
-		code ^= Data[i];
-		code ^= code >> 4;
-		crc = crc << 8;
-		crc ^= code;
-		code = code << 5;
-		crc ^= code;
-		code = code << 7;
-		crc ^= code;
-	}
-
-	return crc;
+	return lwCrc16(0, Data, Size);
 }
 
 void lwnxConvertFirmwareVersionToStr(uint32_t Version, char* String) {
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "common.h"
+#include "lwCrc.h"
 
 #define PACKET_START_BYTE	0xAA
 #define PACKET_TIMEOUT		200
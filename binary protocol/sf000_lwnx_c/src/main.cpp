@@ -42,13 +42,18 @@ int main(int args, char **argv)
 	
 	printf("LWNX sample\n");
 
-	// NOTE: Change the port name to the one assigned by the OS to the plugged in lidar.
+	// NOTE: Change the port name to the one assigned by the OS to the plugged in lidar, or pass it as the first argument,
+	// like the pseudo terminal of the emulator.
 #ifdef __linux__
 	const char* portName = "/dev/ttyUSB0";
 #else
 	const char* portName = "\\\\.\\COM4";
 #endif
 
+	if (args > 1) {
+		portName = argv[1];
+	}
+
 	int32_t baudRate = 921600;
 
 	lwSerialPort* serial = platformCreateSerialPort();
@@ -0,0 +1,1007 @@
+//-------------------------------------------------------------------------
+// LightWare LWNX C Benchmark
+//
+// Measures the C implementation of the protocol without a device. CRC
+// and parsing run over synthetic SF11 waveform streams, clean and with
+// line noise, or over a capture recorded by the sf45_lwnx_c library.
+// Command round trips and streaming latency are measured over a pseudo
+// terminal, with a thread on the other side playing the device.
+//
+// Every result is also printed as a line of name,value,unit at the end,
+// and written to a file with -o, so runs can be compared.
+//-------------------------------------------------------------------------
+
+// NOTE: For posix_openpt and ptsname_r.
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <termios.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <math.h>
+#include "time.h"
+
+#include "lwnx.h"
+#include "lwWaveform.h"
+#include "lwEcho.h"
+#include "lwStack.h"
+
+// NOTE: Not in lwnx.h, the receive functions are its only users.
+uint8_t lwnxParseData(lwResponsePacket* Response, uint8_t Data);
+
+// Samples per Command 32 packet, and per synthetic waveform.
+#define WAVEFORM_BATCH		32
+#define WAVEFORM_SAMPLES	1450
+// Size of the header of a capture from the sf45_lwnx_c library, before the received bytes.
+#define CAPTURE_HEADER_SIZE	16
+#define CAPTURE_MAGIC		0x5043574C
+// Most results kept for the machine readable output.
+#define MAX_RESULTS			64
+
+//-------------------------------------------------------------------------
+// Platform Implementation.
+//-------------------------------------------------------------------------
+int g_serialPortFd = -1;
+
+int64_t getTimeMicroseconds() {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+
+	return (int64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+int32_t getTimeMilliseconds() {
+	return (int32_t)(getTimeMicroseconds() / 1000);
+}
+
+int portWrite(uint8_t* Buffer, int32_t BufferSize) {
+	return write(g_serialPortFd, Buffer, BufferSize);
+}
+
+int portRead(uint8_t* Buffer, int32_t BufferSize) {
+	return read(g_serialPortFd, Buffer, BufferSize);
+}
+
+int32_t portWait(int32_t TimeoutMs) {
+	struct pollfd descriptor = {};
+	descriptor.fd = g_serialPortFd;
+	descriptor.events = POLLIN;
+
+	return poll(&descriptor, 1, TimeoutMs);
+}
+
+// Opens a pseudo terminal and connects the serial port callbacks to its
+// slave side. Returns the master side, for the device thread.
+int openLoopback() {
+	char slaveName[64];
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 || ptsname_r(master, slaveName, sizeof(slaveName)) != 0) {
+		printf("Couldn't create pseudo terminal!\n");
+		return -1;
+	}
+
+	g_serialPortFd = open(slaveName, O_RDWR | O_NOCTTY);
+
+	if (g_serialPortFd < 0) {
+		printf("Couldn't open %s\n", slaveName);
+		close(master);
+		return -1;
+	}
+
+	struct termios tty;
+	tcgetattr(master, &tty);
+	cfmakeraw(&tty);
+	tcsetattr(master, TCSANOW, &tty);
+	tcgetattr(g_serialPortFd, &tty);
+	cfmakeraw(&tty);
+	// NOTE: Reads return immediately, waiting for data is done with poll.
+	tty.c_cc[VMIN] = 0;
+	tty.c_cc[VTIME] = 0;
+	tcsetattr(g_serialPortFd, TCSANOW, &tty);
+
+	return master;
+}
+
+void closeLoopback(int Master) {
+	close(g_serialPortFd);
+	g_serialPortFd = -1;
+	close(Master);
+}
+
+void initEndpoint(lwEndpoint* Endpoint) {
+	memset(Endpoint, 0, sizeof(lwEndpoint));
+	Endpoint->writeCallback = portWrite;
+	Endpoint->readCallback = portRead;
+	Endpoint->timeCallback = getTimeMilliseconds;
+	Endpoint->waitCallback = portWait;
+}
+
+//-------------------------------------------------------------------------
+// Results.
+//-------------------------------------------------------------------------
+typedef struct {
+	char name[64];
+	double value;
+	const char* unit;
+
+} benchmarkResult;
+
+benchmarkResult g_results[MAX_RESULTS];
+int32_t g_resultCount = 0;
+
+// Keeps a result for the machine readable output. Names are dotted, like parser.clean.buffer4096.
+void addResult(const char* Name, double Value, const char* Unit) {
+	if (g_resultCount == MAX_RESULTS) {
+		return;
+	}
+
+	snprintf(g_results[g_resultCount].name, sizeof(g_results[g_resultCount].name), "%s", Name);
+	g_results[g_resultCount].value = Value;
+	g_results[g_resultCount].unit = Unit;
+	++g_resultCount;
+}
+
+void writeResults(FILE* File) {
+	fprintf(File, "# waveform=%s echo=%s\n", lwWaveformImplementationName(), lwEchoImplementationName());
+	fprintf(File, "name,value,unit\n");
+
+	for (int32_t i = 0; i < g_resultCount; ++i) {
+		fprintf(File, "%s,%.3f,%s\n", g_results[i].name, g_results[i].value, g_results[i].unit);
+	}
+}
+
+static int compareInt64(const void* A, const void* B) {
+	int64_t a = *(const int64_t*)A;
+	int64_t b = *(const int64_t*)B;
+
+	return (a > b) - (a < b);
+}
+
+// Sorts Values and adds its median, 90th and 99th percentile and maximum as Name.p50 and so on.
+void addPercentiles(const char* Name, int64_t* Values, int32_t Count, const char* Unit) {
+	if (Count == 0) {
+		return;
+	}
+
+	qsort(Values, Count, sizeof(int64_t), compareInt64);
+
+	const char* suffixes[] = { "p50", "p90", "p99", "max" };
+	int64_t values[] = { Values[Count / 2], Values[Count * 9 / 10], Values[Count * 99 / 100], Values[Count - 1] };
+	char name[64];
+
+	printf("  %-24s p50 %6lld  p90 %6lld  p99 %6lld  max %6lld %s  (%d samples)\n", Name, (long long)values[0], (long long)values[1],
+		(long long)values[2], (long long)values[3], Unit, Count);
+
+	for (int32_t i = 0; i < 4; ++i) {
+		snprintf(name, sizeof(name), "%s.%s", Name, suffixes[i]);
+		addResult(name, (double)values[i], Unit);
+	}
+}
+
+//-------------------------------------------------------------------------
+// Synthetic data.
+//-------------------------------------------------------------------------
+// Writes a complete packet to Buffer and returns its size.
+int32_t writePacket(uint8_t* Buffer, uint8_t CommandId, uint8_t* Data, uint32_t DataSize) {
+	uint32_t payloadLength = 1 + DataSize;
+	uint16_t flags = (payloadLength << 6) | 0x1;
+
+	Buffer[0] = PACKET_START_BYTE;
+	Buffer[1] = flags & 0xFF;
+	Buffer[2] = (flags >> 8) & 0xFF;
+	Buffer[3] = CommandId;
+	memcpy(Buffer + 4, Data, DataSize);
+
+	uint16_t crc = lwnxCreateCrc(Buffer, 4 + DataSize);
+	Buffer[4 + DataSize] = crc & 0xFF;
+	Buffer[5 + DataSize] = (crc >> 8) & 0xFF;
+
+	return 6 + DataSize;
+}
+
+// Sample Index of a waveform with a noise floor and two echoes, the
+// first sample carrying the start flag.
+uint16_t getWaveformSample(int32_t Index) {
+	double near = Index - 180.0;
+	double far = Index - 920.0;
+	double value = 400.0 + (rand() % 64) + 9000.0 * exp(-near * near / 18.0) + 3000.0 * exp(-far * far / 18.0);
+
+	return (uint16_t)value | (Index == 0 ? 0x8000 : 0);
+}
+
+// Writes the next Command 32 packet of the waveform stream to Buffer and
+// returns its size. SampleIndex is the position in the current waveform.
+int32_t writeWaveformPacket(uint8_t* Buffer, int32_t* SampleIndex) {
+	uint8_t data[2 + WAVEFORM_BATCH * 4];
+
+	data[0] = WAVEFORM_BATCH;
+	data[1] = 0;
+
+	for (int32_t i = 0; i < WAVEFORM_BATCH; ++i) {
+		uint16_t sample = getWaveformSample(*SampleIndex);
+		data[2 + i * 4] = sample & 0xFF;
+		data[3 + i * 4] = sample >> 8;
+		data[4 + i * 4] = 0;
+		data[5 + i * 4] = 0;
+		*SampleIndex = (*SampleIndex + 1) % WAVEFORM_SAMPLES;
+	}
+
+	return writePacket(Buffer, 32, data, sizeof(data));
+}
+
+// Fills Buffer with waveform packets. With Noise, runs of random bytes
+// that often hold false start bytes are added, and some packets have a
+// corrupted byte. PacketCount receives the number of intact packets.
+// NOTE: The stream ends with more than a packet of clean data, so a false
+// start near the end doesn't leave the parser waiting for more bytes.
+int32_t createWaveformStream(uint8_t* Buffer, int32_t BufferSize, int32_t Noise, int32_t* PacketCount) {
+	int32_t size = 0;
+	int32_t count = 0;
+	int32_t sampleIndex = 0;
+
+	while (size + 160 <= BufferSize) {
+		int32_t noisy = Noise && size + PACKET_MAX_SIZE * 2 < BufferSize;
+
+		if (noisy && (rand() % 8) == 0) {
+			int32_t noiseSize = 1 + rand() % 16;
+
+			for (int32_t i = 0; i < noiseSize; ++i) {
+				Buffer[size + i] = (rand() % 4 == 0) ? PACKET_START_BYTE : (uint8_t)(rand() & 0xFF);
+			}
+
+			size += noiseSize;
+		}
+
+		int32_t packetSize = writeWaveformPacket(Buffer + size, &sampleIndex);
+
+		if (noisy && (rand() % 32) == 0) {
+			Buffer[size + 4 + rand() % (packetSize - 4)] ^= (uint8_t)(1 + rand() % 255);
+		} else {
+			++count;
+		}
+
+		size += packetSize;
+	}
+
+	*PacketCount = count;
+
+	return size;
+}
+
+//-------------------------------------------------------------------------
+// Verification.
+//-------------------------------------------------------------------------
+// Adds the same random waveforms to a stack with the selected kernels and
+// one with the scalar kernels, and checks the accumulators and snapshots
+// match after every add. Count is odd so the vector tails are used.
+int32_t verifyStackMode(int32_t Mode, int32_t Shift, int32_t Count, int32_t WaveformCount, uint16_t MinSample) {
+	static lwStack stack;
+	static lwStack refStack;
+	uint16_t samples[LW_WAVEFORM_MAX_SAMPLES];
+	uint16_t result[LW_WAVEFORM_MAX_SAMPLES];
+	uint16_t refResult[LW_WAVEFORM_MAX_SAMPLES];
+
+	lwStackInit(&stack, Mode, Shift);
+	lwStackInit(&refStack, Mode, Shift);
+
+	for (int32_t n = 0; n < WaveformCount; ++n) {
+		for (int32_t i = 0; i < Count; ++i) {
+			samples[i] = MinSample + (uint16_t)(rand() % (0x8000 - MinSample));
+		}
+
+		lwStackAddSamples(&stack, samples, Count);
+		lwStackAddSamplesScalar(&refStack, samples, Count);
+
+		int32_t resultCount = lwStackSnapshot(&stack, result);
+		int32_t refResultCount = lwStackSnapshotScalar(&refStack, refResult);
+
+		if (stack.count != refStack.count || memcmp(stack.accumulator, refStack.accumulator, Count * sizeof(int32_t)) != 0 ||
+			resultCount != refResultCount || memcmp(result, refResult, Count * sizeof(uint16_t)) != 0) {
+			printf("Stack mismatch: %s mode %d shift %d waveform %d\n", lwStackImplementationName(), Mode, Shift, n);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int32_t verifyStack() {
+	if (!verifyStackMode(LW_STACK_MODE_MEAN, 0, 1447, 64, 0) ||
+		!verifyStackMode(LW_STACK_MODE_EXPONENTIAL, 1, 1447, 64, 0) ||
+		!verifyStackMode(LW_STACK_MODE_EXPONENTIAL, 4, 1447, 64, 0) ||
+		!verifyStackMode(LW_STACK_MODE_EXPONENTIAL, 15, 1447, 64, 0)) {
+		return 0;
+	}
+
+	// Samples at the top of the 15 bit range past LW_STACK_MAX_MEAN_COUNT, so the sum is halved close to 31 bits.
+	if (!verifyStackMode(LW_STACK_MODE_MEAN, 0, 23, LW_STACK_MAX_MEAN_COUNT + 100, 0x7F00)) {
+		return 0;
+	}
+
+	// A constant waveform keeps an exact mean through the halving.
+	static lwStack stack;
+	uint16_t samples[23];
+	uint16_t result[23];
+
+	for (int32_t i = 0; i < 23; ++i) {
+		samples[i] = 0x7FFF - i;
+	}
+
+	lwStackInit(&stack, LW_STACK_MODE_MEAN, 0);
+
+	for (int32_t n = 0; n < LW_STACK_MAX_MEAN_COUNT + 3; ++n) {
+		lwStackAddSamples(&stack, samples, 23);
+	}
+
+	lwStackSnapshot(&stack, result);
+
+	if (stack.count != LW_STACK_MAX_MEAN_COUNT / 2 + 3 || memcmp(result, samples, sizeof(samples)) != 0) {
+		printf("Stack mean wrong after halving: count %u\n", stack.count);
+		return 0;
+	}
+
+	printf("Stack: %s matches scalar\n", lwStackImplementationName());
+
+	return 1;
+}
+
+// Waveforms fed to the assembler by verifyWaveform, and their length.
+#define VERIFY_WAVEFORMS		12
+#define VERIFY_WAVEFORM_SAMPLES	1450
+
+// Sends the waveforms as packet 32 responses of random sizes, without the
+// packet at DropSample, with samples before the first start flag that
+// must be ignored. Checks every acquired waveform against the samples
+// sent and returns the number that were incomplete, or -1 on a mismatch.
+int32_t verifyWaveformStream(const uint16_t* Samples, int32_t Decimation, int32_t DropSample) {
+	static lwWaveformAssembler assembler;
+	static lwResponsePacket response;
+	uint16_t expected[LW_WAVEFORM_MAX_SAMPLES];
+	uint8_t data[2 + 255 * 4];
+	// Stream is a partial waveform, every waveform, and the start flag that completes the last one.
+	int32_t lead = 100;
+	int32_t streamCount = lead + VERIFY_WAVEFORMS * VERIFY_WAVEFORM_SAMPLES + 1;
+	int32_t incompleteCount = 0;
+	uint32_t nextSequence = 0;
+	int32_t received = 0;
+	// A lost start flag joins two waveforms into one, and later waveforms have one less sequence number.
+	int32_t joined = -1;
+
+	if (DropSample >= lead && (DropSample - lead) % VERIFY_WAVEFORM_SAMPLES == 0) {
+		joined = (DropSample - lead) / VERIFY_WAVEFORM_SAMPLES;
+	}
+
+	lwWaveformInit(&assembler, Decimation);
+
+	for (int32_t pos = 0; pos < streamCount;) {
+		int32_t count = 1 + rand() % 255;
+
+		if (count > streamCount - pos) {
+			count = streamCount - pos;
+		}
+
+		data[0] = (uint8_t)count;
+		data[1] = 0;
+
+		for (int32_t i = 0; i < count; ++i) {
+			int32_t index = pos + i - lead;
+			uint16_t sample = (index < 0 || index == streamCount - lead - 1) ? (uint16_t)(rand() & 0x7FFF) : Samples[index];
+
+			if (index >= 0 && index % VERIFY_WAVEFORM_SAMPLES == 0) {
+				sample |= 0x8000;
+			}
+
+			// The last 2 bytes of each sample are not part of the waveform.
+			data[2 + i * 4] = sample & 0xFF;
+			data[3 + i * 4] = sample >> 8;
+			data[4 + i * 4] = (uint8_t)rand();
+			data[5 + i * 4] = (uint8_t)rand();
+		}
+
+		int32_t dropped = DropSample >= pos && DropSample < pos + count;
+		pos += count;
+
+		if (dropped) {
+			continue;
+		}
+
+		response.size = writePacket(response.data, 32, data, 2 + count * 4);
+
+		if (lwWaveformAddPacket(&assembler, &response) < 0) {
+			printf("Waveform packet of %d samples rejected\n", count);
+			return -1;
+		}
+
+		lwWaveform* waveform;
+
+		while ((waveform = lwWaveformAcquire(&assembler)) != 0) {
+			int32_t index = (joined != -1 && (int32_t)waveform->sequence >= joined) ? waveform->sequence + 1 : waveform->sequence;
+
+			if (waveform->sequence != nextSequence || index >= VERIFY_WAVEFORMS) {
+				printf("Waveform sequence %u, expected %u\n", waveform->sequence, nextSequence);
+				return -1;
+			}
+
+			int32_t expectedCount = lwWaveformDecimateScalar(Samples + index * VERIFY_WAVEFORM_SAMPLES, VERIFY_WAVEFORM_SAMPLES, Decimation, expected);
+
+			if (waveform->incomplete) {
+				++incompleteCount;
+			} else if (waveform->rawSampleCount != VERIFY_WAVEFORM_SAMPLES || waveform->sampleCount != expectedCount ||
+				memcmp(waveform->samples, expected, expectedCount * sizeof(uint16_t)) != 0) {
+				printf("Waveform %u samples differ, decimation %d\n", waveform->sequence, Decimation);
+				return -1;
+			}
+
+			nextSequence = waveform->sequence + 1;
+			++received;
+			lwWaveformRelease(&assembler, waveform);
+		}
+	}
+
+	int32_t expectedReceived = (joined != -1) ? VERIFY_WAVEFORMS - 1 : VERIFY_WAVEFORMS;
+
+	if (received != expectedReceived || (int32_t)assembler.incompleteCount != incompleteCount) {
+		printf("Waveforms received %d, expected %d\n", received, expectedReceived);
+		return -1;
+	}
+
+	return incompleteCount;
+}
+
+// Checks the decimation kernel against scalar for every factor, in place and
+// for lengths that leave vector tails, then the reassembly of waveforms
+// from packets split at random, with and without a lost packet.
+int32_t verifyWaveform() {
+	uint16_t* samples = (uint16_t*)malloc(VERIFY_WAVEFORMS * VERIFY_WAVEFORM_SAMPLES * sizeof(uint16_t));
+	uint16_t source[LW_WAVEFORM_MAX_SAMPLES];
+	uint16_t result[LW_WAVEFORM_MAX_SAMPLES];
+	uint16_t refResult[LW_WAVEFORM_MAX_SAMPLES];
+	int32_t ok = 1;
+
+	for (int32_t i = 0; i < LW_WAVEFORM_MAX_SAMPLES; ++i) {
+		source[i] = (uint16_t)(rand() & 0x7FFF);
+	}
+
+	for (int32_t factor = 1; factor <= 12 && ok; ++factor) {
+		for (int32_t count = 0; count <= LW_WAVEFORM_MAX_SAMPLES; count += (count < 200) ? 1 : 371) {
+			memcpy(result, source, sizeof(source));
+			memcpy(refResult, source, sizeof(source));
+			int32_t resultCount = lwWaveformDecimate(result, count, factor, result);
+			int32_t refResultCount = lwWaveformDecimateScalar(refResult, count, factor, refResult);
+
+			if (resultCount != refResultCount || resultCount != (count + factor - 1) / factor || memcmp(result, refResult, resultCount * sizeof(uint16_t)) != 0) {
+				printf("Decimation mismatch: %s factor %d count %d\n", lwWaveformImplementationName(), factor, count);
+				ok = 0;
+				break;
+			}
+		}
+	}
+
+	for (int32_t i = 0; i < VERIFY_WAVEFORMS * VERIFY_WAVEFORM_SAMPLES; ++i) {
+		samples[i] = (uint16_t)(rand() & 0x7FFF);
+	}
+
+	for (int32_t decimation = 1; decimation <= 3 && ok; decimation += 2) {
+		// Every waveform complete, then a packet lost inside the 6th and one with the start flag of the 6th.
+		int32_t drops[3] = { -1, 100 + 5 * VERIFY_WAVEFORM_SAMPLES + 700, 100 + 5 * VERIFY_WAVEFORM_SAMPLES };
+
+		for (int32_t d = 0; d < 3 && ok; ++d) {
+			int32_t incompleteCount = verifyWaveformStream(samples, decimation, drops[d]);
+
+			if (incompleteCount != (drops[d] == -1 ? 0 : 1)) {
+				printf("Waveform stream: %d incomplete waveforms, decimation %d drop %d\n", incompleteCount, decimation, drops[d]);
+				ok = 0;
+			}
+		}
+	}
+
+	free(samples);
+
+	if (ok) {
+		printf("Waveform: %s decimation matches scalar, split and lost packets reassemble\n", lwWaveformImplementationName());
+	}
+
+	return ok;
+}
+
+// Runs echo detection with the selected and the scalar kernels on random
+// waveforms, with echoes of every height and width, flat tops, clipped
+// peaks and more echoes than a list holds, and checks the lists match.
+int32_t verifyEcho() {
+	uint16_t samples[LW_WAVEFORM_MAX_SAMPLES];
+	lwEchoConfig config;
+	lwEchoList list;
+	lwEchoList refList;
+	int32_t echoCount = 0;
+
+	for (int32_t n = 0; n < 2000; ++n) {
+		int32_t count = (n % 4 == 0) ? 1 + rand() % 64 : 1 + rand() % LW_WAVEFORM_MAX_SAMPLES;
+		int32_t noiseFloor = rand() % 2000;
+		int32_t noise = 1 + rand() % 200;
+
+		for (int32_t i = 0; i < count; ++i) {
+			samples[i] = (uint16_t)(noiseFloor + rand() % noise);
+		}
+
+		int32_t peaks = rand() % 32;
+
+		for (int32_t p = 0; p < peaks; ++p) {
+			double center = rand() % count;
+			double width = 0.5 + (rand() % 40) * 0.1;
+			// Some clip at the top of the 15 bit range.
+			double height = (rand() % 8 == 0) ? rand() % 40000 : rand() % 4000;
+
+			for (int32_t i = 0; i < count; ++i) {
+				double d = (i - center) / width;
+				double value = samples[i] + height * exp(-d * d);
+				// Quantized tops give runs of equal samples.
+				value = (n % 3 == 0) ? floor(value / 64.0) * 64.0 : value;
+				samples[i] = (value > 0x7FFF) ? 0x7FFF : (uint16_t)value;
+			}
+		}
+
+		lwEchoInitConfig(&config);
+		config.thresholdSigma = 2.0f + (rand() % 8);
+		config.minSeparation = 1 + rand() % 8;
+		config.startSample = (n % 2 == 0) ? 0 : rand() % 64;
+		config.maxEchoes = 2 + rand() % (LW_ECHO_MAX_ECHOES - 1);
+
+		memset(&list, 0, sizeof(list));
+		memset(&refList, 0, sizeof(refList));
+		lwEchoDetect(&config, samples, count, &list);
+		lwEchoDetectScalar(&config, samples, count, &refList);
+
+		if (memcmp(&list, &refList, sizeof(list)) != 0) {
+			printf("Echo mismatch: %s waveform %d of %d samples, %d and %d echoes\n", lwEchoImplementationName(), n, count, list.count, refList.count);
+			return 0;
+		}
+
+		echoCount += list.count;
+	}
+
+	printf("Echo: %s matches scalar (%d echoes)\n", lwEchoImplementationName(), echoCount);
+
+	return 1;
+}
+
+//-------------------------------------------------------------------------
+// Benchmarks.
+//-------------------------------------------------------------------------
+void benchmarkCrc() {
+	const int32_t bufferSize = 64 * 1024 * 1024;
+	const int32_t blockSizes[] = { 14, 1024, 65535 };
+	uint8_t* buffer = (uint8_t*)malloc(bufferSize);
+	char name[64];
+
+	for (int32_t i = 0; i < bufferSize; ++i) {
+		buffer[i] = (uint8_t)(rand() & 0xFF);
+	}
+
+	printf("CRC: lwnxCreateCrc\n");
+
+	for (int32_t b = 0; b < 3; ++b) {
+		int32_t blockSize = blockSizes[b];
+		int32_t blockCount = bufferSize / blockSize;
+		uint16_t crc = 0;
+		int64_t startTime = getTimeMicroseconds();
+
+		for (int32_t block = 0; block < blockCount; ++block) {
+			crc ^= lwnxCreateCrc(buffer + block * blockSize, blockSize);
+		}
+
+		double elapsed = (getTimeMicroseconds() - startTime) / 1000000.0;
+		double rate = (double)blockCount * blockSize / elapsed / 1000000.0;
+		printf("  %8.1f MB/s (%d byte blocks, 0x%04X)\n", rate, blockSize, crc);
+		snprintf(name, sizeof(name), "crc.%d", blockSize);
+		addResult(name, rate, "MB/s");
+	}
+
+	free(buffer);
+}
+
+// Feeds the stream one byte at a time through lwnxParseData, as the receive functions do.
+int32_t runStateMachineParser(uint8_t* Stream, int32_t StreamSize) {
+	lwResponsePacket response;
+	int32_t count = 0;
+
+	lwnxInitResponsePacket(&response);
+
+	for (int32_t i = 0; i < StreamSize; ++i) {
+		if (lwnxParseData(&response, Stream[i])) {
+			++count;
+		}
+	}
+
+	return count;
+}
+
+// Feeds the stream in read sized chunks through lwnxParseBuffer, carrying
+// incomplete packets to the next chunk. If Assembler is not 0 the waveform
+// packets found are added to it, and the echoes of each waveform found.
+int32_t runBufferParser(uint8_t* Stream, int32_t StreamSize, int32_t ChunkSize, lwWaveformAssembler* Assembler, int32_t* EchoCount) {
+	lwPacketParser parser = {};
+	lwPacketSpan packets[256];
+	lwEchoConfig echoConfig;
+	lwEchoList echoes;
+	int32_t count = 0;
+	int32_t pos = 0;
+	int32_t end = 0;
+
+	lwEchoInitConfig(&echoConfig);
+
+	while (pos < StreamSize) {
+		end += ChunkSize;
+
+		if (end > StreamSize) {
+			end = StreamSize;
+		}
+
+		while (1) {
+			int32_t consumed = 0;
+			int32_t found = lwnxParseBuffer(&parser, Stream + pos, end - pos, packets, 256, &consumed);
+
+			for (int32_t i = 0; Assembler != 0 && i < found; ++i) {
+				uint8_t* packet = Stream + pos + packets[i].offset;
+
+				if (packet[3] == 32) {
+					lwWaveformAddSamples(Assembler, packet + 6, packet[4]);
+				}
+
+				lwWaveform* waveform;
+
+				while ((waveform = lwWaveformAcquire(Assembler)) != 0) {
+					*EchoCount += lwEchoFromWaveform(&echoConfig, waveform, &echoes);
+					lwWaveformRelease(Assembler, waveform);
+				}
+			}
+
+			pos += consumed;
+			count += found;
+
+			if (found < 256) {
+				break;
+			}
+		}
+
+		if (end == StreamSize) {
+			break;
+		}
+	}
+
+	return count;
+}
+
+// Measures the parsers over Stream, which holds PacketCount intact
+// packets. Name is the kind of stream, like clean.
+void benchmarkParserStream(const char* Name, uint8_t* Stream, int32_t StreamSize, int32_t PacketCount, int32_t Iterations) {
+	const int32_t chunkSizes[] = { 64, 4096 };
+	char name[64];
+	int32_t found = 0;
+
+	printf("Parser, %s stream: %d packets, %d bytes\n", Name, PacketCount, StreamSize);
+
+	int64_t startTime = getTimeMicroseconds();
+
+	for (int32_t i = 0; i < Iterations; ++i) {
+		found = runStateMachineParser(Stream, StreamSize);
+	}
+
+	double elapsed = (getTimeMicroseconds() - startTime) / 1000000.0;
+	double rate = (double)PacketCount * Iterations / elapsed;
+	printf("  lwnxParseData:   %10.0f packets/s  (%d found)\n", rate, found);
+	snprintf(name, sizeof(name), "parser.%s.parseData", Name);
+	addResult(name, rate, "packets/s");
+
+	for (int32_t c = 0; c < 2; ++c) {
+		startTime = getTimeMicroseconds();
+
+		for (int32_t i = 0; i < Iterations; ++i) {
+			found = runBufferParser(Stream, StreamSize, chunkSizes[c], 0, 0);
+		}
+
+		elapsed = (getTimeMicroseconds() - startTime) / 1000000.0;
+		rate = (double)PacketCount * Iterations / elapsed;
+		printf("  lwnxParseBuffer: %10.0f packets/s  (%d found, %d byte reads)\n", rate, found, chunkSizes[c]);
+		snprintf(name, sizeof(name), "parser.%s.buffer%d", Name, chunkSizes[c]);
+		addResult(name, rate, "packets/s");
+	}
+
+	if (found != PacketCount) {
+		// NOTE: Noise that passes the 16 bit CRC by chance is taken as a packet, and swallows the real ones it covers.
+		printf("  NOTE: %d packets were lost to the noise\n", PacketCount - found);
+	}
+}
+
+// Parses a waveform stream, reassembles the waveforms and finds their echoes, as the sample does.
+void benchmarkWaveform(uint8_t* Stream, int32_t StreamSize) {
+	static lwWaveformAssembler assembler;
+	const int32_t iterations = 4;
+	int32_t echoCount = 0;
+
+	lwWaveformInit(&assembler, 1);
+
+	int64_t startTime = getTimeMicroseconds();
+
+	for (int32_t i = 0; i < iterations; ++i) {
+		runBufferParser(Stream, StreamSize, 4096, &assembler, &echoCount);
+	}
+
+	double elapsed = (getTimeMicroseconds() - startTime) / 1000000.0;
+	double rate = assembler.completeCount / elapsed;
+	printf("Waveforms: %10.0f waveforms/s parsed, assembled and searched  (%u waveforms, %d echoes, %s, %s)\n", rate,
+		assembler.completeCount, echoCount, lwWaveformImplementationName(), lwEchoImplementationName());
+	addResult("waveform.echoes", rate, "waveforms/s");
+}
+
+void benchmarkParser(const char* CapturePath) {
+	const int32_t streamSize = 16 * 1024 * 1024;
+	uint8_t* stream = (uint8_t*)malloc(streamSize);
+	int32_t packetCount = 0;
+
+	int32_t size = createWaveformStream(stream, streamSize, 0, &packetCount);
+	benchmarkParserStream("clean", stream, size, packetCount, 4);
+	benchmarkWaveform(stream, size);
+
+	size = createWaveformStream(stream, streamSize, 1, &packetCount);
+	benchmarkParserStream("noisy", stream, size, packetCount, 4);
+
+	free(stream);
+
+	if (CapturePath == 0) {
+		return;
+	}
+
+	// NOTE: The bytes received follow the header of the capture as they arrived, the index file is not needed.
+	FILE* file = fopen(CapturePath, "rb");
+	uint32_t magic = 0;
+
+	if (file == 0 || fread(&magic, 4, 1, file) != 1 || magic != CAPTURE_MAGIC) {
+		printf("%s is not a capture\n", CapturePath);
+
+		if (file != 0) {
+			fclose(file);
+		}
+
+		return;
+	}
+
+	fseek(file, 0, SEEK_END);
+	size = (int32_t)(ftell(file) - CAPTURE_HEADER_SIZE);
+	stream = (uint8_t*)malloc(size > 0 ? size : 1);
+	fseek(file, CAPTURE_HEADER_SIZE, SEEK_SET);
+	size = (int32_t)fread(stream, 1, size > 0 ? size : 0, file);
+	fclose(file);
+
+	packetCount = runBufferParser(stream, size, 4096, 0, 0);
+
+	if (packetCount > 0) {
+		benchmarkParserStream("capture", stream, size, packetCount, 1 + (64 * 1024 * 1024) / (size + 1));
+	}
+
+	free(stream);
+}
+
+typedef struct {
+	int descriptor;
+	volatile int running;
+	int32_t count;
+	int32_t rate;
+
+} deviceThread;
+
+// Answers every command received on the master side, echoing the data
+// of writes and returning the command id as a 32 bit value for reads.
+void* respondCommands(void* User) {
+	deviceThread* device = (deviceThread*)User;
+	lwPacketParser parser = {};
+	lwPacketSpan packets[16];
+	uint8_t buffer[4096];
+	uint8_t response[PACKET_MAX_SIZE + 8];
+	int32_t size = 0;
+
+	while (device->running) {
+		struct pollfd descriptor = {};
+		descriptor.fd = device->descriptor;
+		descriptor.events = POLLIN;
+
+		if (poll(&descriptor, 1, 10) <= 0) {
+			continue;
+		}
+
+		int32_t bytesRead = read(device->descriptor, buffer + size, sizeof(buffer) - size);
+
+		if (bytesRead <= 0) {
+			continue;
+		}
+
+		size += bytesRead;
+
+		int32_t consumed = 0;
+		int32_t found = lwnxParseBuffer(&parser, buffer, size, packets, 16, &consumed);
+
+		for (int32_t i = 0; i < found; ++i) {
+			uint8_t* packet = buffer + packets[i].offset;
+			uint32_t value = packet[3];
+			int32_t responseSize;
+
+			if (packet[1] & 0x1) {
+				responseSize = writePacket(response, packet[3], packet + 4, packets[i].size - 6);
+			} else {
+				responseSize = writePacket(response, packet[3], (uint8_t*)&value, 4);
+			}
+
+			if (write(device->descriptor, response, responseSize) != responseSize) {
+				printf("Could not send the response\n");
+			}
+		}
+
+		size -= consumed;
+		memmove(buffer, buffer + consumed, size);
+	}
+
+	return 0;
+}
+
+// Times managed reads, one after the other, against a thread answering as the device.
+void benchmarkRoundTrip() {
+	const int32_t count = 2000;
+	deviceThread device;
+	device.descriptor = openLoopback();
+	device.running = 1;
+
+	if (device.descriptor < 0) {
+		return;
+	}
+
+	pthread_t thread;
+	pthread_create(&thread, 0, respondCommands, &device);
+
+	lwEndpoint endpoint;
+	initEndpoint(&endpoint);
+
+	int64_t* times = (int64_t*)malloc(count * sizeof(int64_t));
+	int32_t measured = 0;
+
+	printf("Round trip: lwnxCmdReadUInt32 over a pseudo terminal\n");
+
+	for (int32_t i = 0; i < count; ++i) {
+		uint32_t value = 0;
+		int64_t startTime = getTimeMicroseconds();
+
+		if (!lwnxCmdReadUInt32(&endpoint, 2, &value) || value != 2) {
+			printf("  NOTE: command %d failed\n", i);
+			break;
+		}
+
+		times[measured++] = getTimeMicroseconds() - startTime;
+	}
+
+	device.running = 0;
+	pthread_join(thread, 0);
+	closeLoopback(device.descriptor);
+
+	addPercentiles("roundtrip.idle", times, measured, "us");
+	free(times);
+}
+
+// Writes packets at the rate of the device, each carrying the time it was written.
+void* writeTimedStream(void* User) {
+	deviceThread* device = (deviceThread*)User;
+	uint8_t packet[32];
+	int64_t startTime = getTimeMicroseconds();
+
+	for (int32_t i = 0; i < device->count; ++i) {
+		int64_t waitTime = startTime + (int64_t)i * 1000000 / device->rate - getTimeMicroseconds();
+
+		if (waitTime > 0) {
+			usleep(waitTime);
+		}
+
+		int64_t writeTime = getTimeMicroseconds();
+		int32_t size = writePacket(packet, 44, (uint8_t*)&writeTime, sizeof(writeTime));
+
+		if (write(device->descriptor, packet, size) != size) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+// Measures the time from a packet being written to the pseudo terminal to lwnxRecvPacketAny returning it.
+void benchmarkStreamLatency() {
+	deviceThread device;
+	device.count = 20000;
+	device.rate = 5000;
+	device.descriptor = openLoopback();
+
+	if (device.descriptor < 0) {
+		return;
+	}
+
+	lwEndpoint endpoint;
+	initEndpoint(&endpoint);
+
+	int64_t* times = (int64_t*)malloc(device.count * sizeof(int64_t));
+	int32_t received = 0;
+
+	printf("Streaming latency: %d packets at %d Hz over a pseudo terminal\n", device.count, device.rate);
+
+	pthread_t thread;
+	pthread_create(&thread, 0, writeTimedStream, &device);
+
+	while (received < device.count) {
+		lwResponsePacket response;
+
+		if (!lwnxRecvPacketAny(&endpoint, &response, 200)) {
+			break;
+		}
+
+		int64_t writeTime;
+		memcpy(&writeTime, response.data + 4, sizeof(writeTime));
+		times[received++] = getTimeMicroseconds() - writeTime;
+	}
+
+	pthread_join(thread, 0);
+	closeLoopback(device.descriptor);
+
+	if (received < device.count) {
+		printf("  NOTE: %d packets were not received\n", device.count - received);
+	}
+
+	addPercentiles("stream.write_to_packet", times, received, "us");
+	free(times);
+}
+
+//-------------------------------------------------------------------------
+// Main application.
+//-------------------------------------------------------------------------
+int main(int args, char** argv)
+{
+	const char* capturePath = 0;
+	const char* outputPath = 0;
+
+	for (int i = 1; i < args; ++i) {
+		if (i + 1 < args && strcmp(argv[i], "-c") == 0) {
+			capturePath = argv[++i];
+		} else if (i + 1 < args && strcmp(argv[i], "-o") == 0) {
+			outputPath = argv[++i];
+		} else {
+			printf("Usage: benchmark [-c capture] [-o results.csv]\n");
+			return 1;
+		}
+	}
+
+	printf("LWNX C benchmark\n");
+
+	if (!verifyWaveform() || !verifyEcho() || !verifyStack()) {
+		return 1;
+	}
+
+	benchmarkCrc();
+	benchmarkParser(capturePath);
+	benchmarkRoundTrip();
+	benchmarkStreamLatency();
+
+	printf("\n");
+	writeResults(stdout);
+
+	if (outputPath != 0) {
+		FILE* file = fopen(outputPath, "w");
+
+		if (file == 0) {
+			printf("Could not create %s\n", outputPath);
+			return 1;
+		}
+
+		writeResults(file);
+		fclose(file);
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+//-------------------------------------------------------------------------
+// CPU feature detection for the vectorized kernels.
+//
+// Modules with kernels for several instruction sets build all of them
+// and pick the best one for the CPU the program runs on. On x86 each
+// kernel is compiled for its extensions with LW_CPU_TARGET, so no -m
+// flags are needed and the library still runs on CPUs without them.
+//-------------------------------------------------------------------------
+#ifndef __LWCPU_H__
+#define __LWCPU_H__
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#include <immintrin.h>
+	#define LW_CPU_X86
+	#define LW_CPU_TARGET(Features) __attribute__((target(Features)))
+	// Feature is named as for __builtin_cpu_supports, like "ssse3".
+	#define LW_CPU_SUPPORTS(Feature) (__builtin_cpu_init(), __builtin_cpu_supports(Feature))
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define LW_CPU_NEON
+#endif
+
+// NOTE: Defines Function to run before main, so the kernels are selected
+// and their tables built before any call, and no call needs to check for
+// initialization.
+#define LW_CPU_INITIALIZER(Function) __attribute__((constructor)) static void Function()
+
+#endif
\ No newline at end of file
@@ -0,0 +1,405 @@
+#include "lwEcho.h"
+#include "lwCpu.h"
+#include <math.h>
+#include <string.h>
+
+typedef int32_t (*lwEchoStatsFunc)(const uint16_t* Samples, int32_t Count, int32_t Clip, uint64_t* Sum, uint64_t* SumSquares);
+typedef void (*lwEchoPeaksFunc)(const uint16_t* Samples, int32_t From, int32_t Count, int32_t Threshold, uint32_t* Peaks);
+
+static int32_t _statsScalar(const uint16_t* Samples, int32_t Count, int32_t Clip, uint64_t* Sum, uint64_t* SumSquares);
+static void _peaksScalar(const uint16_t* Samples, int32_t From, int32_t Count, int32_t Threshold, uint32_t* Peaks);
+
+typedef struct {
+	lwEchoStatsFunc stats;
+	lwEchoPeaksFunc peaks;
+
+} lwEchoKernels;
+
+static const lwEchoKernels _scalarKernels = { _statsScalar, _peaksScalar };
+static lwEchoKernels _kernels = { _statsScalar, _peaksScalar };
+static const char* _echoName = "scalar";
+
+// Sets the 8 bits of Mask at bit Index of Peaks, which may span two words.
+static inline void _setPeakBits(uint32_t* Peaks, int32_t Index, uint32_t Mask) {
+	int32_t shift = Index & 31;
+
+	Peaks[Index >> 5] |= Mask << shift;
+
+	if (shift > 24) {
+		Peaks[(Index >> 5) + 1] |= Mask >> (32 - shift);
+	}
+}
+
+//-------------------------------------------------------------------------
+// Kernels.
+// Stats sums the samples at or below Clip and their squares, and returns
+// how many there were. Peaks sets bit i for every sample i in [From,
+// Count - 1) that reaches Threshold, is higher than the sample before it,
+// and is not lower than the sample after it.
+//-------------------------------------------------------------------------
+static int32_t _statsScalar(const uint16_t* Samples, int32_t Count, int32_t Clip, uint64_t* Sum, uint64_t* SumSquares) {
+	int32_t kept = 0;
+
+	for (int32_t i = 0; i < Count; ++i) {
+		uint32_t sample = Samples[i];
+
+		if ((int32_t)sample <= Clip) {
+			*Sum += sample;
+			*SumSquares += sample * sample;
+			++kept;
+		}
+	}
+
+	return kept;
+}
+
+static void _peaksScalar(const uint16_t* Samples, int32_t From, int32_t Count, int32_t Threshold, uint32_t* Peaks) {
+	for (int32_t i = From; i < Count - 1; ++i) {
+		int32_t sample = Samples[i];
+
+		if (sample >= Threshold && sample > Samples[i - 1] && sample >= Samples[i + 1]) {
+			Peaks[i >> 5] |= 1u << (i & 31);
+		}
+	}
+}
+
+#if defined(LW_CPU_X86)
+LW_CPU_TARGET("sse2") static int32_t _statsSse2(const uint16_t* Samples, int32_t Count, int32_t Clip, uint64_t* Sum, uint64_t* SumSquares) {
+	// NOTE: Samples are 15 bit, so signed 16 bit compares and multiplies are exact, and a pair of squares
+	// still fits a signed 32 bit lane.
+	__m128i clip = _mm_set1_epi16((int16_t)Clip);
+	__m128i ones = _mm_set1_epi16(1);
+	__m128i zero = _mm_setzero_si128();
+	__m128i sum = _mm_setzero_si128();
+	__m128i squares = _mm_setzero_si128();
+	int32_t kept = 0;
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		__m128i values = _mm_loadu_si128((const __m128i*)(Samples + i));
+		__m128i above = _mm_cmpgt_epi16(values, clip);
+		values = _mm_andnot_si128(above, values);
+		kept += 8 - __builtin_popcount(_mm_movemask_epi8(_mm_packs_epi16(above, zero)));
+
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(values, ones));
+		__m128i pairs = _mm_madd_epi16(values, values);
+		squares = _mm_add_epi64(squares, _mm_unpacklo_epi32(pairs, zero));
+		squares = _mm_add_epi64(squares, _mm_unpackhi_epi32(pairs, zero));
+	}
+
+	uint32_t sums[4];
+	uint64_t squareSums[2];
+	_mm_storeu_si128((__m128i*)sums, sum);
+	_mm_storeu_si128((__m128i*)squareSums, squares);
+	*Sum += (uint64_t)sums[0] + sums[1] + sums[2] + sums[3];
+	*SumSquares += squareSums[0] + squareSums[1];
+
+	return kept + _statsScalar(Samples + i, Count - i, Clip, Sum, SumSquares);
+}
+
+LW_CPU_TARGET("sse2") static void _peaksSse2(const uint16_t* Samples, int32_t From, int32_t Count, int32_t Threshold, uint32_t* Peaks) {
+	__m128i threshold = _mm_set1_epi16((int16_t)(Threshold - 1));
+	__m128i zero = _mm_setzero_si128();
+	int32_t i = From;
+
+	for (; i + 9 <= Count; i += 8) {
+		__m128i previous = _mm_loadu_si128((const __m128i*)(Samples + i - 1));
+		__m128i values = _mm_loadu_si128((const __m128i*)(Samples + i));
+		__m128i next = _mm_loadu_si128((const __m128i*)(Samples + i + 1));
+		__m128i peaks = _mm_and_si128(_mm_cmpgt_epi16(values, previous), _mm_cmpgt_epi16(values, threshold));
+		peaks = _mm_andnot_si128(_mm_cmpgt_epi16(next, values), peaks);
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(peaks, zero));
+
+		if (mask) {
+			_setPeakBits(Peaks, i, mask);
+		}
+	}
+
+	_peaksScalar(Samples, i, Count, Threshold, Peaks);
+}
+
+#elif defined(LW_CPU_NEON)
+static int32_t _statsNeon(const uint16_t* Samples, int32_t Count, int32_t Clip, uint64_t* Sum, uint64_t* SumSquares) {
+	uint16x8_t clip = vdupq_n_u16((uint16_t)Clip);
+	uint32x4_t sum = vdupq_n_u32(0);
+	uint64x2_t squares = vdupq_n_u64(0);
+	int32_t kept = 0;
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		uint16x8_t values = vld1q_u16(Samples + i);
+		uint16x8_t below = vcleq_u16(values, clip);
+		values = vandq_u16(values, below);
+		kept += vaddvq_u16(vshrq_n_u16(below, 15));
+
+		sum = vpadalq_u16(sum, values);
+		squares = vpadalq_u32(squares, vmull_u16(vget_low_u16(values), vget_low_u16(values)));
+		squares = vpadalq_u32(squares, vmull_u16(vget_high_u16(values), vget_high_u16(values)));
+	}
+
+	*Sum += vaddvq_u32(sum);
+	*SumSquares += vaddvq_u64(squares);
+
+	return kept + _statsScalar(Samples + i, Count - i, Clip, Sum, SumSquares);
+}
+
+static void _peaksNeon(const uint16_t* Samples, int32_t From, int32_t Count, int32_t Threshold, uint32_t* Peaks) {
+	static const uint8_t weights[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+	uint8x8_t weight = vld1_u8(weights);
+	uint16x8_t threshold = vdupq_n_u16((uint16_t)Threshold);
+	int32_t i = From;
+
+	for (; i + 9 <= Count; i += 8) {
+		uint16x8_t previous = vld1q_u16(Samples + i - 1);
+		uint16x8_t values = vld1q_u16(Samples + i);
+		uint16x8_t next = vld1q_u16(Samples + i + 1);
+		uint16x8_t peaks = vandq_u16(vcgtq_u16(values, previous), vcgeq_u16(values, threshold));
+		peaks = vandq_u16(peaks, vcgeq_u16(values, next));
+		uint32_t mask = vaddv_u8(vand_u8(vmovn_u16(peaks), weight));
+
+		if (mask) {
+			_setPeakBits(Peaks, i, mask);
+		}
+	}
+
+	_peaksScalar(Samples, i, Count, Threshold, Peaks);
+}
+#endif
+
+LW_CPU_INITIALIZER(_echoInit) {
+#if defined(LW_CPU_X86)
+	if (LW_CPU_SUPPORTS("sse2")) {
+		_kernels.stats = _statsSse2;
+		_kernels.peaks = _peaksSse2;
+		_echoName = "sse2";
+	}
+#elif defined(LW_CPU_NEON)
+	_kernels.stats = _statsNeon;
+	_kernels.peaks = _peaksNeon;
+	_echoName = "neon";
+#endif
+}
+
+const char* lwEchoImplementationName() {
+	return _echoName;
+}
+
+//-------------------------------------------------------------------------
+// Echo detection.
+//-------------------------------------------------------------------------
+typedef struct {
+	int32_t index;
+	int32_t height;
+	uint8_t keep;
+
+} lwEchoCandidate;
+
+void lwEchoInitConfig(lwEchoConfig* Config) {
+	Config->thresholdSigma = 5.0f;
+	Config->minAmplitude = 8;
+	Config->minSeparation = 4;
+	Config->startSample = 0;
+	Config->maxEchoes = LW_ECHO_MAX_ECHOES;
+}
+
+// Number of passes and clip level, in standard deviations, of the noise estimate.
+#define LW_ECHO_NOISE_PASSES	3
+#define LW_ECHO_NOISE_CLIP		3.0f
+
+// Estimates the noise floor and its standard deviation. The mean of every sample is raised by the echoes, so
+// it is taken again without the samples well above the last estimate.
+static void _estimateNoise(const uint16_t* Samples, int32_t Count, float* Floor, float* Sigma, const lwEchoKernels* Kernels) {
+	int32_t clip = 0x7FFF;
+
+	for (int32_t pass = 0; pass < LW_ECHO_NOISE_PASSES; ++pass) {
+		uint64_t sum = 0;
+		uint64_t squares = 0;
+		int32_t kept = Kernels->stats(Samples, Count, clip, &sum, &squares);
+
+		if (kept == 0) {
+			return;
+		}
+
+		double mean = (double)sum / kept;
+		double variance = (double)squares / kept - mean * mean;
+
+		*Floor = (float)mean;
+		*Sigma = (variance > 0) ? (float)sqrt(variance) : 0.0f;
+
+		clip = (int32_t)(*Floor + LW_ECHO_NOISE_CLIP * *Sigma);
+
+		if (clip > 0x7FFF) {
+			clip = 0x7FFF;
+		}
+	}
+}
+
+// Keeps the first and last candidates and the strongest of the others, up to MaxEchoes in all.
+static void _selectCandidates(lwEchoCandidate* Candidates, int32_t Count, int32_t MaxEchoes) {
+	for (int32_t i = 0; i < Count; ++i) {
+		Candidates[i].keep = (Count <= MaxEchoes || i == 0 || i == Count - 1);
+	}
+
+	if (Count <= MaxEchoes) {
+		return;
+	}
+
+	for (int32_t n = 2; n < MaxEchoes; ++n) {
+		int32_t best = -1;
+
+		for (int32_t i = 1; i < Count - 1; ++i) {
+			if (!Candidates[i].keep && (best == -1 || Candidates[i].height > Candidates[best].height)) {
+				best = i;
+			}
+		}
+
+		Candidates[best].keep = 1;
+	}
+}
+
+static int32_t _isSeparate(const uint16_t* Samples, const lwEchoCandidate* Previous, int32_t Index, int32_t MinSeparation, int32_t Margin) {
+	if (Index - Previous->index < MinSeparation) {
+		return 0;
+	}
+
+	int32_t lower = (Samples[Index] < Previous->height) ? Samples[Index] : Previous->height;
+	int32_t valley = lower;
+
+	for (int32_t i = Previous->index + 1; i < Index; ++i) {
+		if (Samples[i] < valley) {
+			valley = Samples[i];
+		}
+	}
+
+	return lower - valley >= Margin;
+}
+
+static int32_t _detect(const lwEchoConfig* Config, const uint16_t* Samples, int32_t Count, lwEchoList* List, const lwEchoKernels* Kernels) {
+	uint32_t peaks[LW_WAVEFORM_MAX_SAMPLES / 32 + 1];
+	lwEchoCandidate candidates[LW_WAVEFORM_MAX_SAMPLES / 2];
+	int32_t start = (Config->startSample > 1) ? Config->startSample : 1;
+	int32_t maxEchoes = Config->maxEchoes;
+
+	if (Count > LW_WAVEFORM_MAX_SAMPLES) {
+		Count = LW_WAVEFORM_MAX_SAMPLES;
+	}
+
+	if (maxEchoes < 2 || maxEchoes > LW_ECHO_MAX_ECHOES) {
+		maxEchoes = LW_ECHO_MAX_ECHOES;
+	}
+
+	List->count = 0;
+	List->foundCount = 0;
+	List->noiseFloor = 0;
+	List->noiseSigma = 0;
+	List->threshold = 0x7FFF;
+
+	if (Count - start < 2) {
+		return 0;
+	}
+
+	float floor = 0;
+	float sigma = 0;
+	_estimateNoise(Samples + start, Count - start, &floor, &sigma, Kernels);
+
+	float margin = Config->thresholdSigma * sigma;
+
+	if (margin < Config->minAmplitude) {
+		margin = (float)Config->minAmplitude;
+	}
+
+	int32_t threshold = (int32_t)ceilf(floor + margin);
+
+	List->noiseFloor = (uint16_t)(floor + 0.5f);
+	List->noiseSigma = (uint16_t)(sigma + 0.5f);
+
+	if (threshold > 0x7FFF) {
+		return 0;
+	}
+
+	List->threshold = (uint16_t)threshold;
+
+	memset(peaks, 0, sizeof(peaks));
+	Kernels->peaks(Samples, start, Count, threshold, peaks);
+
+	// Peaks that are close or not separated by a dip as deep as the threshold margin are one echo, keeping
+	// the higher. This stops noise on the slope of a strong echo from being counted as another.
+	int32_t candidateCount = 0;
+
+	for (int32_t word = start >> 5; word < (Count + 31) >> 5; ++word) {
+		uint32_t bits = peaks[word];
+
+		while (bits) {
+			int32_t index = (word << 5) + __builtin_ctz(bits);
+			int32_t height = Samples[index];
+			bits &= bits - 1;
+
+			if (candidateCount > 0 && !_isSeparate(Samples, &candidates[candidateCount - 1], index, Config->minSeparation, (int32_t)margin)) {
+				if (height > candidates[candidateCount - 1].height) {
+					candidates[candidateCount - 1].index = index;
+					candidates[candidateCount - 1].height = height;
+				}
+
+				continue;
+			}
+
+			candidates[candidateCount].index = index;
+			candidates[candidateCount].height = height;
+			++candidateCount;
+		}
+	}
+
+	List->foundCount = (uint16_t)candidateCount;
+	_selectCandidates(candidates, candidateCount, maxEchoes);
+
+	for (int32_t i = 0; i < candidateCount; ++i) {
+		if (!candidates[i].keep) {
+			continue;
+		}
+
+		// NOTE: The vertex of the parabola through the peak and its neighbours is within half a sample of the peak.
+		int32_t index = candidates[i].index;
+		float before = Samples[index - 1];
+		float peak = Samples[index];
+		float after = Samples[index + 1];
+		float curvature = before - 2.0f * peak + after;
+		float offset = (curvature < 0) ? 0.5f * (before - after) / curvature : 0.0f;
+
+		if (offset > 0.5f) {
+			offset = 0.5f;
+		} else if (offset < -0.5f) {
+			offset = -0.5f;
+		}
+
+		float height = peak - 0.25f * (before - after) * offset - floor;
+		float position = (index + offset) * LW_ECHO_POSITION_SCALE + 0.5f;
+
+		lwEcho* echo = &List->echoes[List->count++];
+		echo->position = (position < 65535.0f) ? (uint16_t)position : 65535;
+		echo->amplitude = (height > 0) ? (uint16_t)(height + 0.5f) : 0;
+	}
+
+	return List->count;
+}
+
+int32_t lwEchoDetect(const lwEchoConfig* Config, const uint16_t* Samples, int32_t Count, lwEchoList* List) {
+	return _detect(Config, Samples, Count, List, &_kernels);
+}
+
+int32_t lwEchoDetectScalar(const lwEchoConfig* Config, const uint16_t* Samples, int32_t Count, lwEchoList* List) {
+	return _detect(Config, Samples, Count, List, &_scalarKernels);
+}
+
+int32_t lwEchoFromWaveform(const lwEchoConfig* Config, const lwWaveform* Waveform, lwEchoList* List) {
+	List->sequence = Waveform->sequence;
+
+	return lwEchoDetect(Config, Waveform->samples, Waveform->sampleCount, List);
+}
+
+const lwEcho* lwEchoFirst(const lwEchoList* List) {
+	return (List->count > 0) ? &List->echoes[0] : 0;
+}
+
+const lwEcho* lwEchoLast(const lwEchoList* List) {
+	return (List->count > 0) ? &List->echoes[List->count - 1] : 0;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+//-------------------------------------------------------------------------
+// SF11 waveform echo detection.
+//
+// Finds the returns in a waveform from packet 32 so only a few bytes per
+// waveform need to be kept instead of the samples. The noise floor is
+// estimated from the waveform itself with a clipped mean, so the strong
+// samples of the returns do not raise it. Every local maximum above the
+// floor by a multiple of the noise is an echo, and its position and
+// height are refined by fitting a parabola through the 3 samples at the
+// peak. The comparisons and sums are vectorized and work on the samples
+// in place.
+//-------------------------------------------------------------------------
+#ifndef __LWECHO_H__
+#define __LWECHO_H__
+
+#include <stdint.h>
+#include "lwWaveform.h"
+
+// Largest number of echoes kept for one waveform.
+#define LW_ECHO_MAX_ECHOES		16
+// Echo positions are in 1/16 samples.
+#define LW_ECHO_POSITION_SCALE	16
+
+typedef struct {
+	// Sub-sample position of the peak from the start of the waveform, in 1/LW_ECHO_POSITION_SCALE samples.
+	uint16_t position;
+	// Height of the peak above the noise floor.
+	uint16_t amplitude;
+
+} lwEcho;
+
+typedef struct {
+	// Sequence number of the waveform the echoes were found in.
+	uint32_t sequence;
+	uint16_t noiseFloor;
+	uint16_t noiseSigma;
+	// Samples must reach this level to be an echo.
+	uint16_t threshold;
+	// Echoes found before limiting them to the configured maximum.
+	uint16_t foundCount;
+	// Echoes in order of position. The first and last found are always kept, see lwEchoConfig.
+	int32_t count;
+	lwEcho echoes[LW_ECHO_MAX_ECHOES];
+
+} lwEchoList;
+
+typedef struct {
+	// Echoes must rise this many noise standard deviations above the noise floor. Default 5.
+	float thresholdSigma;
+	// And at least this far above it. Default 8.
+	int32_t minAmplitude;
+	// Peaks closer than this many samples are one echo, the higher one is kept. Default 4.
+	int32_t minSeparation;
+	// Samples before this are not searched, like the outgoing pulse. Default 0.
+	int32_t startSample;
+	// When more echoes are found, the first, the last, and the strongest of the rest are kept. Default and
+	// largest LW_ECHO_MAX_ECHOES, smallest 2.
+	int32_t maxEchoes;
+
+} lwEchoConfig;
+
+// Fills Config with the defaults.
+void lwEchoInitConfig(lwEchoConfig* Config);
+
+// Finds the echoes in Count 15 bit samples. Returns the number of echoes in List.
+int32_t lwEchoDetect(const lwEchoConfig* Config, const uint16_t* Samples, int32_t Count, lwEchoList* List);
+
+// lwEchoDetect with the scalar kernels, to check the selected ones against.
+int32_t lwEchoDetectScalar(const lwEchoConfig* Config, const uint16_t* Samples, int32_t Count, lwEchoList* List);
+
+// Finds the echoes in a waveform from lwWaveformAcquire. Positions are in the samples of the waveform, so
+// after decimation they need to be multiplied by the decimation factor.
+int32_t lwEchoFromWaveform(const lwEchoConfig* Config, const lwWaveform* Waveform, lwEchoList* List);
+
+// Returns the first or last echo of the list, or 0 if it is empty.
+const lwEcho* lwEchoFirst(const lwEchoList* List);
+const lwEcho* lwEchoLast(const lwEchoList* List);
+
+// Name of the kernels selected for the CPU.
+const char* lwEchoImplementationName();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,319 @@
+#include "lwStack.h"
+#include "lwCpu.h"
+#include <string.h>
+
+typedef void (*lwStackAddMeanFunc)(int32_t* Accumulator, const uint16_t* Samples, int32_t Count);
+typedef void (*lwStackAddExponentialFunc)(int32_t* Accumulator, const uint16_t* Samples, int32_t Count, int32_t Shift);
+typedef void (*lwStackMeanFunc)(const int32_t* Accumulator, int32_t Count, uint32_t WaveformCount, uint16_t* Result);
+typedef void (*lwStackExponentialFunc)(const int32_t* Accumulator, int32_t Count, uint16_t* Result);
+
+typedef struct {
+	lwStackAddMeanFunc addMean;
+	lwStackAddExponentialFunc addExponential;
+	lwStackMeanFunc mean;
+	lwStackExponentialFunc exponential;
+
+} lwStackKernels;
+
+static void _addMeanScalar(int32_t* Accumulator, const uint16_t* Samples, int32_t Count);
+static void _addExponentialScalar(int32_t* Accumulator, const uint16_t* Samples, int32_t Count, int32_t Shift);
+static void _meanScalar(const int32_t* Accumulator, int32_t Count, uint32_t WaveformCount, uint16_t* Result);
+static void _exponentialScalar(const int32_t* Accumulator, int32_t Count, uint16_t* Result);
+
+static const lwStackKernels _scalarKernels = { _addMeanScalar, _addExponentialScalar, _meanScalar, _exponentialScalar };
+static lwStackKernels _kernels = { _addMeanScalar, _addExponentialScalar, _meanScalar, _exponentialScalar };
+static const char* _stackName = "scalar";
+
+//-------------------------------------------------------------------------
+// Kernels.
+// The exponential accumulators hold samples in 16.16 fixed point. Mean
+// results divide by multiplying with the reciprocal of the count, which
+// is exact to well under half a sample for 15 bit results.
+//-------------------------------------------------------------------------
+static void _addMeanScalar(int32_t* Accumulator, const uint16_t* Samples, int32_t Count) {
+	for (int32_t i = 0; i < Count; ++i) {
+		Accumulator[i] += Samples[i];
+	}
+}
+
+static void _addExponentialScalar(int32_t* Accumulator, const uint16_t* Samples, int32_t Count, int32_t Shift) {
+	for (int32_t i = 0; i < Count; ++i) {
+		Accumulator[i] += (((int32_t)Samples[i] << 16) - Accumulator[i]) >> Shift;
+	}
+}
+
+static void _meanScalar(const int32_t* Accumulator, int32_t Count, uint32_t WaveformCount, uint16_t* Result) {
+	float scale = 1.0f / WaveformCount;
+
+	for (int32_t i = 0; i < Count; ++i) {
+		Result[i] = (uint16_t)(Accumulator[i] * scale + 0.5f);
+	}
+}
+
+static void _exponentialScalar(const int32_t* Accumulator, int32_t Count, uint16_t* Result) {
+	for (int32_t i = 0; i < Count; ++i) {
+		Result[i] = (uint16_t)((Accumulator[i] + 0x8000) >> 16);
+	}
+}
+
+#if defined(LW_CPU_X86)
+LW_CPU_TARGET("sse2") static void _addMeanSse2(int32_t* Accumulator, const uint16_t* Samples, int32_t Count) {
+	__m128i zero = _mm_setzero_si128();
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		__m128i samples = _mm_loadu_si128((const __m128i*)(Samples + i));
+		__m128i low = _mm_loadu_si128((const __m128i*)(Accumulator + i));
+		__m128i high = _mm_loadu_si128((const __m128i*)(Accumulator + i + 4));
+		_mm_storeu_si128((__m128i*)(Accumulator + i), _mm_add_epi32(low, _mm_unpacklo_epi16(samples, zero)));
+		_mm_storeu_si128((__m128i*)(Accumulator + i + 4), _mm_add_epi32(high, _mm_unpackhi_epi16(samples, zero)));
+	}
+
+	_addMeanScalar(Accumulator + i, Samples + i, Count - i);
+}
+
+LW_CPU_TARGET("sse2") static void _addExponentialSse2(int32_t* Accumulator, const uint16_t* Samples, int32_t Count, int32_t Shift) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i shift = _mm_cvtsi32_si128(Shift);
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		__m128i samples = _mm_loadu_si128((const __m128i*)(Samples + i));
+		__m128i low = _mm_loadu_si128((const __m128i*)(Accumulator + i));
+		__m128i high = _mm_loadu_si128((const __m128i*)(Accumulator + i + 4));
+		// NOTE: Unpacking the samples into the high half of each lane is the shift to 16.16 fixed point.
+		__m128i lowSamples = _mm_unpacklo_epi16(zero, samples);
+		__m128i highSamples = _mm_unpackhi_epi16(zero, samples);
+		low = _mm_add_epi32(low, _mm_sra_epi32(_mm_sub_epi32(lowSamples, low), shift));
+		high = _mm_add_epi32(high, _mm_sra_epi32(_mm_sub_epi32(highSamples, high), shift));
+		_mm_storeu_si128((__m128i*)(Accumulator + i), low);
+		_mm_storeu_si128((__m128i*)(Accumulator + i + 4), high);
+	}
+
+	_addExponentialScalar(Accumulator + i, Samples + i, Count - i, Shift);
+}
+
+LW_CPU_TARGET("sse2") static void _meanSse2(const int32_t* Accumulator, int32_t Count, uint32_t WaveformCount, uint16_t* Result) {
+	__m128 scale = _mm_set1_ps(1.0f / WaveformCount);
+	__m128 half = _mm_set1_ps(0.5f);
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		__m128 low = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(Accumulator + i)));
+		__m128 high = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(Accumulator + i + 4)));
+		// NOTE: Truncating after adding a half matches the scalar rounding. The means fit 15 bits, so the signed
+		// pack does not saturate.
+		__m128i lowMean = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(low, scale), half));
+		__m128i highMean = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(high, scale), half));
+		_mm_storeu_si128((__m128i*)(Result + i), _mm_packs_epi32(lowMean, highMean));
+	}
+
+	_meanScalar(Accumulator + i, Count - i, WaveformCount, Result + i);
+}
+
+LW_CPU_TARGET("sse2") static void _exponentialSse2(const int32_t* Accumulator, int32_t Count, uint16_t* Result) {
+	__m128i round = _mm_set1_epi32(0x8000);
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		__m128i low = _mm_loadu_si128((const __m128i*)(Accumulator + i));
+		__m128i high = _mm_loadu_si128((const __m128i*)(Accumulator + i + 4));
+		low = _mm_srai_epi32(_mm_add_epi32(low, round), 16);
+		high = _mm_srai_epi32(_mm_add_epi32(high, round), 16);
+		_mm_storeu_si128((__m128i*)(Result + i), _mm_packs_epi32(low, high));
+	}
+
+	_exponentialScalar(Accumulator + i, Count - i, Result + i);
+}
+
+#elif defined(LW_CPU_NEON)
+static void _addMeanNeon(int32_t* Accumulator, const uint16_t* Samples, int32_t Count) {
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		int16x8_t samples = vreinterpretq_s16_u16(vld1q_u16(Samples + i));
+		vst1q_s32(Accumulator + i, vaddw_s16(vld1q_s32(Accumulator + i), vget_low_s16(samples)));
+		vst1q_s32(Accumulator + i + 4, vaddw_s16(vld1q_s32(Accumulator + i + 4), vget_high_s16(samples)));
+	}
+
+	_addMeanScalar(Accumulator + i, Samples + i, Count - i);
+}
+
+static void _addExponentialNeon(int32_t* Accumulator, const uint16_t* Samples, int32_t Count, int32_t Shift) {
+	int32x4_t shift = vdupq_n_s32(-Shift);
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		uint16x8_t samples = vld1q_u16(Samples + i);
+		int32x4_t low = vld1q_s32(Accumulator + i);
+		int32x4_t high = vld1q_s32(Accumulator + i + 4);
+		int32x4_t lowSamples = vreinterpretq_s32_u32(vshll_n_u16(vget_low_u16(samples), 16));
+		int32x4_t highSamples = vreinterpretq_s32_u32(vshll_n_u16(vget_high_u16(samples), 16));
+		// NOTE: Shifting left by a negative amount is an arithmetic shift right.
+		vst1q_s32(Accumulator + i, vaddq_s32(low, vshlq_s32(vsubq_s32(lowSamples, low), shift)));
+		vst1q_s32(Accumulator + i + 4, vaddq_s32(high, vshlq_s32(vsubq_s32(highSamples, high), shift)));
+	}
+
+	_addExponentialScalar(Accumulator + i, Samples + i, Count - i, Shift);
+}
+
+static void _meanNeon(const int32_t* Accumulator, int32_t Count, uint32_t WaveformCount, uint16_t* Result) {
+	float scale = 1.0f / WaveformCount;
+	float32x4_t half = vdupq_n_f32(0.5f);
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		float32x4_t low = vcvtq_f32_s32(vld1q_s32(Accumulator + i));
+		float32x4_t high = vcvtq_f32_s32(vld1q_s32(Accumulator + i + 4));
+		uint32x4_t lowMean = vcvtq_u32_f32(vmlaq_n_f32(half, low, scale));
+		uint32x4_t highMean = vcvtq_u32_f32(vmlaq_n_f32(half, high, scale));
+		vst1q_u16(Result + i, vcombine_u16(vmovn_u32(lowMean), vmovn_u32(highMean)));
+	}
+
+	_meanScalar(Accumulator + i, Count - i, WaveformCount, Result + i);
+}
+
+static void _exponentialNeon(const int32_t* Accumulator, int32_t Count, uint16_t* Result) {
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		int32x4_t low = vld1q_s32(Accumulator + i);
+		int32x4_t high = vld1q_s32(Accumulator + i + 4);
+		vst1q_u16(Result + i, vreinterpretq_u16_s16(vcombine_s16(vrshrn_n_s32(low, 16), vrshrn_n_s32(high, 16))));
+	}
+
+	_exponentialScalar(Accumulator + i, Count - i, Result + i);
+}
+#endif
+
+LW_CPU_INITIALIZER(_stackInit) {
+#if defined(LW_CPU_X86)
+	if (LW_CPU_SUPPORTS("sse2")) {
+		_kernels.addMean = _addMeanSse2;
+		_kernels.addExponential = _addExponentialSse2;
+		_kernels.mean = _meanSse2;
+		_kernels.exponential = _exponentialSse2;
+		_stackName = "sse2";
+	}
+#elif defined(LW_CPU_NEON)
+	_kernels.addMean = _addMeanNeon;
+	_kernels.addExponential = _addExponentialNeon;
+	_kernels.mean = _meanNeon;
+	_kernels.exponential = _exponentialNeon;
+	_stackName = "neon";
+#endif
+}
+
+const char* lwStackImplementationName() {
+	return _stackName;
+}
+
+//-------------------------------------------------------------------------
+// Stacking.
+//-------------------------------------------------------------------------
+void lwStackInit(lwStack* Stack, int32_t Mode, int32_t Shift) {
+	if (Shift < 1) {
+		Shift = 1;
+	} else if (Shift > 15) {
+		Shift = 15;
+	}
+
+	Stack->mode = Mode;
+	Stack->shift = Shift;
+	Stack->rejectedCount = 0;
+	lwStackReset(Stack);
+}
+
+void lwStackReset(lwStack* Stack) {
+	Stack->sampleCount = 0;
+	Stack->count = 0;
+	Stack->lastSequence = 0;
+}
+
+static int32_t _addSamples(lwStack* Stack, const uint16_t* Samples, int32_t Count, const lwStackKernels* Kernels) {
+	if (Count <= 0 || Count > LW_WAVEFORM_MAX_SAMPLES || (Stack->count > 0 && Count != Stack->sampleCount)) {
+		++Stack->rejectedCount;
+		return 0;
+	}
+
+	if (Stack->count == 0) {
+		// NOTE: The accumulators are only cleared when the first waveform sets the length, so a reset is cheap.
+		Stack->sampleCount = Count;
+
+		if (Stack->mode == LW_STACK_MODE_EXPONENTIAL) {
+			for (int32_t i = 0; i < Count; ++i) {
+				Stack->accumulator[i] = (int32_t)Samples[i] << 16;
+			}
+		} else {
+			memset(Stack->accumulator, 0, Count * sizeof(int32_t));
+			Kernels->addMean(Stack->accumulator, Samples, Count);
+		}
+
+		Stack->count = 1;
+		return 1;
+	}
+
+	if (Stack->mode == LW_STACK_MODE_EXPONENTIAL) {
+		Kernels->addExponential(Stack->accumulator, Samples, Count, Stack->shift);
+		++Stack->count;
+		return 1;
+	}
+
+	if (Stack->count == LW_STACK_MAX_MEAN_COUNT) {
+		for (int32_t i = 0; i < Count; ++i) {
+			Stack->accumulator[i] >>= 1;
+		}
+
+		Stack->count >>= 1;
+	}
+
+	Kernels->addMean(Stack->accumulator, Samples, Count);
+	++Stack->count;
+
+	return 1;
+}
+
+int32_t lwStackAddSamples(lwStack* Stack, const uint16_t* Samples, int32_t Count) {
+	return _addSamples(Stack, Samples, Count, &_kernels);
+}
+
+int32_t lwStackAddSamplesScalar(lwStack* Stack, const uint16_t* Samples, int32_t Count) {
+	return _addSamples(Stack, Samples, Count, &_scalarKernels);
+}
+
+int32_t lwStackAdd(lwStack* Stack, const lwWaveform* Waveform) {
+	if (Waveform->incomplete) {
+		++Stack->rejectedCount;
+		return 0;
+	}
+
+	if (!lwStackAddSamples(Stack, Waveform->samples, Waveform->sampleCount)) {
+		return 0;
+	}
+
+	Stack->lastSequence = Waveform->sequence;
+
+	return 1;
+}
+
+static int32_t _snapshot(const lwStack* Stack, uint16_t* Result, const lwStackKernels* Kernels) {
+	if (Stack->count == 0) {
+		return 0;
+	}
+
+	if (Stack->mode == LW_STACK_MODE_EXPONENTIAL) {
+		Kernels->exponential(Stack->accumulator, Stack->sampleCount, Result);
+	} else {
+		Kernels->mean(Stack->accumulator, Stack->sampleCount, Stack->count, Result);
+	}
+
+	return Stack->sampleCount;
+}
+
+int32_t lwStackSnapshot(const lwStack* Stack, uint16_t* Result) {
+	return _snapshot(Stack, Result, &_kernels);
+}
+
+int32_t lwStackSnapshotScalar(const lwStack* Stack, uint16_t* Result) {
+	return _snapshot(Stack, Result, &_scalarKernels);
+}
\ No newline at end of file
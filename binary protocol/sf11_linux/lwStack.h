@@ -0,0 +1,72 @@
+//-------------------------------------------------------------------------
+// SF11 waveform stacking.
+//
+// In a stationary setup consecutive waveforms from packet 32 see the
+// same scene, so adding them together raises weak returns out of the
+// noise, by the square root of the number of waveforms stacked. Every
+// waveform starts at its start flag, so sample i of each one is at the
+// same range and they can be added sample by sample.
+//
+// The stack holds one 32 bit accumulator per sample and never allocates.
+// In mean mode it keeps the sum of the waveforms, in exponential mode a
+// running average in 16.16 fixed point that follows slow changes in the
+// scene. A snapshot can be taken at any time between adds and does not
+// change the accumulators.
+//-------------------------------------------------------------------------
+#ifndef __LWSTACK_H__
+#define __LWSTACK_H__
+
+#include <stdint.h>
+#include "lwWaveform.h"
+
+// Average of every waveform added since the last reset.
+#define LW_STACK_MODE_MEAN			0
+// Each waveform moves the average 1 / 2^shift of the way to itself.
+#define LW_STACK_MODE_EXPONENTIAL	1
+
+// Waveforms summed before the mean halves its sum and count, which keeps the sum of 15 bit samples within
+// 31 bits. After that older waveforms weigh a little less than newer ones.
+#define LW_STACK_MAX_MEAN_COUNT		65536
+
+typedef struct {
+	int32_t mode;
+	int32_t shift;
+	// Length of the waveforms in the stack, set by the first one added after a reset.
+	int32_t sampleCount;
+	// Waveforms in the mean, or added since the reset in exponential mode.
+	uint32_t count;
+	// Waveforms not added because they were incomplete or of a different length.
+	uint32_t rejectedCount;
+	// Sequence number of the last waveform added.
+	uint32_t lastSequence;
+	int32_t accumulator[LW_WAVEFORM_MAX_SAMPLES];
+
+} lwStack;
+
+// Prepares an empty stack. Shift sets the weight of each waveform in exponential mode, from 1 to 15, like 4
+// for about the last 16 waveforms. It is not used in mean mode.
+void lwStackInit(lwStack* Stack, int32_t Mode, int32_t Shift);
+
+// Empties the stack, keeping its mode.
+void lwStackReset(lwStack* Stack);
+
+// Adds a waveform from lwWaveformAcquire. Returns 1 if it was added, or 0 if it was incomplete or its length
+// differs from the waveforms already in the stack.
+int32_t lwStackAdd(lwStack* Stack, const lwWaveform* Waveform);
+
+// Adds Count 15 bit samples. Returns 1 if they were added, or 0 if Count differs from the waveforms already
+// in the stack.
+int32_t lwStackAddSamples(lwStack* Stack, const uint16_t* Samples, int32_t Count);
+
+// Writes the stacked waveform to Result as 15 bit samples, rounded, so it can be passed to lwEchoDetect.
+// Returns the number of samples, 0 if the stack is empty.
+int32_t lwStackSnapshot(const lwStack* Stack, uint16_t* Result);
+
+// lwStackAddSamples and lwStackSnapshot with the scalar kernels, to check the selected ones against.
+int32_t lwStackAddSamplesScalar(lwStack* Stack, const uint16_t* Samples, int32_t Count);
+int32_t lwStackSnapshotScalar(const lwStack* Stack, uint16_t* Result);
+
+// Name of the kernels selected for the CPU.
+const char* lwStackImplementationName();
+
+#endif
\ No newline at end of file
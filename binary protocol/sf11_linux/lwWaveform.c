@@ -0,0 +1,377 @@
+#include "lwWaveform.h"
+#include "lwCpu.h"
+#include <string.h>
+
+// Samples unpacked at a time, a whole packet 32 at most.
+#define LW_WAVEFORM_UNPACK_BLOCK	256
+
+typedef void (*lwUnpackFunc)(const uint8_t* Data, int32_t Count, uint16_t* Samples, uint32_t* Starts);
+typedef int32_t (*lwDecimateFunc)(const uint16_t* Samples, int32_t Count, int32_t Factor, uint16_t* Result);
+
+static void _unpackScalar(const uint8_t* Data, int32_t Count, uint16_t* Samples, uint32_t* Starts);
+static int32_t _decimateScalar(const uint16_t* Samples, int32_t Count, int32_t Factor, uint16_t* Result);
+
+static lwUnpackFunc _unpack = _unpackScalar;
+static lwDecimateFunc _decimate = _decimateScalar;
+static const char* _waveformName = "scalar";
+
+// Byte shuffles that gather every Nth sample into 8 outputs, one per input register of 8 samples. An index
+// with the top bit set gives 0, so the shuffled registers are combined with OR.
+static uint8_t _decimateMasks[LW_WAVEFORM_MAX_SIMD_DECIMATION + 1][LW_WAVEFORM_MAX_SIMD_DECIMATION][16];
+
+//-------------------------------------------------------------------------
+// Unpacking kernels.
+// Each copies the first 2 bytes of every 4 byte sample, clears the start
+// flag, and sets bit i of Starts for each sample i that carried the flag.
+//-------------------------------------------------------------------------
+static void _unpackScalar(const uint8_t* Data, int32_t Count, uint16_t* Samples, uint32_t* Starts) {
+	for (int32_t i = 0; i < Count; ++i) {
+		uint16_t value = (uint16_t)Data[i * 4] | ((uint16_t)Data[i * 4 + 1] << 8);
+
+		Samples[i] = value & 0x7FFF;
+
+		if (value & 0x8000) {
+			Starts[i >> 5] |= 1u << (i & 31);
+		}
+	}
+}
+
+#if defined(LW_CPU_X86)
+LW_CPU_TARGET("sse2") static void _unpackSse2(const uint8_t* Data, int32_t Count, uint16_t* Samples, uint32_t* Starts) {
+	__m128i valueMask = _mm_set1_epi16(0x7FFF);
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		__m128i low = _mm_loadu_si128((const __m128i*)(Data + i * 4));
+		__m128i high = _mm_loadu_si128((const __m128i*)(Data + i * 4 + 16));
+		// NOTE: Shifting the sample to the top of its 32 bit lane and back sign extends it, so the signed pack
+		// keeps every sample exactly, with the start flag as the sign.
+		low = _mm_srai_epi32(_mm_slli_epi32(low, 16), 16);
+		high = _mm_srai_epi32(_mm_slli_epi32(high, 16), 16);
+		__m128i values = _mm_packs_epi32(low, high);
+		// A second signed pack saturates every sample to a byte with the same sign.
+		uint32_t starts = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(values, _mm_setzero_si128()));
+
+		_mm_storeu_si128((__m128i*)(Samples + i), _mm_and_si128(values, valueMask));
+		Starts[i >> 5] |= starts << (i & 31);
+	}
+
+	uint32_t tail[1] = { 0 };
+	_unpackScalar(Data + i * 4, Count - i, Samples + i, tail);
+	Starts[i >> 5] |= tail[0] << (i & 31);
+}
+
+LW_CPU_TARGET("ssse3") static int32_t _decimateSsse3(const uint16_t* Samples, int32_t Count, int32_t Factor, uint16_t* Result) {
+	if (Factor > LW_WAVEFORM_MAX_SIMD_DECIMATION) {
+		return _decimateScalar(Samples, Count, Factor, Result);
+	}
+
+	int32_t o = 0;
+
+	for (; (o + 8) * Factor <= Count; o += 8) {
+		const uint16_t* block = Samples + o * Factor;
+		__m128i result = _mm_setzero_si128();
+
+		// NOTE: Every register of the block is read before the result is stored, so this also works in place.
+		for (int32_t r = 0; r < Factor; ++r) {
+			__m128i values = _mm_loadu_si128((const __m128i*)(block + r * 8));
+			result = _mm_or_si128(result, _mm_shuffle_epi8(values, _mm_loadu_si128((const __m128i*)_decimateMasks[Factor][r])));
+		}
+
+		_mm_storeu_si128((__m128i*)(Result + o), result);
+	}
+
+	return o + _decimateScalar(Samples + o * Factor, Count - o * Factor, Factor, Result + o);
+}
+
+#elif defined(LW_CPU_NEON)
+static void _unpackNeon(const uint8_t* Data, int32_t Count, uint16_t* Samples, uint32_t* Starts) {
+	static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+	uint8x16_t weight = vld1q_u8(weights);
+	int32_t i = 0;
+
+	for (; i + 16 <= Count; i += 16) {
+		// NOTE: Deinterleaving by 4 puts the low and high bytes of 16 samples in the first two registers.
+		uint8x16x4_t bytes = vld4q_u8(Data + i * 4);
+		uint8x16_t flags = vandq_u8(vshrq_n_u8(bytes.val[1], 7), vdupq_n_u8(1));
+		uint8x16_t bits = vmulq_u8(flags, weight);
+		uint32_t starts = (uint32_t)vaddv_u8(vget_low_u8(bits)) | ((uint32_t)vaddv_u8(vget_high_u8(bits)) << 8);
+
+		uint8x16x2_t values;
+		values.val[0] = bytes.val[0];
+		values.val[1] = vandq_u8(bytes.val[1], vdupq_n_u8(0x7F));
+		vst2q_u8((uint8_t*)(Samples + i), values);
+		Starts[i >> 5] |= starts << (i & 31);
+	}
+
+	uint32_t tail[1] = { 0 };
+	_unpackScalar(Data + i * 4, Count - i, Samples + i, tail);
+	Starts[i >> 5] |= tail[0] << (i & 31);
+}
+
+static int32_t _decimateNeon(const uint16_t* Samples, int32_t Count, int32_t Factor, uint16_t* Result) {
+	if (Factor > LW_WAVEFORM_MAX_SIMD_DECIMATION) {
+		return _decimateScalar(Samples, Count, Factor, Result);
+	}
+
+	int32_t o = 0;
+
+	for (; (o + 8) * Factor <= Count; o += 8) {
+		const uint16_t* block = Samples + o * Factor;
+		uint8x16_t result = vdupq_n_u8(0);
+
+		for (int32_t r = 0; r < Factor; ++r) {
+			uint8x16_t values = vld1q_u8((const uint8_t*)(block + r * 8));
+			result = vorrq_u8(result, vqtbl1q_u8(values, vld1q_u8(_decimateMasks[Factor][r])));
+		}
+
+		vst1q_u8((uint8_t*)(Result + o), result);
+	}
+
+	return o + _decimateScalar(Samples + o * Factor, Count - o * Factor, Factor, Result + o);
+}
+#endif
+
+//-------------------------------------------------------------------------
+// Decimation.
+//-------------------------------------------------------------------------
+static int32_t _decimateScalar(const uint16_t* Samples, int32_t Count, int32_t Factor, uint16_t* Result) {
+	int32_t count = 0;
+
+	for (int32_t i = 0; i < Count; i += Factor) {
+		Result[count++] = Samples[i];
+	}
+
+	return count;
+}
+
+static void _buildDecimateMasks() {
+	for (int32_t factor = 1; factor <= LW_WAVEFORM_MAX_SIMD_DECIMATION; ++factor) {
+		memset(_decimateMasks[factor], 0x80, sizeof(_decimateMasks[factor]));
+
+		for (int32_t j = 0; j < 8; ++j) {
+			int32_t source = j * factor;
+			uint8_t* mask = _decimateMasks[factor][source / 8];
+			mask[j * 2] = (uint8_t)((source % 8) * 2);
+			mask[j * 2 + 1] = (uint8_t)((source % 8) * 2 + 1);
+		}
+	}
+}
+
+LW_CPU_INITIALIZER(_waveformInit) {
+	_buildDecimateMasks();
+
+#if defined(LW_CPU_X86)
+	if (LW_CPU_SUPPORTS("sse2")) {
+		_unpack = _unpackSse2;
+		_waveformName = "sse2";
+	}
+
+	if (LW_CPU_SUPPORTS("ssse3")) {
+		_decimate = _decimateSsse3;
+		_waveformName = "ssse3";
+	}
+#elif defined(LW_CPU_NEON)
+	_unpack = _unpackNeon;
+	_decimate = _decimateNeon;
+	_waveformName = "neon";
+#endif
+}
+
+int32_t lwWaveformDecimate(const uint16_t* Samples, int32_t Count, int32_t Factor, uint16_t* Result) {
+	if (Factor <= 1) {
+		memmove(Result, Samples, Count * sizeof(uint16_t));
+		return Count;
+	}
+
+	return _decimate(Samples, Count, Factor, Result);
+}
+
+int32_t lwWaveformDecimateScalar(const uint16_t* Samples, int32_t Count, int32_t Factor, uint16_t* Result) {
+	return _decimateScalar(Samples, Count, (Factor > 1) ? Factor : 1, Result);
+}
+
+const char* lwWaveformImplementationName() {
+	return _waveformName;
+}
+
+//-------------------------------------------------------------------------
+// Reassembly.
+//-------------------------------------------------------------------------
+void lwWaveformInit(lwWaveformAssembler* Assembler, int32_t Decimation) {
+	for (int32_t i = 0; i < LW_WAVEFORM_POOL_SIZE; ++i) {
+		Assembler->freeList[i] = LW_WAVEFORM_POOL_SIZE - 1 - i;
+	}
+
+	Assembler->freeCount = LW_WAVEFORM_POOL_SIZE;
+	Assembler->queueHead = 0;
+	Assembler->queueCount = 0;
+	Assembler->current = -1;
+	Assembler->sequence = 0;
+	Assembler->decimation = (Decimation > 1) ? Decimation : 1;
+	Assembler->expectedLength = 0;
+	Assembler->lastLength = 0;
+	Assembler->completeCount = 0;
+	Assembler->droppedCount = 0;
+	Assembler->incompleteCount = 0;
+}
+
+// Checks the length of a finished waveform, decimates it, and queues it.
+static void _completeWaveform(lwWaveformAssembler* Assembler) {
+	lwWaveform* frame = &Assembler->frames[Assembler->current];
+	int32_t length = frame->sampleCount;
+
+	// NOTE: Lost packets shorten a waveform and a lost start flag joins two, so either shows as a length that
+	// differs from the usual one.
+	if (Assembler->expectedLength > 0 && length != Assembler->expectedLength) {
+		frame->incomplete = 1;
+	}
+
+	if (!frame->incomplete) {
+		if (Assembler->expectedLength == 0 && length == Assembler->lastLength) {
+			Assembler->expectedLength = length;
+		}
+
+		Assembler->lastLength = length;
+	}
+
+	frame->rawSampleCount = length;
+	frame->sampleCount = lwWaveformDecimate(frame->samples, length, Assembler->decimation, frame->samples);
+
+	Assembler->queue[(Assembler->queueHead + Assembler->queueCount) % LW_WAVEFORM_POOL_SIZE] = Assembler->current;
+	++Assembler->queueCount;
+	++Assembler->completeCount;
+
+	if (frame->incomplete) {
+		++Assembler->incompleteCount;
+	}
+
+	Assembler->current = -1;
+}
+
+// Queues the waveform being filled and takes a free frame for the next. Returns the number of waveforms queued.
+static int32_t _beginWaveform(lwWaveformAssembler* Assembler) {
+	int32_t completed = 0;
+
+	if (Assembler->current != -1) {
+		_completeWaveform(Assembler);
+		completed = 1;
+	}
+
+	uint32_t sequence = Assembler->sequence++;
+
+	if (Assembler->freeCount == 0) {
+		// NOTE: Waveforms already queued are kept, the application has not had them yet.
+		++Assembler->droppedCount;
+		return completed;
+	}
+
+	Assembler->current = Assembler->freeList[--Assembler->freeCount];
+
+	lwWaveform* frame = &Assembler->frames[Assembler->current];
+	frame->sequence = sequence;
+	frame->sampleCount = 0;
+	frame->rawSampleCount = 0;
+	frame->incomplete = 0;
+
+	return completed;
+}
+
+static void _appendRun(lwWaveformAssembler* Assembler, const uint16_t* Samples, int32_t Count) {
+	// Samples before the first start flag, or of a dropped waveform, have no frame.
+	if (Assembler->current == -1) {
+		return;
+	}
+
+	lwWaveform* frame = &Assembler->frames[Assembler->current];
+	int32_t space = LW_WAVEFORM_MAX_SAMPLES - frame->sampleCount;
+
+	if (Count > space) {
+		frame->incomplete = 1;
+		Count = space;
+	}
+
+	memcpy(frame->samples + frame->sampleCount, Samples, Count * sizeof(uint16_t));
+	frame->sampleCount += Count;
+}
+
+// Returns the first sample from From with its start bit set, or Count if there is none.
+static int32_t _nextStart(const uint32_t* Starts, int32_t From, int32_t Count) {
+	while (From < Count) {
+		uint32_t bits = Starts[From >> 5] >> (From & 31);
+
+		if (bits) {
+			int32_t index = From + __builtin_ctz(bits);
+			return (index < Count) ? index : Count;
+		}
+
+		From = (From | 31) + 1;
+	}
+
+	return Count;
+}
+
+int32_t lwWaveformAddSamples(lwWaveformAssembler* Assembler, const uint8_t* Data, int32_t SampleCount) {
+	uint16_t samples[LW_WAVEFORM_UNPACK_BLOCK];
+	uint32_t starts[LW_WAVEFORM_UNPACK_BLOCK / 32];
+	int32_t completed = 0;
+
+	for (int32_t block = 0; block < SampleCount; block += LW_WAVEFORM_UNPACK_BLOCK) {
+		int32_t count = SampleCount - block;
+
+		if (count > LW_WAVEFORM_UNPACK_BLOCK) {
+			count = LW_WAVEFORM_UNPACK_BLOCK;
+		}
+
+		memset(starts, 0, sizeof(starts));
+		_unpack(Data + block * 4, count, samples, starts);
+
+		// Copy the runs between start flags as blocks.
+		int32_t pos = 0;
+
+		while (pos < count) {
+			if (starts[pos >> 5] & (1u << (pos & 31))) {
+				completed += _beginWaveform(Assembler);
+			}
+
+			int32_t next = _nextStart(starts, pos + 1, count);
+			_appendRun(Assembler, samples + pos, next - pos);
+			pos = next;
+		}
+	}
+
+	return completed;
+}
+
+int32_t lwWaveformAddPacket(lwWaveformAssembler* Assembler, lwResponsePacket* Response) {
+	int32_t sampleCount = Response->data[4];
+
+	// NOTE: The last sample only needs its first 2 bytes before the CRC.
+	if (Response->data[3] != 32 || sampleCount == 0 || 4 + sampleCount * 4 > Response->size - 2) {
+		return -1;
+	}
+
+	return lwWaveformAddSamples(Assembler, Response->data + 6, sampleCount);
+}
+
+void lwWaveformMarkGap(lwWaveformAssembler* Assembler) {
+	if (Assembler->current != -1) {
+		Assembler->frames[Assembler->current].incomplete = 1;
+	}
+}
+
+lwWaveform* lwWaveformAcquire(lwWaveformAssembler* Assembler) {
+	if (Assembler->queueCount == 0) {
+		return 0;
+	}
+
+	int32_t index = Assembler->queue[Assembler->queueHead];
+	Assembler->queueHead = (Assembler->queueHead + 1) % LW_WAVEFORM_POOL_SIZE;
+	--Assembler->queueCount;
+
+	return &Assembler->frames[index];
+}
+
+void lwWaveformRelease(lwWaveformAssembler* Assembler, lwWaveform* Waveform) {
+	Assembler->freeList[Assembler->freeCount++] = (int32_t)(Waveform - Assembler->frames);
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+//-------------------------------------------------------------------------
+// SF11 waveform reassembly.
+//
+// Packet 32 carries a group of waveform samples. The low 15 bits of each
+// sample are the signal, and the 0x8000 bit marks the first sample of a
+// new waveform of roughly 1450 samples. The assembler unpacks each packet
+// in bulk and copies the samples into waveform frames taken from a fixed
+// pool, so streaming never allocates. Complete waveforms are queued with
+// a sequence number until the application acquires and releases them.
+//-------------------------------------------------------------------------
+#ifndef __LWWAVEFORM_H__
+#define __LWWAVEFORM_H__
+
+#include <stdint.h>
+#include "lwnx.h"
+
+// Samples a frame can hold, enough for one SF11 waveform with margin.
+#define LW_WAVEFORM_MAX_SAMPLES		2048
+// Number of frames in the pool, shared by the frame being filled and the queue of complete waveforms.
+#define LW_WAVEFORM_POOL_SIZE		8
+// Largest decimation factor with a vectorized kernel. Larger factors use the scalar loop.
+#define LW_WAVEFORM_MAX_SIMD_DECIMATION	8
+
+typedef struct {
+	// Counts every waveform that started, including dropped ones, so a jump shows waveforms were lost.
+	uint32_t sequence;
+	// Samples in the frame after decimation, and before it.
+	int32_t sampleCount;
+	int32_t rawSampleCount;
+	// Set when samples are known to be missing or the waveform did not fit, see lwWaveformMarkGap.
+	uint8_t incomplete;
+	// 15 bit samples with the start flag removed. Sample 0 is the one that carried the flag.
+	uint16_t samples[LW_WAVEFORM_MAX_SAMPLES];
+
+} lwWaveform;
+
+typedef struct {
+	lwWaveform frames[LW_WAVEFORM_POOL_SIZE];
+
+	// Indices of frames not in use.
+	int32_t freeList[LW_WAVEFORM_POOL_SIZE];
+	int32_t freeCount;
+
+	// Complete waveforms waiting to be acquired, oldest first.
+	int32_t queue[LW_WAVEFORM_POOL_SIZE];
+	int32_t queueHead;
+	int32_t queueCount;
+
+	// Frame being filled, or -1 while waiting for the next start flag. Also -1 while the samples of a waveform that had no
+	// free frame are discarded.
+	int32_t current;
+
+	uint32_t sequence;
+	// Keep every Nth sample of a complete waveform. 1 keeps them all.
+	int32_t decimation;
+	// Expected raw length of a waveform. 0 learns it from the first two consecutive waveforms of equal length.
+	int32_t expectedLength;
+	int32_t lastLength;
+
+	uint32_t completeCount;
+	// Waveforms lost because no frame was free.
+	uint32_t droppedCount;
+	// Waveforms queued as incomplete.
+	uint32_t incompleteCount;
+
+} lwWaveformAssembler;
+
+// Prepares the assembler with every frame free. Decimation of 1 keeps every sample.
+void lwWaveformInit(lwWaveformAssembler* Assembler, int32_t Decimation);
+
+// Adds the samples of a packet 32 response. Returns the number of waveforms completed by it, or -1 if the
+// packet is not a valid waveform packet.
+int32_t lwWaveformAddPacket(lwWaveformAssembler* Assembler, lwResponsePacket* Response);
+
+// Adds samples as they appear in a packet 32 payload, 4 bytes per sample with the value in the first 2.
+int32_t lwWaveformAddSamples(lwWaveformAssembler* Assembler, const uint8_t* Data, int32_t SampleCount);
+
+// Marks the waveform being filled as incomplete. Call when packets may have been lost, like after a
+// receive timeout, since packet 32 has no sequence number to detect that from.
+void lwWaveformMarkGap(lwWaveformAssembler* Assembler);
+
+// Returns the oldest complete waveform, or 0 if there is none. The frame belongs to the caller until
+// it is passed to lwWaveformRelease.
+lwWaveform* lwWaveformAcquire(lwWaveformAssembler* Assembler);
+
+// Returns a frame from lwWaveformAcquire to the pool.
+void lwWaveformRelease(lwWaveformAssembler* Assembler, lwWaveform* Waveform);
+
+// Keeps samples 0, Factor, 2 * Factor, ... of Samples, writing them from the start of Result, which may be
+// Samples itself. Returns the number of samples kept.
+int32_t lwWaveformDecimate(const uint16_t* Samples, int32_t Count, int32_t Factor, uint16_t* Result);
+
+// lwWaveformDecimate with the scalar kernel, to check the selected one against.
+int32_t lwWaveformDecimateScalar(const uint16_t* Samples, int32_t Count, int32_t Factor, uint16_t* Result);
+
+// Name of the kernels selected for the CPU.
+const char* lwWaveformImplementationName();
+
+#endif
\ No newline at end of file
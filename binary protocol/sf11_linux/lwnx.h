@@ -6,15 +6,39 @@
 #define PACKET_START_BYTE	0xAA
 #define PACKET_TIMEOUT		200
 #define PACKET_RETRIES		4
+#define PACKET_MAX_SIZE		1022
 
 typedef int32_t (*writeCallbackFuncPtr)(uint8_t* Data, int32_t BufferSize);
 typedef int32_t (*readCallbackFuncPtr)(uint8_t* Data, int32_t BufferSize);
 typedef int32_t (*timeCallbackFuncPtr)();
+typedef int32_t (*waitCallbackFuncPtr)(int32_t TimeoutMs);
 
 typedef struct {
 	writeCallbackFuncPtr writeCallback;
 	readCallbackFuncPtr readCallback;
 	timeCallbackFuncPtr timeCallback;
+	// Optional. Blocks until data can be read or TimeoutMs has passed, so receiving does not spin on the read callback.
+	waitCallbackFuncPtr waitCallback;
+
+	// Round trip time estimate, maintained by lwnxHandleManagedCmd. The retry timeout follows the smoothed round trip
+	// time and its variation, as TCP does (RFC 6298). rttSampleCount is 0 until the first response is measured.
+	int32_t rttSampleCount;
+	int32_t srttMs;
+	int32_t rttvarMs;
+	int32_t timeoutMs;
+
+	// Retry policy, 0 selects the default.
+	int32_t minTimeoutMs;		// Default 5.
+	int32_t maxTimeoutMs;		// Default PACKET_TIMEOUT.
+	int32_t backoffPercent;		// Each retry waits this percentage of the previous timeout. Default 200.
+	int32_t maxAttempts;		// Times a read is sent. Writes are sent once. Default PACKET_RETRIES.
+	int32_t deadlineMs;			// Overall time allowed for a command. Default PACKET_TIMEOUT * PACKET_RETRIES.
+
+	// Replies still owed to earlier sends of a command that is done, dropped until lateReplyTimeMs so they can't complete
+	// the next command with the same id. Maintained by lwnxHandleManagedCmd.
+	int32_t lateReplyCount;
+	uint8_t lateReplyCommandId;
+	int32_t lateReplyTimeMs;
 
 } lwEndpoint;
 
@@ -24,24 +48,56 @@ typedef struct {
 	int32_t payloadSize;
 	uint8_t parseState;
 	uint8_t cmdId;
+	uint16_t crc;
 
 } lwResponsePacket;
 
+// A complete packet located in a buffer passed to lwnxParseBuffer.
+typedef struct {
+	int32_t offset;
+	int32_t size;
+
+} lwPacketSpan;
+
+// State carried between calls to lwnxParseBuffer.
+typedef struct {
+	// Size of the incomplete packet left unconsumed by the last call, or 0 if its header was not complete.
+	int32_t pendingSize;
+	// Running CRC over the first crcSize bytes of the incomplete packet, so they are not hashed again.
+	uint16_t crc;
+	int32_t crcSize;
+	int32_t packetCount;
+	int32_t invalidCrcCount;
+	int32_t invalidSizeCount;
+
+} lwPacketParser;
+
 //----------------------------------------------------------------------------------------------------------------------------------
 // Helper utilities.
 //----------------------------------------------------------------------------------------------------------------------------------
 // Create a CRC-16-CCITT 0x1021 hash of the specified data.
 uint16_t lwnxCreateCrc(uint8_t* Data, uint16_t Size);
 
+// Continue a CRC-16-CCITT 0x1021 hash over the specified data.
+uint16_t lwnxUpdateCrc(uint16_t Crc, uint8_t* Data, uint16_t Size);
+
 // Breaks an integer firmware version into Major, Minor, and Patch.
 void lwnxConvertFirmwareVersionToStr(uint32_t Version, char* String);
 
+// Adds a round trip time measurement to the estimate and derives a new retry timeout from it.
+void lwnxUpdateLinkTiming(lwEndpoint* Endpoint, int32_t RoundTripMs);
+
 //----------------------------------------------------------------------------------------------------------------------------------
 // LWNX protocol implementation.
 //----------------------------------------------------------------------------------------------------------------------------------
 // Prepare a response packet for a new incoming response.
 void lwnxInitResponsePacket(lwResponsePacket* Response);
 
+// Finds every complete, CRC-valid packet in Data and writes its location to Packets, up to MaxPackets.
+// Returns the number of packets found. Consumed receives the number of bytes processed; any remaining bytes
+// hold the start of an incomplete packet and must be passed again at the start of the next call.
+int32_t lwnxParseBuffer(lwPacketParser* Parser, uint8_t* Data, int32_t Size, lwPacketSpan* Packets, int32_t MaxPackets, int32_t* Consumed);
+
 // Waits to receive a packet of specific command id.
 // Does not return until a response is received or a timeout occurs.
 uint8_t lwnxRecvPacket(lwEndpoint* Endpoint, uint8_t CommandId, lwResponsePacket* Response, uint32_t TimeoutMs);
@@ -56,8 +112,9 @@ uint8_t lwnxRecvPacketNoBlock(lwEndpoint* Endpoint, uint8_t CommandId, lwRespons
 // Composes and sends a packet.
 void lwnxSendPacketBytes(lwEndpoint* Endpoint, uint8_t CommandId, uint8_t Write, uint8_t* Data, uint32_t DataSize);
 
-// Handle both the sending and receving of a command. 
-// Does not return until a response is received or all retries have expired.
+// Handle both the sending and receving of a command. Reads are sent again when their timeout passes, writes only once,
+// since sending a write again repeats its effect. The last attempt waits until the deadline.
+// Does not return until a response is received or the deadline has passed.
 uint8_t lwnxHandleManagedCmd(lwEndpoint* Endpoint, uint8_t CommandId, uint8_t* Response, uint32_t ResponseSize, uint8_t Write, uint8_t* WriteData, uint32_t WriteSize);
 
 //----------------------------------------------------------------------------------------------------------------------------------
@@ -8,9 +8,12 @@
 #include <unistd.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <poll.h>
 #include "time.h"
 
 #include "lwnx.h"
+#include "lwWaveform.h"
+#include "lwEcho.h"
 
 //-------------------------------------------------------------------------
 // Platform Implementation.
@@ -19,12 +22,13 @@
 //-------------------------------------------------------------------------
 int g_serialPortFd = -1;
 
-// Get the time in milliseconds from the system. Does not need to start at 0.
+// Get the time in milliseconds from the system. Does not need to start at 0, and may wrap.
+// CLOCK_MONOTONIC_RAW is not stepped by NTP, so timeouts are not affected by changes to the system time.
 int32_t getTimeMilliseconds() {
 	struct timespec time;
-	clock_gettime(CLOCK_REALTIME, &time);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &time);
 
-	return (time.tv_sec * 1000000 + time.tv_nsec / 1000) / 1000;
+	return (int32_t)((int64_t)time.tv_sec * 1000 + time.tv_nsec / 1000000);
 }
 
 // Initiate a serial port connection.
@@ -58,8 +62,9 @@ int portConnect(const char* Name, int BitRate) {
 	tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
 	tty.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
 	tty.c_oflag &= ~OPOST;
+	// NOTE: Reads return immediately, waiting for data is done with poll.
 	tty.c_cc[VMIN] = 0;
-	tty.c_cc[VTIME] = 1;
+	tty.c_cc[VTIME] = 0;
 
 	if (tcsetattr(g_serialPortFd, TCSANOW, &tty) != 0) {
 		printf("Error from tcsetattr\n");
@@ -100,6 +105,15 @@ int portRead(uint8_t* Buffer, int32_t BufferSize) {
 	return readBytes;
 }
 
+// Wait up to TimeoutMs for data to be available on the serial port.
+int32_t portWait(int32_t TimeoutMs) {
+	struct pollfd descriptor = {};
+	descriptor.fd = g_serialPortFd;
+	descriptor.events = POLLIN;
+
+	return poll(&descriptor, 1, TimeoutMs);
+}
+
 // Write a 16bit entry into the log.
 void logData(uint16_t Data) {
 	// NOTE: Needs to be implemented based on platform.
@@ -114,13 +128,15 @@ int main(int args, char** argv)
 
 	// Make sure the SF11 has serial output baud rate configured to 921600.
 	// 921600 bps is needed to support the incoming data which is ~60 KB/s.
-	portConnect("/dev/ttyUSB0", B921600);
+	// The port can be passed as the first argument, like the pseudo terminal of the emulator.
+	portConnect(args > 1 ? argv[1] : "/dev/ttyUSB0", B921600);
 
 	// Setup serial port callbacks so the LWNX protocol can read/write data through the serial port.
 	lwEndpoint endpoint = {};
 	endpoint.writeCallback = portWrite;
 	endpoint.readCallback = portRead;
 	endpoint.timeCallback = getTimeMilliseconds;
+	endpoint.waitCallback = portWait;
 
 	// Read the product name. (Command 0: Product name)
 	// At least one command is needed to activate LWNX mode. That's why this is here.
@@ -131,7 +147,16 @@ int main(int args, char** argv)
 	// Enable streaming of waveform data. (Command 30: Stream)
 	lwnxCmdWriteUInt32(&endpoint, 30, 1);
 
-	int32_t waveformSampleId = 0;
+	// Waveforms are reassembled into preallocated frames at full resolution.
+	// There are roughly 1450 samples per waveform.
+	// Logging every 3rd sample would be 1450 / 3 * 2 = ~0.9 KB per waveform,
+	// so only the echoes found in each waveform are logged, 4 bytes each.
+	static lwWaveformAssembler waveforms;
+	lwWaveformInit(&waveforms, 1);
+
+	lwEchoConfig echoConfig;
+	lwEchoInitConfig(&echoConfig);
+	lwEchoList echoes;
 
 	// Continuously wait for and process incoming data packets.
 	while (1) {
@@ -142,31 +167,23 @@ int main(int args, char** argv)
 			
 			if (response.cmdId == 32) {
 				// Packet 32 contains waveform samples.
+				lwWaveformAddPacket(&waveforms, &response);
 
-				uint8_t sampleCount = response.data[4];
-				
-				for (int i = 0; i < sampleCount; ++i) {
-					int32_t idx = 6 + i * 4;
-					uint16_t value = (uint16_t)response.data[idx + 0] | ((uint16_t)response.data[idx + 1] << 8);
-					int8_t waveformStart = (value & 0x8000) != 0;
-					uint16_t waveformSample = value & 0x7FFF;
-
-					if (waveformStart) {
-						waveformSampleId = 0;
-						
-						// Log a marker to indicate the begining of a waveform.
-						logData(0xFFFF);
-					} else {
-						++waveformSampleId;
-
-						// Only need to log every 3rd sample of the waveform data.
-						// There are roughly 1450 samples per waveform.
-						// Each sample is 2 bytes.
-						// 1450 / 3 * 2 = ~0.9 KB per waveform.
-						if (waveformSampleId % 3 == 0) {
-							logData(waveformSample);
-						}
+				lwWaveform* waveform;
+
+				while ((waveform = lwWaveformAcquire(&waveforms)) != 0) {
+					lwEchoFromWaveform(&echoConfig, waveform, &echoes);
+
+					// Log a marker to indicate the begining of a waveform, then its echoes.
+					logData(0xFFFF);
+					logData((uint16_t)echoes.count);
+
+					for (int i = 0; i < echoes.count; ++i) {
+						logData(echoes.echoes[i].position);
+						logData(echoes.echoes[i].amplitude);
 					}
+
+					lwWaveformRelease(&waveforms, waveform);
 				}
 			} else if (response.cmdId == 39) {
 				// Packet 39 contains distance results (as would normally be output by the sensor).
@@ -177,6 +194,9 @@ int main(int args, char** argv)
 
 				printf("Distance info: %f\n", filteredDistance);
 			}
+		} else {
+			// Packets may have been lost while nothing arrived.
+			lwWaveformMarkGap(&waveforms);
 		}
 	}
 
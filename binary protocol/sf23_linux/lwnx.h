@@ -10,11 +10,20 @@
 typedef int32_t (*writeCallbackFuncPtr)(uint8_t* Data, int32_t BufferSize);
 typedef int32_t (*readCallbackFuncPtr)(uint8_t* Data, int32_t BufferSize);
 typedef int32_t (*timeCallbackFuncPtr)();
+typedef int32_t (*waitCallbackFuncPtr)(int32_t TimeoutMs);
 
 typedef struct {
 	writeCallbackFuncPtr writeCallback;
 	readCallbackFuncPtr readCallback;
 	timeCallbackFuncPtr timeCallback;
+	// Optional. Blocks until data can be read or TimeoutMs has passed, so receiving does not spin on the read callback.
+	waitCallbackFuncPtr waitCallback;
+
+	// Replies still owed to earlier sends of a command that is done, dropped until lateReplyTimeMs so they can't complete
+	// the next command with the same id. Maintained by lwnxHandleManagedCmd.
+	int32_t lateReplyCount;
+	uint8_t lateReplyCommandId;
+	int32_t lateReplyTimeMs;
 
 } lwEndpoint;
 
@@ -53,8 +62,8 @@ uint8_t lwnxRecvPacketNoBlock(lwEndpoint* Endpoint, uint8_t CommandId, lwRespons
 // Composes and sends a packet.
 void lwnxSendPacketBytes(lwEndpoint* Endpoint, uint8_t CommandId, uint8_t Write, uint8_t* Data, uint32_t DataSize);
 
-// Handle both the sending and receving of a command. 
-// Does not return until a response is received or all retries have expired.
+// Handle both the sending and receving of a command. Reads are sent again every PACKET_TIMEOUT, writes only once, since
+// sending a write again repeats its effect. Does not return until a response is received or all retries have expired.
 uint8_t lwnxHandleManagedCmd(lwEndpoint* Endpoint, uint8_t CommandId, uint8_t* Response, uint32_t ResponseSize, uint8_t Write, uint8_t* RequestData, uint32_t RequestSize);
 
 //----------------------------------------------------------------------------------------------------------------------------------
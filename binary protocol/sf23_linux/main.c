@@ -8,6 +8,7 @@
 #include <unistd.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <poll.h>
 #include "time.h"
 
 #include "lwnx.h"
@@ -19,12 +20,13 @@
 //-------------------------------------------------------------------------
 int g_serialPortFd = -1;
 
-// Get the time in milliseconds from the system. Does not need to start at 0.
+// Get the time in milliseconds from the system. Does not need to start at 0, and may wrap.
+// CLOCK_MONOTONIC_RAW is not stepped by NTP, so timeouts are not affected by changes to the system time.
 int32_t getTimeMilliseconds() {
 	struct timespec time;
-	clock_gettime(CLOCK_REALTIME, &time);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &time);
 
-	return (time.tv_sec * 1000000 + time.tv_nsec / 1000) / 1000;
+	return (int32_t)((int64_t)time.tv_sec * 1000 + time.tv_nsec / 1000000);
 }
 
 // Initiate a serial port connection.
@@ -58,8 +60,9 @@ int portConnect(const char* Name, int BitRate) {
 	tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
 	tty.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
 	tty.c_oflag &= ~OPOST;
+	// NOTE: Reads return immediately, waiting for data is done with poll.
 	tty.c_cc[VMIN] = 0;
-	tty.c_cc[VTIME] = 1;
+	tty.c_cc[VTIME] = 0;
 
 	if (tcsetattr(g_serialPortFd, TCSANOW, &tty) != 0) {
 		printf("Error from tcsetattr\n");
@@ -100,6 +103,15 @@ int portRead(uint8_t* Buffer, int32_t BufferSize) {
 	return readBytes;
 }
 
+// Wait up to TimeoutMs for data to be available on the serial port.
+int32_t portWait(int32_t TimeoutMs) {
+	struct pollfd descriptor = {};
+	descriptor.fd = g_serialPortFd;
+	descriptor.events = POLLIN;
+
+	return poll(&descriptor, 1, TimeoutMs);
+}
+
 //-------------------------------------------------------------------------
 // Read version information.
 //-------------------------------------------------------------------------
@@ -209,13 +221,15 @@ int main(int args, char** argv)
 {
 	printf("SF23 LWNX sample\n");
 
-	portConnect("/dev/ttyUSB0", B921600);
+	// The port can be passed as the first argument, like the pseudo terminal of the emulator.
+	portConnect(args > 1 ? argv[1] : "/dev/ttyUSB0", B921600);
 
 	// Setup serial port callbacks so the LWNX protocol can read/write data through the serial port.
 	lwEndpoint endpoint = {};
 	endpoint.writeCallback = portWrite;
 	endpoint.readCallback = portRead;
 	endpoint.timeCallback = getTimeMilliseconds;
+	endpoint.waitCallback = portWait;
 
 	readProductInformation(&endpoint);
 	performUpgrade(&endpoint);
@@ -0,0 +1,256 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// LightWare LWNX Full Speed Benchmark.
+// Measures decoding of the SF30/D full speed stream against synthetic data, no device is needed.
+//----------------------------------------------------------------------------------------------------------------------------------
+#include "common.h"
+#include "lwNx.h"
+#include "lwFullSpeed.h"
+
+// Highest update rate of the SF30/D in samples per second.
+#define DEVICE_MAX_RATE	20010
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Helper utilities.
+//----------------------------------------------------------------------------------------------------------------------------------
+// A serial port that returns a stream from memory in reads of up to chunkSize bytes, like a USB serial device.
+class memorySerialPort : public lwSerialPort {
+	public:
+		uint8_t* stream;
+		int32_t streamSize;
+		int32_t position;
+		int32_t chunkSize;
+
+		memorySerialPort(uint8_t* Stream, int32_t StreamSize, int32_t ChunkSize) : stream(Stream), streamSize(StreamSize), position(0), chunkSize(ChunkSize) { }
+
+		bool connect(const char* Name, int BitRate) { return true; }
+		bool disconnect() { return true; }
+		int writeData(uint8_t *Buffer, int32_t BufferSize) { return BufferSize; }
+
+		int32_t readData(uint8_t *Buffer, int32_t BufferSize) {
+			int32_t size = streamSize - position;
+
+			if (size > BufferSize) { size = BufferSize; }
+			if (size > chunkSize) { size = chunkSize; }
+
+			memcpy(Buffer, stream + position, size);
+			position += size;
+
+			return size;
+		}
+};
+
+// Appends a packet to Buffer and returns the number of bytes written.
+int32_t writePacket(uint8_t* Buffer, uint8_t CommandId, uint8_t* Data, uint32_t DataSize) {
+	uint16_t flags = (1 + DataSize) << 6;
+
+	Buffer[0] = PACKET_START_BYTE;
+	Buffer[1] = flags & 0xFF;
+	Buffer[2] = (flags >> 8) & 0xFF;
+	Buffer[3] = CommandId;
+	memcpy(Buffer + 4, Data, DataSize);
+	uint16_t crc = lwnxCreateCrc(Buffer, 4 + DataSize);
+	Buffer[4 + DataSize] = crc & 0xFF;
+	Buffer[5 + DataSize] = (crc >> 8) & 0xFF;
+
+	return 6 + DataSize;
+}
+
+// Fills Buffer with full speed packets (Command 40) of SamplesPerPacket distances each, or a random count when 0.
+// The distances count up from 0 so they can be checked. Returns the size of the stream.
+int32_t createFullSpeedStream(uint8_t* Buffer, int32_t BufferSize, int32_t SamplesPerPacket, int32_t* SampleCount) {
+	uint8_t data[1 + 255 * 2];
+	int32_t size = 0;
+	int32_t samples = 0;
+
+	while (true) {
+		int32_t count = (SamplesPerPacket > 0) ? SamplesPerPacket : 1 + rand() % 255;
+
+		if (size + 7 + count * 2 > BufferSize) {
+			break;
+		}
+
+		data[0] = (uint8_t)count;
+
+		for (int32_t i = 0; i < count; ++i) {
+			uint16_t distance = (uint16_t)(samples + i);
+			data[1 + i * 2] = distance & 0xFF;
+			data[2 + i * 2] = (distance >> 8) & 0xFF;
+		}
+
+		size += writePacket(Buffer + size, 40, data, 1 + count * 2);
+		samples += count;
+	}
+
+	*SampleCount = samples;
+
+	return size;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Benchmarks.
+//----------------------------------------------------------------------------------------------------------------------------------
+// Receives a stream through the serial port receive path and drains the ring in batches, as an application would.
+// Returns the number of samples read and their sum.
+int64_t runFullSpeed(memorySerialPort* Serial, lwFullSpeedRing* Ring, int64_t* Sum) {
+	float distances[4096];
+	int64_t count = 0;
+	double sum = 0;
+
+	Serial->position = 0;
+
+	while (true) {
+		int32_t packets = lwnxPoll(Serial, 0);
+
+		int32_t read;
+
+		while ((read = lwFullSpeedReadMetres(Ring, distances, 4096)) > 0) {
+			for (int32_t i = 0; i < read; ++i) {
+				sum += distances[i];
+			}
+
+			count += read;
+		}
+
+		if (packets == 0 && Serial->position == Serial->streamSize) {
+			break;
+		}
+	}
+
+	*Sum = (int64_t)(sum * 100.0 + 0.5);
+
+	return count;
+}
+
+// Checks every distance arrives once and in order, across packet sizes, ring wrap around and small reads.
+bool verifyFullSpeed() {
+	const int32_t streamSize = 4 * 1024 * 1024;
+	uint8_t* stream = (uint8_t*)malloc(streamSize);
+	int32_t sampleCount = 0;
+	int32_t size = createFullSpeedStream(stream, streamSize, 0, &sampleCount);
+
+	memorySerialPort serial(stream, size, 777);
+	lwFullSpeedRing* ring = new lwFullSpeedRing();
+	lwnxSetPacketHandler(&serial, 40, lwFullSpeedPacketHandler, ring);
+
+	uint16_t distances[1000];
+	int32_t expected = 0;
+
+	while (true) {
+		int32_t packets = lwnxPoll(&serial, 0);
+		int32_t read = lwFullSpeedRead(ring, distances, 1 + rand() % 1000);
+
+		for (int32_t i = 0; i < read; ++i) {
+			if (distances[i] != (uint16_t)expected) {
+				printf("Full speed mismatch: sample %d is %d\n", expected, distances[i]);
+				return false;
+			}
+
+			++expected;
+		}
+
+		if (packets == 0 && read == 0 && serial.position == serial.streamSize) {
+			break;
+		}
+	}
+
+	// A count that does not match the packet size is rejected.
+	uint8_t data[5] = { 3, 1, 0, 2, 0 };
+	int32_t badSize = writePacket(stream, 40, data, 5);
+	memorySerialPort badSerial(stream, badSize, 4096);
+	lwnxSetPacketHandler(&badSerial, 40, lwFullSpeedPacketHandler, ring);
+	lwnxPoll(&badSerial, 0);
+
+	bool passed = expected == sampleCount && ring->droppedCount == 0 && ring->invalidCount == 1 && lwFullSpeedAvailable(ring) == 0;
+
+	printf("Full speed: %d of %d samples in order, %u invalid packet\n", expected, sampleCount, ring->invalidCount);
+
+	delete ring;
+	free(stream);
+
+	return passed;
+}
+
+void benchmarkFullSpeed() {
+	const int32_t streamSize = 16 * 1024 * 1024;
+	const int32_t packetSizes[] = { 1, 10, 50, 255 };
+	uint8_t* stream = (uint8_t*)malloc(streamSize);
+
+	printf("Full speed decoding, device maximum %d samples/s\n", DEVICE_MAX_RATE);
+
+	for (int32_t p = 0; p < 4; ++p) {
+		int32_t sampleCount = 0;
+		int32_t size = createFullSpeedStream(stream, streamSize, packetSizes[p], &sampleCount);
+
+		memorySerialPort serial(stream, size, 4096);
+		lwFullSpeedRing* ring = new lwFullSpeedRing();
+		lwnxSetPacketHandler(&serial, 40, lwFullSpeedPacketHandler, ring);
+
+		int64_t sum = 0;
+		int64_t startTime = platformGetMicrosecond();
+		int64_t count = runFullSpeed(&serial, ring, &sum);
+		double elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+		double rate = count / elapsed;
+
+		printf("  %3d samples/packet: %12.0f samples/s  %8.0fx device rate  (%lld samples, %llu dropped)\n", packetSizes[p], rate, rate / DEVICE_MAX_RATE, (long long)count, (unsigned long long)ring->droppedCount);
+
+		delete ring;
+	}
+
+	// Decoding alone, the copy into the ring from packets that have already been parsed.
+	int32_t sampleCount = 0;
+	int32_t size = createFullSpeedStream(stream, streamSize, 255, &sampleCount);
+	lwPacketParser parser;
+	lwPacketSpan* spans = (lwPacketSpan*)malloc(sizeof(lwPacketSpan) * (size / 517 + 1));
+	int32_t consumed = 0;
+	int32_t packetCount = lwnxParseBuffer(&parser, stream, size, spans, size / 517 + 1, &consumed);
+	lwPacketView* views = (lwPacketView*)malloc(sizeof(lwPacketView) * packetCount);
+
+	for (int32_t i = 0; i < packetCount; ++i) {
+		views[i].data = stream + spans[i].offset;
+		views[i].size = spans[i].size;
+		views[i].commandId = views[i].data[3];
+		views[i].payload = views[i].data + 4;
+		views[i].payloadSize = spans[i].size - 6;
+	}
+
+	lwFullSpeedRing* ring = new lwFullSpeedRing();
+	uint16_t* distances = (uint16_t*)malloc(LW_FULL_SPEED_RING_SIZE * sizeof(uint16_t));
+	const int32_t iterations = 16;
+	int64_t startTime = platformGetMicrosecond();
+
+	for (int32_t n = 0; n < iterations; ++n) {
+		for (int32_t i = 0; i < packetCount; ++i) {
+			lwFullSpeedDecode(ring, &views[i]);
+
+			if (lwFullSpeedAvailable(ring) > LW_FULL_SPEED_RING_SIZE - 255) {
+				lwFullSpeedRead(ring, distances, LW_FULL_SPEED_RING_SIZE);
+			}
+		}
+	}
+
+	double elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+	printf("  ring decode only:    %12.0f samples/s\n", (double)sampleCount * iterations / elapsed);
+
+	delete ring;
+	free(distances);
+	free(views);
+	free(spans);
+	free(stream);
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Application Entry.
+//----------------------------------------------------------------------------------------------------------------------------------
+int main(int args, char **argv) {
+	platformInit();
+
+	printf("LWNX full speed benchmark\n");
+
+	if (!verifyFullSpeed()) {
+		return 1;
+	}
+
+	benchmarkFullSpeed();
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// LightWare LWNX Full Speed Example.
+// Streams distances from the SF30/D at its full output rate and prints a summary every second.
+//----------------------------------------------------------------------------------------------------------------------------------
+#include "common.h"
+#include "lwNx.h"
+#include "lwFullSpeed.h"
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Helper utilities.
+//----------------------------------------------------------------------------------------------------------------------------------
+void exitWithMessage(const char* Msg) {
+	printf("%s\nPress any key to Exit...\n", Msg);
+	std::cin.ignore();
+	exit(1);
+}
+
+void exitCommandFailure() {
+	exitWithMessage("No response to command, terminating sample.\n");
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Application Entry.
+//----------------------------------------------------------------------------------------------------------------------------------
+int main(int args, char **argv)
+{
+	platformInit();
+
+	printf("LWNX full speed sample\n");
+
+	// NOTE: Change the port name to the one assigned by the OS to the plugged in lidar, or pass it as the first argument,
+	// like the pseudo terminal of the emulator.
+#ifdef __linux__
+	const char* portName = "/dev/ttyUSB0";
+#else
+	const char* portName = "\\\\.\\COM4";
+#endif
+
+	if (args > 1) {
+		portName = argv[1];
+	}
+
+	int32_t baudRate = 921600;
+
+	lwSerialPort* serial = platformCreateSerialPort();
+	if (!serial->connect(portName, baudRate)) {
+		exitWithMessage("Could not establish serial connection\n");
+	};
+
+	// NOTE: Find descriptions of each command here http://support.lightware.co.za/sf30d/#/commands
+
+	// Read the product name. (Command 0: Product name)
+	char modelName[16];
+	if (!lwnxCmdReadString(serial, 0, modelName)) { exitCommandFailure(); }
+	printf("Model: %.16s\n", modelName);
+
+	// The full speed packets are copied into the ring as they arrive, including while the start commands wait for their
+	// responses. (Command 40: Full speed distance data)
+	lwFullSpeedRing* ring = new lwFullSpeedRing();
+	lwnxSetPacketHandler(serial, 40, lwFullSpeedPacketHandler, ring);
+
+	if (!lwFullSpeedStart(serial)) { exitCommandFailure(); }
+
+	float distances[4096];
+	int64_t sampleCount = 0;
+	double distanceSum = 0;
+	float closest = 0;
+	int64_t reportTime = platformGetMicrosecond() + 1000000;
+
+	// Continuously receive the streamed packets and drain the ring in batches.
+	while (1) {
+		if (lwnxPoll(serial, 100) == -1) {
+			exitWithMessage("Serial port failed\n");
+		}
+
+		int32_t count;
+
+		while ((count = lwFullSpeedReadMetres(ring, distances, 4096)) > 0) {
+			for (int32_t i = 0; i < count; ++i) {
+				distanceSum += distances[i];
+
+				if (sampleCount == 0 || distances[i] < closest) {
+					closest = distances[i];
+				}
+
+				++sampleCount;
+			}
+		}
+
+		if (platformGetMicrosecond() >= reportTime) {
+			double mean = (sampleCount > 0) ? distanceSum / sampleCount : 0;
+			printf("Samples: %6lld/s  Mean: %7.2f m  Closest: %7.2f m  Dropped: %llu\n", (long long)sampleCount, mean, closest, (unsigned long long)ring->droppedCount);
+
+			sampleCount = 0;
+			distanceSum = 0;
+			reportTime += 1000000;
+		}
+	}
+
+	return 0;
+}
\ No newline at end of file
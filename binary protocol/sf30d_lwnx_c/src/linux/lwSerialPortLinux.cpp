@@ -47,8 +47,9 @@ bool lwSerialPortLinux::connect(const char* Name, int BitRate) {
 	tty.c_iflag &= ~(IXON | IXOFF | IXANY);
 	tty.c_lflag = 0;
 	tty.c_oflag = 0;
+	// NOTE: Reads return immediately, waitForData blocks on readiness instead.
 	tty.c_cc[VMIN] = 0;
-	tty.c_cc[VTIME] = 1;
+	tty.c_cc[VTIME] = 0;
 
 	if (tcsetattr(_descriptor, TCSANOW, &tty) != 0) {
 		printf("Error from tcsetattr\n");
@@ -97,4 +98,22 @@ int32_t lwSerialPortLinux::readData(uint8_t *Buffer, int32_t BufferSize) {
 	int readBytes = read(_descriptor, Buffer, BufferSize);
 
 	return readBytes;
+}
+
+bool lwSerialPortLinux::waitForData(int64_t TimeoutUs) {
+	if (_descriptor < 0) {
+		return false;
+	}
+
+	pollfd descriptor;
+	descriptor.fd = _descriptor;
+	descriptor.events = POLLIN;
+	descriptor.revents = 0;
+
+	timespec timeout;
+	timeout.tv_sec = TimeoutUs / 1000000;
+	timeout.tv_nsec = (TimeoutUs % 1000000) * 1000;
+
+	// NOTE: Errors and hangups also wake the wait, so the following read can report them.
+	return ppoll(&descriptor, 1, &timeout, NULL) > 0;
 }
\ No newline at end of file
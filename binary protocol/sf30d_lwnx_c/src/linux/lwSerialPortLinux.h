@@ -11,4 +11,5 @@ class lwSerialPortLinux : public lwSerialPort {
 		bool disconnect();
 		int writeData(uint8_t *Buffer, int32_t BufferSize);
 		int32_t readData(uint8_t *Buffer, int32_t BufferSize);
+		bool waitForData(int64_t TimeoutUs);
 };
\ No newline at end of file
@@ -3,14 +3,15 @@
 
 void platformInit() { }
 
+// NOTE: CLOCK_MONOTONIC_RAW is not stepped or slewed by NTP, so timeouts and packet timestamps stay consistent.
 int64_t platformGetMicrosecond() {
 	timespec time;
-	clock_gettime(CLOCK_REALTIME, &time);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &time);
 
-	return time.tv_sec * 1000000 + time.tv_nsec / 1000;
+	return (int64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
 }
 
-int32_t platformGetMillisecond() {
+int64_t platformGetMillisecond() {
 	return (platformGetMicrosecond() / 1000);
 }
 
@@ -10,11 +10,12 @@
 #include <termios.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 
 void platformInit();
 
 int64_t platformGetMicrosecond();
-int32_t platformGetMillisecond();
+int64_t platformGetMillisecond();
 bool platformSleep(int32_t TimeMS);
 
 lwSerialPort* platformCreateSerialPort();
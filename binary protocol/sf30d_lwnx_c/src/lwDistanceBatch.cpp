@@ -0,0 +1,196 @@
+#include "lwDistanceBatch.h"
+#include "lwCpu.h"
+
+#include <string.h>
+
+// Number of packets gathered into a block before their values are converted.
+#define LW_DISTANCE_BATCH_BLOCK	256
+
+typedef void (*lwConvertInt16Func)(const int16_t* Values, float* Result, int32_t Count, float Scale);
+typedef void (*lwConvertUInt16Func)(const uint16_t* Values, float* Result, int32_t Count, float Scale);
+
+static lwConvertInt16Func _convertInt16 = lwConvertInt16ToFloatScalar;
+static lwConvertUInt16Func _convertUInt16 = lwConvertUInt16ToFloatScalar;
+static const char* _convertName = "scalar";
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Conversion kernels.
+//----------------------------------------------------------------------------------------------------------------------------------
+void lwConvertInt16ToFloatScalar(const int16_t* Values, float* Result, int32_t Count, float Scale) {
+	for (int32_t i = 0; i < Count; ++i) {
+		Result[i] = (float)Values[i] * Scale;
+	}
+}
+
+void lwConvertUInt16ToFloatScalar(const uint16_t* Values, float* Result, int32_t Count, float Scale) {
+	for (int32_t i = 0; i < Count; ++i) {
+		Result[i] = (float)Values[i] * Scale;
+	}
+}
+
+#if defined(LW_CPU_X86)
+LW_CPU_TARGET("sse2") static void _convertInt16Sse2(const int16_t* Values, float* Result, int32_t Count, float Scale) {
+	__m128 scale = _mm_set1_ps(Scale);
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		__m128i values = _mm_loadu_si128((const __m128i*)(Values + i));
+		// NOTE: Each value is unpacked into the high half of a 32 bit lane, the arithmetic shift then sign extends it.
+		__m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(values, values), 16);
+		__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(values, values), 16);
+		_mm_storeu_ps(Result + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+		_mm_storeu_ps(Result + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+	}
+
+	lwConvertInt16ToFloatScalar(Values + i, Result + i, Count - i, Scale);
+}
+
+LW_CPU_TARGET("sse2") static void _convertUInt16Sse2(const uint16_t* Values, float* Result, int32_t Count, float Scale) {
+	__m128 scale = _mm_set1_ps(Scale);
+	__m128i zero = _mm_setzero_si128();
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		__m128i values = _mm_loadu_si128((const __m128i*)(Values + i));
+		__m128i low = _mm_unpacklo_epi16(values, zero);
+		__m128i high = _mm_unpackhi_epi16(values, zero);
+		_mm_storeu_ps(Result + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+		_mm_storeu_ps(Result + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+	}
+
+	lwConvertUInt16ToFloatScalar(Values + i, Result + i, Count - i, Scale);
+}
+
+LW_CPU_TARGET("avx2") static void _convertInt16Avx2(const int16_t* Values, float* Result, int32_t Count, float Scale) {
+	__m256 scale = _mm256_set1_ps(Scale);
+	int32_t i = 0;
+
+	for (; i + 16 <= Count; i += 16) {
+		__m256i low = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(Values + i)));
+		__m256i high = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(Values + i + 8)));
+		_mm256_storeu_ps(Result + i, _mm256_mul_ps(_mm256_cvtepi32_ps(low), scale));
+		_mm256_storeu_ps(Result + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(high), scale));
+	}
+
+	lwConvertInt16ToFloatScalar(Values + i, Result + i, Count - i, Scale);
+}
+
+LW_CPU_TARGET("avx2") static void _convertUInt16Avx2(const uint16_t* Values, float* Result, int32_t Count, float Scale) {
+	__m256 scale = _mm256_set1_ps(Scale);
+	int32_t i = 0;
+
+	for (; i + 16 <= Count; i += 16) {
+		__m256i low = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(Values + i)));
+		__m256i high = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(Values + i + 8)));
+		_mm256_storeu_ps(Result + i, _mm256_mul_ps(_mm256_cvtepi32_ps(low), scale));
+		_mm256_storeu_ps(Result + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(high), scale));
+	}
+
+	lwConvertUInt16ToFloatScalar(Values + i, Result + i, Count - i, Scale);
+}
+
+#elif defined(LW_CPU_NEON)
+static void _convertInt16Neon(const int16_t* Values, float* Result, int32_t Count, float Scale) {
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		int16x8_t values = vld1q_s16(Values + i);
+		vst1q_f32(Result + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(values))), Scale));
+		vst1q_f32(Result + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(values))), Scale));
+	}
+
+	lwConvertInt16ToFloatScalar(Values + i, Result + i, Count - i, Scale);
+}
+
+static void _convertUInt16Neon(const uint16_t* Values, float* Result, int32_t Count, float Scale) {
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		uint16x8_t values = vld1q_u16(Values + i);
+		vst1q_f32(Result + i, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(values))), Scale));
+		vst1q_f32(Result + i + 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(values))), Scale));
+	}
+
+	lwConvertUInt16ToFloatScalar(Values + i, Result + i, Count - i, Scale);
+}
+#endif
+
+static void _convertInit() {
+#if defined(LW_CPU_X86)
+	_convertInt16 = _convertInt16Sse2;
+	_convertUInt16 = _convertUInt16Sse2;
+	_convertName = "sse2";
+
+	if (lwCpuHasAvx2()) {
+		_convertInt16 = _convertInt16Avx2;
+		_convertUInt16 = _convertUInt16Avx2;
+		_convertName = "avx2";
+	}
+#elif defined(LW_CPU_NEON)
+	_convertInt16 = _convertInt16Neon;
+	_convertUInt16 = _convertUInt16Neon;
+	_convertName = "neon";
+#endif
+}
+
+LW_CPU_INITIALIZER(_convertInit);
+
+void lwConvertInt16ToFloat(const int16_t* Values, float* Result, int32_t Count, float Scale) {
+	_convertInt16(Values, Result, Count, Scale);
+}
+
+void lwConvertUInt16ToFloat(const uint16_t* Values, float* Result, int32_t Count, float Scale) {
+	_convertUInt16(Values, Result, Count, Scale);
+}
+
+const char* lwConvertImplementationName() {
+	return _convertName;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Batch decoding.
+//----------------------------------------------------------------------------------------------------------------------------------
+static inline void _convertField(const int16_t* Values, float* Result, int32_t Count, float Scale) {
+	_convertInt16(Values, Result, Count, Scale);
+}
+
+static inline void _convertField(const uint16_t* Values, float* Result, int32_t Count, float Scale) {
+	_convertUInt16(Values, Result, Count, Scale);
+}
+
+// Copies the payload values of each packet into one row per payload position, so every field is contiguous.
+static void _gatherFields(const uint8_t* const* Payloads, int32_t Count, int32_t FieldCount, uint16_t (*Values)[LW_DISTANCE_BATCH_BLOCK]) {
+	for (int32_t i = 0; i < Count; ++i) {
+		const uint8_t* payload = Payloads[i];
+
+		for (int32_t f = 0; f < FieldCount; ++f) {
+			Values[f][i] = (uint16_t)(payload[f * 2] | (payload[f * 2 + 1] << 8));
+		}
+	}
+}
+
+void lwDistanceDecodeBatch(const lwDistanceLayout* Layout, const uint8_t* const* Payloads, int32_t Count, lwDistanceColumns* Columns) {
+	uint16_t values[LW_DISTANCE_FIELD_COUNT][LW_DISTANCE_BATCH_BLOCK];
+	int32_t fieldCount = Layout->payloadSize / 2;
+
+	for (int32_t start = 0; start < Count; start += LW_DISTANCE_BATCH_BLOCK) {
+		int32_t blockCount = Count - start;
+
+		if (blockCount > LW_DISTANCE_BATCH_BLOCK) {
+			blockCount = LW_DISTANCE_BATCH_BLOCK;
+		}
+
+		_gatherFields(Payloads + start, blockCount, fieldCount, values);
+
+		#define LW_DISTANCE_DECODE_COLUMN(Bit, Name, Type, Scale) \
+			if (Columns->Name != NULL) { \
+				if ((Layout->mask >> Bit) & 1) { \
+					_convertField((const Type*)values[Layout->offsets[Bit] / 2], Columns->Name + start, blockCount, Scale); \
+				} else { \
+					memset(Columns->Name + start, 0, blockCount * sizeof(float)); \
+				} \
+			}
+		LW_DISTANCE_FIELDS(LW_DISTANCE_DECODE_COLUMN)
+		#undef LW_DISTANCE_DECODE_COLUMN
+	}
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// Batch decoding of distance data packets into one float array per field.
+//
+// The 16 bit values of each field are gathered from the packets into a block, then converted to floats by a SIMD kernel
+// selected for the CPU at startup (SSE2 or AVX2 on x86, NEON on ARM).
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "lwDistanceOutput.h"
+
+// Output arrays of lwDistanceDecodeBatch, each holding one value per packet. Fields left NULL are not decoded.
+// Values are scaled by the Scale of LW_DISTANCE_FIELDS: distances in m, strength in percent, temperature and yaw angle in degrees.
+class lwDistanceColumns {
+	public:
+		#define LW_DISTANCE_COLUMN(Bit, Name, Type, Scale) float* Name;
+		LW_DISTANCE_FIELDS(LW_DISTANCE_COLUMN)
+		#undef LW_DISTANCE_COLUMN
+
+		lwDistanceColumns() {
+			#define LW_DISTANCE_COLUMN_INIT(Bit, Name, Type, Scale) Name = 0;
+			LW_DISTANCE_FIELDS(LW_DISTANCE_COLUMN_INIT)
+			#undef LW_DISTANCE_COLUMN_INIT
+		}
+};
+
+// Decodes Count distance data payloads of Layout->payloadSize bytes each.
+// Fields not selected by the layout are written as 0.
+void lwDistanceDecodeBatch(const lwDistanceLayout* Layout, const uint8_t* const* Payloads, int32_t Count, lwDistanceColumns* Columns);
+
+// Converts Count 16 bit values to floats multiplied by Scale.
+void lwConvertInt16ToFloat(const int16_t* Values, float* Result, int32_t Count, float Scale);
+void lwConvertUInt16ToFloat(const uint16_t* Values, float* Result, int32_t Count, float Scale);
+
+// Reference implementations of the conversions.
+void lwConvertInt16ToFloatScalar(const int16_t* Values, float* Result, int32_t Count, float Scale);
+void lwConvertUInt16ToFloatScalar(const uint16_t* Values, float* Result, int32_t Count, float Scale);
+
+// Name of the conversion kernel selected for this CPU.
+const char* lwConvertImplementationName();
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include "lwDistanceOutput.h"
+#include <string.h>
+
+void lwDistanceInitLayout(lwDistanceLayout* Layout, uint32_t Mask, uint32_t FieldMask) {
+	uint32_t mask = Mask & FieldMask;
+
+	Layout->mask = mask;
+	Layout->payloadSize = lwDistancePayloadSize(mask, FieldMask);
+
+	#define LW_DISTANCE_OFFSET(Bit, Name, Type, Scale) Layout->offsets[Bit] = (uint8_t)(((mask >> Bit) & 1) ? lwDistanceFieldOffset(mask, Bit, FieldMask) : LW_DISTANCE_FIELD_COUNT * 2);
+	LW_DISTANCE_FIELDS(LW_DISTANCE_OFFSET)
+	#undef LW_DISTANCE_OFFSET
+}
+
+void lwDistanceDecode(const lwDistanceLayout* Layout, const uint8_t* Payload, lwDistanceSample* Sample) {
+	// NOTE: The payload is copied after a zeroed slot is reserved for missing fields, so every field is read the same way.
+	uint8_t padded[LW_DISTANCE_FIELD_COUNT * 2 + 2] = {};
+	memcpy(padded, Payload, Layout->payloadSize);
+
+	#define LW_DISTANCE_READ(Bit, Name, Type, Scale) Sample->Name = (Type)(padded[Layout->offsets[Bit]] | (padded[Layout->offsets[Bit] + 1] << 8));
+	LW_DISTANCE_FIELDS(LW_DISTANCE_READ)
+	#undef LW_DISTANCE_READ
+}
+
+bool lwDistanceDecode(const lwDistanceLayout* Layout, const lwPacketView* Packet, lwDistanceSample* Sample) {
+	if (Packet->commandId != 44 || Packet->payloadSize != Layout->payloadSize) {
+		return false;
+	}
+
+	lwDistanceDecode(Layout, Packet->payload, Sample);
+	return true;
+}
\ No newline at end of file
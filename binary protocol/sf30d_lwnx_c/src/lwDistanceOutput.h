@@ -0,0 +1,124 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// Decoding of distance data packets (Command 44: Distance data in cm).
+//
+// The bitmask written to the distance output command (27 on the SF45/B, 29 on the SF30/D) selects which fields the device
+// sends, as 16 bit values in bit order. lwDistanceDecoder is instantiated with that bitmask and reads every field from an
+// offset fixed at compile time. lwDistanceLayout does the same for a bitmask only known at runtime.
+// Both are generated from LW_DISTANCE_FIELDS, limited to the fields the device has.
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+#include "lwPacket.h"
+
+// Every field of the distance output as X(Bit, Name, Type, Scale), where Scale converts the value to m, percent or degrees.
+#define LW_DISTANCE_FIELDS(X) \
+	X(0, firstReturnRaw, uint16_t, 0.01f) \
+	X(1, firstReturnFiltered, uint16_t, 0.01f) \
+	X(2, firstReturnStrength, uint16_t, 1.0f) \
+	X(3, lastReturnRaw, uint16_t, 0.01f) \
+	X(4, lastReturnFiltered, uint16_t, 0.01f) \
+	X(5, lastReturnStrength, uint16_t, 1.0f) \
+	X(6, backgroundNoise, uint16_t, 1.0f) \
+	X(7, temperature, int16_t, 0.01f) \
+	X(8, yawAngle, int16_t, 0.01f)
+
+#define LW_DISTANCE_FIELD_COUNT	9
+
+// Bits of the distance output bitmask that select a field on each device. Other bits are ignored by the device, so they
+// don't take space in the packet. Only the SF45/B sends the yaw angle.
+#define LW_DISTANCE_FIELD_MASK_SF45		0x1FF
+#define LW_DISTANCE_FIELD_MASK_SF30D	0x0FF
+
+// Fields of the device this sample is for.
+#define LW_DISTANCE_FIELD_MASK	LW_DISTANCE_FIELD_MASK_SF30D
+
+// A decoded distance data packet. Distances are in cm, strength in percent, temperature and yaw angle in 1/100 degrees.
+// Fields not selected by the bitmask are 0.
+class lwDistanceSample {
+	public:
+		#define LW_DISTANCE_MEMBER(Bit, Name, Type, Scale) Type Name;
+		LW_DISTANCE_FIELDS(LW_DISTANCE_MEMBER)
+		#undef LW_DISTANCE_MEMBER
+};
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Compile time decoding.
+//----------------------------------------------------------------------------------------------------------------------------------
+constexpr int32_t lwDistanceBitCount(uint32_t Bits) {
+	return Bits == 0 ? 0 : (int32_t)(Bits & 1) + lwDistanceBitCount(Bits >> 1);
+}
+
+// Size of the distance data payload after the command id.
+constexpr int32_t lwDistancePayloadSize(uint32_t Mask, uint32_t FieldMask = LW_DISTANCE_FIELD_MASK) {
+	return 2 * lwDistanceBitCount(Mask & FieldMask);
+}
+
+// Byte offset of a field in the payload, or -1 if the bitmask does not select it or the device doesn't have it.
+constexpr int32_t lwDistanceFieldOffset(uint32_t Mask, int32_t Bit, uint32_t FieldMask = LW_DISTANCE_FIELD_MASK) {
+	return (((Mask & FieldMask) >> Bit) & 1) ? 2 * lwDistanceBitCount(Mask & FieldMask & ((1u << Bit) - 1)) : -1;
+}
+
+template <int32_t Offset, typename Type>
+class lwDistanceField {
+	public:
+		static inline Type read(const uint8_t* Payload) {
+			return (Type)(Payload[Offset] | (Payload[Offset + 1] << 8));
+		}
+};
+
+// Fields not selected by the bitmask.
+template <typename Type>
+class lwDistanceField<-1, Type> {
+	public:
+		static inline Type read(const uint8_t* Payload) {
+			return 0;
+		}
+};
+
+// Decodes the distance data sent for the distance output bitmask Mask by a device with the fields FieldMask.
+// Use the same constant for the bitmask written to the device so the two can't disagree.
+template <uint32_t Mask, uint32_t FieldMask = LW_DISTANCE_FIELD_MASK>
+class lwDistanceDecoder {
+	public:
+		static const uint32_t mask = Mask & FieldMask;
+		static const int32_t payloadSize = lwDistancePayloadSize(mask, FieldMask);
+
+		// Decodes a payload of payloadSize bytes.
+		static inline void decode(const uint8_t* Payload, lwDistanceSample* Sample) {
+			#define LW_DISTANCE_READ(Bit, Name, Type, Scale) Sample->Name = lwDistanceField<lwDistanceFieldOffset(mask, Bit, FieldMask), Type>::read(Payload);
+			LW_DISTANCE_FIELDS(LW_DISTANCE_READ)
+			#undef LW_DISTANCE_READ
+		}
+
+		// Returns false if the packet is not distance data with this layout, which happens when the distance output of the
+		// device does not match Mask.
+		static inline bool decode(const lwPacketView* Packet, lwDistanceSample* Sample) {
+			if (Packet->commandId != 44 || Packet->payloadSize != payloadSize) {
+				return false;
+			}
+
+			decode(Packet->payload, Sample);
+			return true;
+		}
+};
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Runtime decoding.
+//----------------------------------------------------------------------------------------------------------------------------------
+class lwDistanceLayout {
+	public:
+		uint32_t mask;
+		int32_t payloadSize;
+		// Byte offset of each field in the payload. Fields not selected point past the payload at a zero value.
+		uint8_t offsets[LW_DISTANCE_FIELD_COUNT];
+};
+
+// Computes the layout of the distance data sent for the distance output bitmask Mask by a device with the fields FieldMask.
+void lwDistanceInitLayout(lwDistanceLayout* Layout, uint32_t Mask, uint32_t FieldMask = LW_DISTANCE_FIELD_MASK);
+
+// Decodes a payload of Layout->payloadSize bytes.
+void lwDistanceDecode(const lwDistanceLayout* Layout, const uint8_t* Payload, lwDistanceSample* Sample);
+
+// Returns false if the packet is not distance data with this layout.
+bool lwDistanceDecode(const lwDistanceLayout* Layout, const lwPacketView* Packet, lwDistanceSample* Sample);
\ No newline at end of file
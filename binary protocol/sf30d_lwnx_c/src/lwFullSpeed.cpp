@@ -0,0 +1,113 @@
+#include "lwFullSpeed.h"
+#include "lwDistanceBatch.h"
+
+#define LW_FULL_SPEED_RING_MASK	(LW_FULL_SPEED_RING_SIZE - 1)
+
+bool lwFullSpeedStart(lwSerialPort* Serial) {
+	// Return mode, last return as in the full speed Python sample. (Command 77)
+	uint16_t returnMode = 8;
+	// Full speed streaming. (Command 30: Stream)
+	uint32_t streamMode = 11;
+
+	lwCommand commands[2];
+	lwnxInitWriteCommand(&commands[0], 77, (uint8_t*)&returnMode, 2);
+	lwnxInitWriteCommand(&commands[1], 30, (uint8_t*)&streamMode, 4);
+
+	return lwnxHandleManagedBatch(Serial, commands, 2);
+}
+
+bool lwFullSpeedStop(lwSerialPort* Serial) {
+	return lwnxCmdWriteUInt32(Serial, 30, 0);
+}
+
+// Copies little endian 16 bit values from a packet, which are not aligned.
+static void _unpackDistances(uint16_t* Distance, const uint8_t* Data, int32_t Count) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	for (int32_t i = 0; i < Count; ++i) {
+		Distance[i] = (uint16_t)(Data[i * 2] | (Data[i * 2 + 1] << 8));
+	}
+#else
+	// NOTE: The packet layout matches memory on little endian CPUs, so this is a vectorized block copy.
+	memcpy(Distance, Data, Count * sizeof(uint16_t));
+#endif
+}
+
+int32_t lwFullSpeedDecode(lwFullSpeedRing* Ring, const lwPacketView* Packet) {
+	if (Packet->commandId != 40 || Packet->payloadSize < 1 || Packet->payloadSize != 1 + Packet->payload[0] * 2) {
+		++Ring->invalidCount;
+		return -1;
+	}
+
+	int32_t count = Packet->payload[0];
+	uint64_t writeCount = Ring->writeCount.load(std::memory_order_relaxed);
+	uint64_t readCount = Ring->readCount.load(std::memory_order_acquire);
+	int32_t space = LW_FULL_SPEED_RING_SIZE - (int32_t)(writeCount - readCount);
+
+	if (count > space) {
+		Ring->droppedCount += count - space;
+		count = space;
+	}
+
+	int32_t start = (int32_t)(writeCount & LW_FULL_SPEED_RING_MASK);
+	int32_t first = LW_FULL_SPEED_RING_SIZE - start;
+
+	if (first > count) {
+		first = count;
+	}
+
+	_unpackDistances(Ring->distance + start, Packet->payload + 1, first);
+	_unpackDistances(Ring->distance, Packet->payload + 1 + first * 2, count - first);
+	Ring->writeCount.store(writeCount + count, std::memory_order_release);
+
+	return count;
+}
+
+void lwFullSpeedPacketHandler(lwSerialPort* Serial, lwPacketView* Packet, void* User) {
+	lwFullSpeedDecode((lwFullSpeedRing*)User, Packet);
+}
+
+int32_t lwFullSpeedAvailable(lwFullSpeedRing* Ring) {
+	return (int32_t)(Ring->writeCount.load(std::memory_order_acquire) - Ring->readCount.load(std::memory_order_relaxed));
+}
+
+// Finds the oldest unread samples as up to two contiguous runs in the ring, the second starting at index 0.
+static int32_t _ringSpans(lwFullSpeedRing* Ring, int32_t MaxCount, int32_t* Start, int32_t* First) {
+	int32_t count = lwFullSpeedAvailable(Ring);
+
+	if (count > MaxCount) {
+		count = MaxCount;
+	}
+
+	*Start = (int32_t)(Ring->readCount.load(std::memory_order_relaxed) & LW_FULL_SPEED_RING_MASK);
+	*First = LW_FULL_SPEED_RING_SIZE - *Start;
+
+	if (*First > count) {
+		*First = count;
+	}
+
+	return count;
+}
+
+int32_t lwFullSpeedRead(lwFullSpeedRing* Ring, uint16_t* Distance, int32_t MaxCount) {
+	int32_t start;
+	int32_t first;
+	int32_t count = _ringSpans(Ring, MaxCount, &start, &first);
+
+	memcpy(Distance, Ring->distance + start, first * sizeof(uint16_t));
+	memcpy(Distance + first, Ring->distance, (count - first) * sizeof(uint16_t));
+	Ring->readCount.fetch_add(count, std::memory_order_release);
+
+	return count;
+}
+
+int32_t lwFullSpeedReadMetres(lwFullSpeedRing* Ring, float* Distance, int32_t MaxCount) {
+	int32_t start;
+	int32_t first;
+	int32_t count = _ringSpans(Ring, MaxCount, &start, &first);
+
+	lwConvertUInt16ToFloat(Ring->distance + start, Distance, first, 0.01f);
+	lwConvertUInt16ToFloat(Ring->distance, Distance + first, count - first, 0.01f);
+	Ring->readCount.fetch_add(count, std::memory_order_release);
+
+	return count;
+}
\ No newline at end of file
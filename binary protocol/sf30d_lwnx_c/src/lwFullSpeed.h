@@ -0,0 +1,50 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// Full speed streaming of the SF30/D (Command 30: Stream, mode 11).
+//
+// In full speed mode the distances arrive in Command 40 packets, each holding a count byte followed by that many 16 bit
+// distances in cm. lwFullSpeedPacketHandler copies them from the packet straight into a ring buffer in one or two block
+// copies, and the application drains the ring in batches, as cm or converted to m by the SIMD kernel of lwDistanceBatch.
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include "lwNx.h"
+
+// Number of samples the ring holds, a power of two. About 3 seconds at the highest update rate.
+#define LW_FULL_SPEED_RING_SIZE	65536
+
+// NOTE: The packet handler and lwFullSpeedRead* may run on different threads, as long as only one thread reads.
+class lwFullSpeedRing {
+	public:
+		uint16_t distance[LW_FULL_SPEED_RING_SIZE];
+		// Total number of samples written and read. Unread samples are distance[readCount, writeCount) modulo the size.
+		std::atomic<uint64_t> writeCount;
+		std::atomic<uint64_t> readCount;
+		// Samples lost because the ring was full, and packets whose count does not match their size.
+		uint64_t droppedCount;
+		uint32_t invalidCount;
+
+		lwFullSpeedRing() : writeCount(0), readCount(0), droppedCount(0), invalidCount(0) { }
+};
+
+// Sets the return mode and enables full speed streaming, as the full speed Python sample does.
+bool lwFullSpeedStart(lwSerialPort* Serial);
+
+// Disables streaming. (Command 30: Stream, mode 0)
+bool lwFullSpeedStop(lwSerialPort* Serial);
+
+// Adds the distances of a Command 40 packet to the ring. Returns the number of samples added, or -1 if the packet is not a
+// valid full speed packet.
+int32_t lwFullSpeedDecode(lwFullSpeedRing* Ring, const lwPacketView* Packet);
+
+// Packet handler for Command 40. Register with lwnxSetPacketHandler and the ring as User.
+void lwFullSpeedPacketHandler(lwSerialPort* Serial, lwPacketView* Packet, void* User);
+
+// Number of samples waiting in the ring.
+int32_t lwFullSpeedAvailable(lwFullSpeedRing* Ring);
+
+// Moves up to MaxCount of the oldest samples out of the ring. Returns the number of samples.
+int32_t lwFullSpeedRead(lwFullSpeedRing* Ring, uint16_t* Distance, int32_t MaxCount);
+
+// Same as lwFullSpeedRead with the distances converted to m.
+int32_t lwFullSpeedReadMetres(lwFullSpeedRing* Ring, float* Distance, int32_t MaxCount);
\ No newline at end of file
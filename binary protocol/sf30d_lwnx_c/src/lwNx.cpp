@@ -1,25 +1,10 @@
 #include "lwNx.h"
 
-lwResponsePacket::lwResponsePacket() : size(0), payloadSize(0), parseState(0) { }
+lwResponsePacket::lwResponsePacket() : size(0), payloadSize(0), parseState(0), crc(0), firstByteTimeUs(0), lastByteTimeUs(0) { }
 
 uint16_t lwnxCreateCrc(uint8_t* Data, uint16_t Size)
 {
-	uint16_t crc = 0;
-
-	for (uint32_t i = 0; i < Size; ++i)
-	{
-		uint16_t code = crc >> 8;
-		code ^= Data[i];
-		code ^= code >> 4;
-		crc = crc << 8;
-		crc ^= code;
-		code = code << 5;
-		crc ^= code;
-		code = code << 7;
-		crc ^= code;
-	}
-
-	return crc;
+	return lwCrc16(0, Data, Size);
 }
 
 void lwnxConvertFirmwareVersionToStr(uint32_t Version, char* String) {
@@ -30,24 +15,62 @@ void lwnxConvertFirmwareVersionToStr(uint32_t Version, char* String) {
 	sprintf(String, "%d.%d.%d", major, minor, patch);
 }
 
+void lwnxUpdateLinkTiming(lwLinkTiming* Timing, int64_t RoundTripUs) {
+	if (Timing->srttUs == 0) {
+		Timing->srttUs = RoundTripUs;
+		Timing->rttvarUs = RoundTripUs / 2;
+	} else {
+		int64_t error = Timing->srttUs - RoundTripUs;
+
+		if (error < 0) {
+			error = -error;
+		}
+
+		Timing->rttvarUs = (3 * Timing->rttvarUs + error) / 4;
+		Timing->srttUs = (7 * Timing->srttUs + RoundTripUs) / 8;
+	}
+
+	// NOTE: The variation term is at least 1 ms to cover scheduling jitter on the host.
+	int64_t variation = 4 * Timing->rttvarUs;
+
+	if (variation < 1000) {
+		variation = 1000;
+	}
+
+	Timing->timeoutUs = Timing->srttUs + variation;
+
+	if (Timing->timeoutUs < Timing->minTimeoutUs) {
+		Timing->timeoutUs = Timing->minTimeoutUs;
+	} else if (Timing->timeoutUs > Timing->maxTimeoutUs) {
+		Timing->timeoutUs = Timing->maxTimeoutUs;
+	}
+}
+
 void lwnxInitResponsePacket(lwResponsePacket* Response) {
 	Response->size = 0;
 	Response->payloadSize = 0;
 	Response->parseState = 0;
+	Response->crc = 0;
+	Response->firstByteTimeUs = 0;
+	Response->lastByteTimeUs = 0;
 }
 
 bool lwnxParseData(lwResponsePacket* Response, uint8_t Data) {
+	// NOTE: The CRC is updated as each byte arrives so the last byte only needs a compare.
 	if (Response->parseState == 0) {
 		if (Data == PACKET_START_BYTE) {
 			Response->parseState = 1;
 			Response->data[0] = PACKET_START_BYTE;
+			Response->crc = lwCrc16Byte(0, PACKET_START_BYTE);
 		}
 	} else if (Response->parseState == 1) {
 		Response->parseState = 2;
 		Response->data[1] = Data;
+		Response->crc = lwCrc16Byte(Response->crc, Data);
 	} else if (Response->parseState == 2) {
 		Response->parseState = 3;
 		Response->data[2] = Data;
+		Response->crc = lwCrc16Byte(Response->crc, Data);
 		Response->payloadSize = (Response->data[1] | (Response->data[2] << 8)) >> 6;
 		Response->payloadSize += 2;
 		Response->size = 3;
@@ -59,16 +82,17 @@ bool lwnxParseData(lwResponsePacket* Response, uint8_t Data) {
 	} else if (Response->parseState == 3) {
 		Response->data[Response->size++] = Data;
 
+		if (Response->payloadSize > 2) {
+			Response->crc = lwCrc16Byte(Response->crc, Data);
+		}
+
 		if (--Response->payloadSize == 0) {
 			Response->parseState = 0;
 			uint16_t crc = Response->data[Response->size - 2] | (Response->data[Response->size - 1] << 8);
-			uint16_t verifyCrc = lwnxCreateCrc(Response->data, Response->size - 2);
 
-			if (crc == verifyCrc) {
-				Response->parseState = 0;
+			if (crc == Response->crc) {
 				return true;
 			} else {
-				Response->parseState = 0;
 				printf("Packet has invalid CRC\n");
 			}
 		}
@@ -77,47 +101,508 @@ bool lwnxParseData(lwResponsePacket* Response, uint8_t Data) {
 	return false;
 }
 
-bool lwnxRecvPacketNoBlock(lwSerialPort* Serial, uint8_t CommandId, lwResponsePacket* Response) {
-	uint8_t byte = 0;
-	int32_t bytesRead = Serial->readData(&byte, 1);
-
-	if (bytesRead != 0) {
-		if (lwnxParseData(Response, byte)) {
-			int8_t cmdId = Response->data[3];
-			
-			if (cmdId == CommandId) {
-				return true;
+int32_t lwnxParseBuffer(lwPacketParser* Parser, uint8_t* Data, int32_t Size, lwPacketSpan* Packets, int32_t MaxPackets, int32_t* Consumed) {
+	int32_t count = 0;
+	int32_t pos = 0;
+	uint16_t crc = 0;
+	int32_t crcSize = 0;
+
+	// Resume the CRC of the packet left incomplete by the last call, which the caller passes again at the start of Data.
+	if (Parser->crcSize > 0 && Size >= Parser->crcSize && Data[0] == PACKET_START_BYTE && ((Data[1] | (Data[2] << 8)) >> 6) + 5 == Parser->pendingSize) {
+		crc = Parser->crc;
+		crcSize = Parser->crcSize;
+	}
+
+	Parser->pendingSize = 0;
+	Parser->crcSize = 0;
+
+	while (count < MaxPackets) {
+		uint8_t* start = (uint8_t*)memchr(Data + pos, PACKET_START_BYTE, Size - pos);
+
+		if (start == NULL) {
+			pos = Size;
+			break;
+		}
+
+		pos = (int32_t)(start - Data);
+
+		if (Size - pos < 3) {
+			break;
+		}
+
+		// NOTE: The upper 10 bits of the flags word hold the payload length, which includes the command id.
+		int32_t payloadSize = (start[1] | (start[2] << 8)) >> 6;
+		int32_t packetSize = payloadSize + 5;
+
+		if (payloadSize == 0 || packetSize > PACKET_MAX_SIZE) {
+			++Parser->invalidSizeCount;
+			++pos;
+			crcSize = 0;
+			continue;
+		}
+
+		int32_t available = Size - pos;
+
+		if (crcSize == 0) {
+			crc = 0;
+		}
+
+		if (available < packetSize) {
+			// Hash what has arrived so far and carry it to the next call.
+			int32_t hashSize = (available < packetSize - 2) ? available : (packetSize - 2);
+			Parser->crc = lwCrc16(crc, start + crcSize, hashSize - crcSize);
+			Parser->crcSize = hashSize;
+			Parser->pendingSize = packetSize;
+			break;
+		}
+
+		crc = lwCrc16(crc, start + crcSize, packetSize - 2 - crcSize);
+		crcSize = 0;
+
+		if (crc != (start[packetSize - 2] | (start[packetSize - 1] << 8))) {
+			// NOTE: A false start byte can claim a length that swallows real packets, so resync on the next byte.
+			++Parser->invalidCrcCount;
+			++pos;
+			continue;
+		}
+
+		Packets[count].offset = pos;
+		Packets[count].size = packetSize;
+		++count;
+		pos += packetSize;
+	}
+
+	Parser->packetCount += count;
+	*Consumed = pos;
+
+	return count;
+}
+
+int32_t lwnxFillRecvBuffer(lwSerialPort* Serial) {
+	// Forget the arrival times of reads that have been fully consumed.
+	int32_t consumedChunks = 0;
+
+	while (consumedChunks < Serial->recvChunkCount && Serial->recvChunks[consumedChunks].end <= Serial->recvHead) {
+		++consumedChunks;
+	}
+
+	if (consumedChunks > 0) {
+		Serial->recvChunkCount -= consumedChunks;
+		memmove(Serial->recvChunks, Serial->recvChunks + consumedChunks, Serial->recvChunkCount * sizeof(lwRecvChunk));
+	}
+
+	// NOTE: Held packet views point into the buffer, so nothing can be moved until they are released.
+	if (Serial->recvHoldCount == 0) {
+		if (Serial->recvHead == Serial->recvTail) {
+			Serial->recvHead = 0;
+			Serial->recvTail = 0;
+		} else if (Serial->recvHead > 0 && Serial->recvTail > LW_RECV_BUFFER_SIZE / 2) {
+			// NOTE: Only the unconsumed bytes are moved, which is never more than a partial read.
+			int32_t unreadSize = Serial->recvTail - Serial->recvHead;
+			memmove(Serial->recvBuffer, Serial->recvBuffer + Serial->recvHead, unreadSize);
+
+			for (int32_t i = 0; i < Serial->recvChunkCount; ++i) {
+				Serial->recvChunks[i].end -= Serial->recvHead;
 			}
+
+			Serial->recvHead = 0;
+			Serial->recvTail = unreadSize;
+		}
+	}
+
+	int32_t freeSize = LW_RECV_BUFFER_SIZE - Serial->recvTail;
+
+	if (freeSize == 0) {
+		return 0;
+	}
+
+	int32_t bytesRead = Serial->readData(Serial->recvBuffer + Serial->recvTail, freeSize);
+
+	if (bytesRead > 0) {
+		Serial->recvTail += bytesRead;
+
+		// NOTE: When out of chunks the newest one is extended, which keeps the arrival time of its first bytes.
+		if (Serial->recvChunkCount == LW_RECV_CHUNK_COUNT) {
+			Serial->recvChunks[LW_RECV_CHUNK_COUNT - 1].end = Serial->recvTail;
+		} else {
+			lwRecvChunk* chunk = &Serial->recvChunks[Serial->recvChunkCount++];
+			chunk->end = Serial->recvTail;
+			chunk->timeUs = platformGetMicrosecond();
 		}
 	}
 
+	return bytesRead;
+}
+
+// Returns the arrival time of the byte at Offset in the receive buffer.
+int64_t lwnxGetRecvTime(lwSerialPort* Serial, int32_t Offset) {
+	for (int32_t i = 0; i < Serial->recvChunkCount; ++i) {
+		if (Offset < Serial->recvChunks[i].end) {
+			return Serial->recvChunks[i].timeUs;
+		}
+	}
+
+	return 0;
+}
+
+void lwnxInitPacketView(lwPacketView* View, uint8_t* Data, int32_t Size) {
+	View->data = Data;
+	View->size = Size;
+	View->commandId = Data[3];
+	View->write = (Data[1] & 0x1) != 0;
+	View->payload = Data + 4;
+	View->payloadSize = Size - 6;
+}
+
+int32_t lwnxGetMaxAttempts(lwSerialPort* Serial, lwCommand* Command) {
+	return (Command->maxAttempts > 0) ? Command->maxAttempts : Serial->linkTiming.maxAttempts;
+}
+
+// Remembers that sends of a command that is no longer pending may still be answered.
+// NOTE: The link has no sequence numbers, so a reply can't be told apart from one to a later command with the same id.
+// Replies are expected for up to maxTimeoutUs after the last send, the longest a response may take before it is resent.
+void lwnxExpectLateReplies(lwSerialPort* Serial, lwCommand* Command, int32_t Count) {
+	if (Count <= 0) {
+		return;
+	}
+
+	lwLateReplies* late = &Serial->lateReplies[Command->commandId];
+	late->count += Count;
+	late->expireTimeUs = Command->sendTimeUs + Serial->linkTiming.maxTimeoutUs;
+}
+
+// Completes the oldest pending command waiting for the packet's command id, if any. Late replies to earlier sends are
+// dropped instead.
+bool lwnxCompletePendingCommand(lwSerialPort* Serial, lwPacketView* Packet) {
+	lwLateReplies* late = &Serial->lateReplies[Packet->commandId];
+
+	if (late->count > 0) {
+		if (platformGetMicrosecond() < late->expireTimeUs) {
+			--late->count;
+			return true;
+		}
+
+		late->count = 0;
+	}
+
+	lwCommand** link = &Serial->pendingCommands;
+
+	while (*link != NULL) {
+		lwCommand* command = *link;
+
+		if (command->commandId == Packet->commandId) {
+			uint32_t copySize = command->responseSize;
+
+			if ((uint32_t)Packet->payloadSize < copySize) {
+				copySize = Packet->payloadSize;
+			}
+
+			memcpy(command->response, Packet->payload, copySize);
+			command->complete = true;
+
+			// NOTE: A response to a command sent more than once can't be matched to one send, so it is not measured.
+			if (command->attempts == 1) {
+				lwnxUpdateLinkTiming(&Serial->linkTiming, platformGetMicrosecond() - command->sendTimeUs);
+			}
+
+			lwnxExpectLateReplies(Serial, command, command->attempts - 1);
+
+			*link = command->next;
+			command->next = NULL;
+
+			if (command->callback != NULL) {
+				command->callback(Serial, command, command->user);
+			}
+
+			return true;
+		}
+
+		link = &command->next;
+	}
+
 	return false;
 }
 
-bool lwnxRecvPacket(lwSerialPort* Serial, uint8_t CommandId, lwResponsePacket* Response, uint32_t TimeoutMs) {
-	lwnxInitResponsePacket(Response);
+// Sends a pending command and starts the timeout of the attempt.
+void lwnxSendPendingCommand(lwSerialPort* Serial, lwCommand* Command, int64_t Now) {
+	lwLinkTiming* timing = &Serial->linkTiming;
+
+	if (Command->attempts == 0) {
+		Command->timeoutUs = timing->timeoutUs;
+	} else {
+		Command->timeoutUs = Command->timeoutUs * timing->backoffPercent / 100;
+
+		if (Command->timeoutUs > timing->maxTimeoutUs) {
+			Command->timeoutUs = timing->maxTimeoutUs;
+		}
+	}
+
+	++Command->attempts;
+	Command->sendTimeUs = Now;
+	Command->retryTimeUs = Now + Command->timeoutUs;
+
+	// NOTE: The last attempt waits until the deadline, so commands the device is slow to answer, like a parameter save,
+	// don't fail after a few timeouts of the learned round trip time.
+	if (Command->retryTimeUs > Command->deadlineTimeUs || Command->attempts >= lwnxGetMaxAttempts(Serial, Command)) {
+		Command->retryTimeUs = Command->deadlineTimeUs;
+	}
+
+	lwnxSendPacketBytes(Serial, Command->commandId, Command->write, Command->writeData, Command->writeSize);
+}
+
+// Sends pending commands whose timeout has passed again, and fails those that are past their deadline.
+void lwnxServiceCommands(lwSerialPort* Serial) {
+	if (Serial->pendingCommands == NULL) {
+		return;
+	}
 
-	uint32_t timeoutTime = platformGetMillisecond() + TimeoutMs;
-	uint8_t byte = 0;
-	int32_t bytesRead = 0;
-
-	while ((platformGetMillisecond() < timeoutTime) && (bytesRead = Serial->readData(&byte, 1)) != -1) {
-		if (bytesRead > 0) {
-			if (lwnxParseData(Response, byte)) {
-				int8_t cmdId = Response->data[3];
-				// printf("Got packet: %d\n", cmdId);
-				// printf("Recv ");
-				// printHexDebug(Response->data, Response->size);
-				if (cmdId == CommandId) {
-					return true;
-				}
+	int64_t now = platformGetMicrosecond();
+	lwCommand** link = &Serial->pendingCommands;
+
+	while (*link != NULL) {
+		lwCommand* command = *link;
+
+		if (now < command->retryTimeUs) {
+			link = &command->next;
+			continue;
+		}
+
+		if (command->attempts >= lwnxGetMaxAttempts(Serial, command) || now >= command->deadlineTimeUs) {
+			*link = command->next;
+			command->next = NULL;
+			command->failed = true;
+			lwnxExpectLateReplies(Serial, command, command->attempts);
+
+			if (command->callback != NULL) {
+				command->callback(Serial, command, command->user);
 			}
+
+			// NOTE: The callback may have changed the list, commands already serviced are skipped by their retry time.
+			link = &Serial->pendingCommands;
+			continue;
+		}
+
+		lwnxSendPendingCommand(Serial, command, now);
+		link = &command->next;
+	}
+}
+
+void lwnxAddPendingCommand(lwSerialPort* Serial, lwCommand* Command) {
+	lwCommand** link = &Serial->pendingCommands;
+
+	while (*link != NULL) {
+		link = &(*link)->next;
+	}
+
+	Command->next = NULL;
+	*link = Command;
+}
+
+// Returns false if the command was not pending.
+bool lwnxRemovePendingCommand(lwSerialPort* Serial, lwCommand* Command) {
+	lwCommand** link = &Serial->pendingCommands;
+
+	while (*link != NULL) {
+		if (*link == Command) {
+			*link = Command->next;
+			Command->next = NULL;
+			return true;
+		}
+
+		link = &(*link)->next;
+	}
+
+	return false;
+}
+
+// Parses buffered bytes until a packet with the requested command id is found, dispatching all other packets to their
+// pending commands or handlers. Pass -1 as the command id to dispatch everything. The view is only valid until the receive buffer is filled again.
+bool lwnxParseRecvBuffer(lwSerialPort* Serial, int32_t CommandId, lwPacketView* View) {
+	while (Serial->recvHead < Serial->recvTail) {
+		lwPacketSpan packet;
+		int32_t consumed = 0;
+		uint8_t* parseData = Serial->recvBuffer + Serial->recvHead;
+		int32_t found = lwnxParseBuffer(&Serial->recvParser, parseData, Serial->recvTail - Serial->recvHead, &packet, 1, &consumed);
+
+		Serial->recvHead += consumed;
+
+		if (found == 0) {
+			return false;
+		}
+
+		uint8_t* packetData = parseData + packet.offset;
+		uint8_t cmdId = packetData[3];
+		// printf("Got packet: %d\n", cmdId);
+		// printf("Recv ");
+		// printHexDebug(packetData, packet.size);
+		lwnxInitPacketView(View, packetData, packet.size);
+		View->firstByteTimeUs = lwnxGetRecvTime(Serial, (int32_t)(packetData - Serial->recvBuffer));
+		View->lastByteTimeUs = lwnxGetRecvTime(Serial, (int32_t)(packetData - Serial->recvBuffer) + packet.size - 1);
+
+		if (cmdId == CommandId) {
+			return true;
+		}
+
+		if (lwnxCompletePendingCommand(Serial, View)) {
+			continue;
+		}
+
+		lwPacketHandler* handler = &Serial->recvHandlers[cmdId];
+
+		if (handler->func != NULL) {
+			handler->func(Serial, View, handler->user);
 		}
 	}
 
 	return false;
 }
 
+// Blocks until the serial port has data to read, TimeoutTimeUs is reached, or a pending command is due to be resent.
+// Returns false without waiting if no more data can be received: the receive buffer is full and held packet views keep it
+// from being compacted, so waiting would only spin until the timeout.
+bool lwnxWaitRecvData(lwSerialPort* Serial, int64_t TimeoutTimeUs) {
+	if (Serial->recvHoldCount > 0 && Serial->recvTail == LW_RECV_BUFFER_SIZE) {
+		return false;
+	}
+
+	int64_t waitTime = TimeoutTimeUs;
+
+	for (lwCommand* command = Serial->pendingCommands; command != NULL; command = command->next) {
+		if (command->retryTimeUs < waitTime) {
+			waitTime = command->retryTimeUs;
+		}
+	}
+
+	int64_t now = platformGetMicrosecond();
+
+	if (waitTime > now) {
+		Serial->waitForData(waitTime - now);
+	}
+
+	return true;
+}
+
+// Waits for a packet with the requested command id. The view is only valid until the receive buffer is filled again.
+bool lwnxWaitRecvBuffer(lwSerialPort* Serial, uint8_t CommandId, lwPacketView* View, uint32_t TimeoutMs) {
+	int64_t timeoutTime = platformGetMicrosecond() + (int64_t)TimeoutMs * 1000;
+
+	while (true) {
+		// NOTE: Bytes left over from a previous call are parsed before waiting on the port.
+		if (lwnxParseRecvBuffer(Serial, CommandId, View)) {
+			return true;
+		}
+
+		lwnxServiceCommands(Serial);
+
+		if (platformGetMicrosecond() >= timeoutTime) {
+			return false;
+		}
+
+		if (!lwnxWaitRecvData(Serial, timeoutTime) || lwnxFillRecvBuffer(Serial) == -1) {
+			return false;
+		}
+	}
+}
+
+// Polls until the command is done, TimeoutTimeUs is reached, or the serial port fails.
+void lwnxWaitCommandUntil(lwSerialPort* Serial, lwCommand* Command, int64_t TimeoutTimeUs) {
+	lwPacketView view;
+
+	while (true) {
+		lwnxParseRecvBuffer(Serial, -1, &view);
+		lwnxServiceCommands(Serial);
+
+		if (lwnxCommandDone(Command) || platformGetMicrosecond() >= TimeoutTimeUs) {
+			return;
+		}
+
+		if (!lwnxWaitRecvData(Serial, TimeoutTimeUs) || lwnxFillRecvBuffer(Serial) == -1) {
+			return;
+		}
+	}
+}
+
+void lwnxCopyPacketView(lwPacketView* View, lwResponsePacket* Response) {
+	memcpy(Response->data, View->data, View->size);
+	Response->size = View->size;
+	Response->firstByteTimeUs = View->firstByteTimeUs;
+	Response->lastByteTimeUs = View->lastByteTimeUs;
+}
+
+void lwnxSetPacketHandler(lwSerialPort* Serial, uint8_t CommandId, lwPacketHandlerFunc Handler, void* User) {
+	Serial->recvHandlers[CommandId].func = Handler;
+	Serial->recvHandlers[CommandId].user = User;
+}
+
+int32_t lwnxPoll(lwSerialPort* Serial, uint32_t TimeoutMs) {
+	int32_t startCount = Serial->recvParser.packetCount;
+	int64_t timeoutTime = platformGetMicrosecond() + (int64_t)TimeoutMs * 1000;
+	lwPacketView view;
+
+	lwnxParseRecvBuffer(Serial, -1, &view);
+	lwnxServiceCommands(Serial);
+
+	while (Serial->recvParser.packetCount == startCount) {
+		if (!lwnxWaitRecvData(Serial, timeoutTime)) {
+			break;
+		}
+
+		if (lwnxFillRecvBuffer(Serial) == -1) {
+			return -1;
+		}
+
+		lwnxParseRecvBuffer(Serial, -1, &view);
+		lwnxServiceCommands(Serial);
+
+		if (platformGetMicrosecond() >= timeoutTime) {
+			break;
+		}
+	}
+
+	return Serial->recvParser.packetCount - startCount;
+}
+
+bool lwnxRecvPacketNoBlock(lwSerialPort* Serial, uint8_t CommandId, lwResponsePacket* Response) {
+	lwPacketView view;
+
+	if (lwnxParseRecvBuffer(Serial, CommandId, &view) || (lwnxFillRecvBuffer(Serial) > 0 && lwnxParseRecvBuffer(Serial, CommandId, &view))) {
+		lwnxCopyPacketView(&view, Response);
+		return true;
+	}
+
+	return false;
+}
+
+bool lwnxRecvPacket(lwSerialPort* Serial, uint8_t CommandId, lwResponsePacket* Response, uint32_t TimeoutMs) {
+	lwnxInitResponsePacket(Response);
+
+	lwPacketView view;
+
+	if (lwnxWaitRecvBuffer(Serial, CommandId, &view, TimeoutMs)) {
+		lwnxCopyPacketView(&view, Response);
+		return true;
+	}
+
+	return false;
+}
+
+bool lwnxRecvPacketView(lwSerialPort* Serial, uint8_t CommandId, lwPacketView* View, uint32_t TimeoutMs) {
+	if (lwnxWaitRecvBuffer(Serial, CommandId, View, TimeoutMs)) {
+		++Serial->recvHoldCount;
+		return true;
+	}
+
+	return false;
+}
+
+void lwnxReleasePacketView(lwSerialPort* Serial, lwPacketView* View) {
+	if (View->data != NULL) {
+		--Serial->recvHoldCount;
+		View->data = NULL;
+		View->payload = NULL;
+	}
+}
+
 void lwnxSendPacketBytes(lwSerialPort* Serial, uint8_t CommandId, uint8_t Write, uint8_t* Data, uint32_t DataSize) {
 	uint8_t buffer[1024];
 	uint32_t payloadLength = 1 + DataSize;
@@ -138,21 +623,98 @@ void lwnxSendPacketBytes(lwSerialPort* Serial, uint8_t CommandId, uint8_t Write,
 	Serial->writeData(buffer, 6 + DataSize);
 }
 
-bool lwnxHandleManagedCmd(lwSerialPort* Serial, uint8_t CommandId, uint8_t* Response, uint32_t ResponseSize, bool Write, uint8_t* WriteData, uint32_t WriteSize) {
-	int32_t attempts = PACKET_RETRIES;
+void lwnxInitReadCommand(lwCommand* Command, uint8_t CommandId, uint8_t* Response, uint32_t ResponseSize) {
+	Command->commandId = CommandId;
+	Command->write = false;
+	Command->writeData = NULL;
+	Command->writeSize = 0;
+	Command->response = Response;
+	Command->responseSize = ResponseSize;
+	Command->complete = false;
+	Command->failed = false;
+	Command->attempts = 0;
+	Command->maxAttempts = 0;
+	Command->callback = NULL;
+	Command->user = NULL;
+	Command->next = NULL;
+}
+
+void lwnxInitWriteCommand(lwCommand* Command, uint8_t CommandId, uint8_t* Data, uint32_t DataSize) {
+	Command->commandId = CommandId;
+	Command->write = true;
+	Command->writeData = Data;
+	Command->writeSize = DataSize;
+	Command->response = NULL;
+	Command->responseSize = 0;
+	Command->complete = false;
+	Command->failed = false;
+	Command->attempts = 0;
+	Command->maxAttempts = 1;
+	Command->callback = NULL;
+	Command->user = NULL;
+	Command->next = NULL;
+}
 
-	while (attempts--) {
-		lwnxSendPacketBytes(Serial, CommandId, Write, WriteData, WriteSize);
+void lwnxSubmitCommand(lwSerialPort* Serial, lwCommand* Command, lwCommandCallbackFunc Callback, void* User) {
+	int64_t now = platformGetMicrosecond();
 
-		lwResponsePacket response;
-		
-		if (lwnxRecvPacket(Serial, CommandId, &response, PACKET_TIMEOUT)) {
-			memcpy(Response, response.data + 4, ResponseSize);
-			return true;
+	Command->complete = false;
+	Command->failed = false;
+	Command->attempts = 0;
+	Command->deadlineTimeUs = now + Serial->linkTiming.deadlineUs;
+	Command->callback = Callback;
+	Command->user = User;
+
+	lwnxAddPendingCommand(Serial, Command);
+	lwnxSendPendingCommand(Serial, Command, now);
+}
+
+bool lwnxCommandDone(lwCommand* Command) {
+	return Command->complete || Command->failed;
+}
+
+bool lwnxWaitCommand(lwSerialPort* Serial, lwCommand* Command, uint32_t TimeoutMs) {
+	lwnxWaitCommandUntil(Serial, Command, platformGetMicrosecond() + (int64_t)TimeoutMs * 1000);
+
+	return Command->complete;
+}
+
+void lwnxCancelCommand(lwSerialPort* Serial, lwCommand* Command) {
+	if (lwnxRemovePendingCommand(Serial, Command)) {
+		lwnxExpectLateReplies(Serial, Command, Command->attempts);
+	}
+}
+
+bool lwnxHandleManagedBatch(lwSerialPort* Serial, lwCommand* Commands, int32_t Count) {
+	for (int32_t i = 0; i < Count; ++i) {
+		lwnxSubmitCommand(Serial, &Commands[i]);
+	}
+
+	bool result = true;
+
+	for (int32_t i = 0; i < Count; ++i) {
+		// NOTE: The command fails at its deadline, so this only stops early if the serial port fails or held packet views
+		// have filled the receive buffer.
+		lwnxWaitCommandUntil(Serial, &Commands[i], Commands[i].deadlineTimeUs);
+
+		if (!Commands[i].complete) {
+			lwnxCancelCommand(Serial, &Commands[i]);
+			result = false;
 		}
 	}
 
-	return false;
+	return result;
+}
+
+bool lwnxHandleManagedCmd(lwSerialPort* Serial, uint8_t CommandId, uint8_t* Response, uint32_t ResponseSize, bool Write, uint8_t* WriteData, uint32_t WriteSize) {
+	lwCommand command;
+	lwnxInitReadCommand(&command, CommandId, Response, ResponseSize);
+	command.write = Write;
+	command.writeData = WriteData;
+	command.writeSize = WriteSize;
+	command.maxAttempts = Write ? 1 : 0;
+
+	return lwnxHandleManagedBatch(Serial, &command, 1);
 }
 
 bool lwnxCmdReadInt8(lwSerialPort* Serial, uint8_t CommandId, int8_t* Response) {
@@ -217,4 +779,91 @@ bool lwnxCmdWriteString(lwSerialPort* Serial, uint8_t CommandId, char* String) {
 
 bool lwnxCmdWriteData(lwSerialPort* Serial, uint8_t CommandId, uint8_t* Data, uint32_t DataSize) {
 	return lwnxHandleManagedCmd(Serial, CommandId, NULL, 0, true, Data, DataSize);
+}
+
+void lwnxCmdReadInt8Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int8_t* Response, lwCommandCallbackFunc Callback, void* User) {
+	lwnxInitReadCommand(Command, CommandId, (uint8_t*)Response, 1);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdReadInt16Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int16_t* Response, lwCommandCallbackFunc Callback, void* User) {
+	lwnxInitReadCommand(Command, CommandId, (uint8_t*)Response, 2);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdReadInt32Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int32_t* Response, lwCommandCallbackFunc Callback, void* User) {
+	lwnxInitReadCommand(Command, CommandId, (uint8_t*)Response, 4);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdReadUInt8Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint8_t* Response, lwCommandCallbackFunc Callback, void* User) {
+	lwnxInitReadCommand(Command, CommandId, (uint8_t*)Response, 1);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdReadUInt16Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint16_t* Response, lwCommandCallbackFunc Callback, void* User) {
+	lwnxInitReadCommand(Command, CommandId, (uint8_t*)Response, 2);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdReadUInt32Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint32_t* Response, lwCommandCallbackFunc Callback, void* User) {
+	lwnxInitReadCommand(Command, CommandId, (uint8_t*)Response, 4);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdReadStringAsync(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, char* Response, lwCommandCallbackFunc Callback, void* User) {
+	lwnxInitReadCommand(Command, CommandId, (uint8_t*)Response, 16);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdReadDataAsync(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint8_t* Response, uint32_t ResponseSize, lwCommandCallbackFunc Callback, void* User) {
+	lwnxInitReadCommand(Command, CommandId, Response, ResponseSize);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdWriteInt8Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int8_t Value, lwCommandCallbackFunc Callback, void* User) {
+	memcpy(Command->writeBuffer, &Value, 1);
+	lwnxInitWriteCommand(Command, CommandId, Command->writeBuffer, 1);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdWriteInt16Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int16_t Value, lwCommandCallbackFunc Callback, void* User) {
+	memcpy(Command->writeBuffer, &Value, 2);
+	lwnxInitWriteCommand(Command, CommandId, Command->writeBuffer, 2);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdWriteInt32Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int32_t Value, lwCommandCallbackFunc Callback, void* User) {
+	memcpy(Command->writeBuffer, &Value, 4);
+	lwnxInitWriteCommand(Command, CommandId, Command->writeBuffer, 4);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdWriteUInt8Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint8_t Value, lwCommandCallbackFunc Callback, void* User) {
+	memcpy(Command->writeBuffer, &Value, 1);
+	lwnxInitWriteCommand(Command, CommandId, Command->writeBuffer, 1);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdWriteUInt16Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint16_t Value, lwCommandCallbackFunc Callback, void* User) {
+	memcpy(Command->writeBuffer, &Value, 2);
+	lwnxInitWriteCommand(Command, CommandId, Command->writeBuffer, 2);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdWriteUInt32Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint32_t Value, lwCommandCallbackFunc Callback, void* User) {
+	memcpy(Command->writeBuffer, &Value, 4);
+	lwnxInitWriteCommand(Command, CommandId, Command->writeBuffer, 4);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdWriteStringAsync(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, char* String, lwCommandCallbackFunc Callback, void* User) {
+	memcpy(Command->writeBuffer, String, 16);
+	lwnxInitWriteCommand(Command, CommandId, Command->writeBuffer, 16);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
+}
+
+void lwnxCmdWriteDataAsync(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint8_t* Data, uint32_t DataSize, lwCommandCallbackFunc Callback, void* User) {
+	lwnxInitWriteCommand(Command, CommandId, Data, DataSize);
+	lwnxSubmitCommand(Serial, Command, Callback, User);
 }
\ No newline at end of file
@@ -1,11 +1,43 @@
 #pragma once
 
 #include "common.h"
+#include "lwPacket.h"
+
+// Size of the per port receive buffer. Must hold at least one full packet (1030 bytes).
+#define LW_RECV_BUFFER_SIZE	16384
+// Number of reads whose arrival time is kept for the unconsumed part of the receive buffer.
+#define LW_RECV_CHUNK_COUNT	64
 
 class lwSerialPort {
 	public:
+		// Bytes read from the port that have not been consumed yet are in recvBuffer[recvHead, recvTail).
+		// The buffer is filled with large reads and the parser consumes from memory.
+		uint8_t recvBuffer[LW_RECV_BUFFER_SIZE];
+		int32_t recvHead;
+		int32_t recvTail;
+		// Number of packet views into recvBuffer that have not been released. The buffer is not compacted while non zero.
+		int32_t recvHoldCount;
+		// Arrival time of each read still in recvBuffer, oldest first, used to timestamp packets.
+		lwRecvChunk recvChunks[LW_RECV_CHUNK_COUNT];
+		int32_t recvChunkCount;
+		lwPacketParser recvParser;
+		// Handlers for received packets, indexed by command id.
+		lwPacketHandler recvHandlers[256];
+		// Replies expected to earlier sends of completed, failed or cancelled commands, indexed by command id. They are
+		// dropped so they can't complete a later command with the same id.
+		lwLateReplies lateReplies[256];
+		// Commands that have been sent and are waiting for a response, oldest first.
+		lwCommand* pendingCommands;
+		lwLinkTiming linkTiming;
+
+		lwSerialPort() : recvHead(0), recvTail(0), recvHoldCount(0), recvChunkCount(0), pendingCommands(0) { }
+
 		virtual bool connect(const char* Name, int BitRate) = 0;
 		virtual bool disconnect() = 0;
 		virtual int writeData(uint8_t *Buffer, int32_t BufferSize) = 0;
 		virtual int32_t readData(uint8_t *Buffer, int32_t BufferSize) = 0;
+
+		// Blocks until data can be read or TimeoutUs has passed. Returns true if data can be read.
+		// Ports that can't wait for readiness return true immediately and rely on readData to block instead.
+		virtual bool waitForData(int64_t TimeoutUs) { return true; }
 };
\ No newline at end of file
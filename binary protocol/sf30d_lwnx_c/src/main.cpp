@@ -3,6 +3,11 @@
 //----------------------------------------------------------------------------------------------------------------------------------
 #include "common.h"
 #include "lwNx.h"
+#include "lwDistanceOutput.h"
+
+// Distance output written to the sensor, which also fixes the layout of the streamed packets. (Command 29: Distance output)
+// Selects every field the SF30/D has: first and last return raw, filtered and strength, background noise and temperature.
+typedef lwDistanceDecoder<0xFFFFFFFF> distanceDecoder;
 
 //----------------------------------------------------------------------------------------------------------------------------------
 // Helper utilities.
@@ -27,12 +32,6 @@ void exitCommandFailure() {
 	exitWithMessage("No response to command, terminating sample.\n");
 }
 
-uint16_t readInt16(uint8_t* Buffer, uint32_t Offset) {
-	uint16_t result;
-	result = (Buffer[Offset + 0] << 0) | (Buffer[Offset + 1] << 8);
-	return result;
-}
-
 //----------------------------------------------------------------------------------------------------------------------------------
 // Application Entry.
 //----------------------------------------------------------------------------------------------------------------------------------
@@ -42,13 +41,18 @@ int main(int args, char **argv)
 	
 	printf("LWNX sample\n");
 
-	// NOTE: Change the port name to the one assigned by the OS to the plugged in lidar.
+	// NOTE: Change the port name to the one assigned by the OS to the plugged in lidar, or pass it as the first argument,
+	// like the pseudo terminal of the emulator.
 #ifdef __linux__
 	const char* portName = "/dev/ttyUSB0";
 #else
 	const char* portName = "\\\\.\\COM4";
 #endif
 
+	if (args > 1) {
+		portName = argv[1];
+	}
+
 	int32_t baudRate = 921600;
 
 	lwSerialPort* serial = platformCreateSerialPort();
@@ -84,8 +88,8 @@ int main(int args, char **argv)
 	// Set the output rate to 78 readings per second. (Command 76: Update rate)
 	if (!lwnxCmdWriteUInt8(serial, 76, 8)) { exitCommandFailure(); }
 
-	// Set distance output to include all information: (Command 29: Distance output)
-	if (!lwnxCmdWriteUInt32(serial, 29, 0xFFFFFFFF)) { exitCommandFailure(); }
+	// Set distance output to the fields decoded by distanceDecoder. (Command 29: Distance output)
+	if (!lwnxCmdWriteUInt32(serial, 29, distanceDecoder::mask)) { exitCommandFailure(); }
 	
 	// Enable streaming of point data. (Command 30: Stream)
 	if (!lwnxCmdWriteUInt32(serial, 30, 5)) { exitCommandFailure(); }
@@ -93,21 +97,18 @@ int main(int args, char **argv)
 	// Continuously wait for and process the streamed point data packets.
 	// The incoming point data packet is Command 44: Distance data in cm.
 	while (1) {
-		lwResponsePacket response;
+		lwPacketView packet;
 		
-		if (lwnxRecvPacket(serial, 44, &response, 1000)) {
-			uint16_t firstReturnRaw = readInt16(response.data, 4);
-			uint16_t firstReturnFiltered = readInt16(response.data, 6);
-			uint16_t firstReturnStrength = readInt16(response.data, 8);
-
-			uint16_t lastReturnRaw = readInt16(response.data, 10);
-			uint16_t lastReturnFiltered = readInt16(response.data, 12);
-			uint16_t lastReturnStrength = readInt16(response.data, 14);
+		if (lwnxRecvPacketView(serial, 44, &packet, 1000)) {
+			lwDistanceSample sample;
 
-			uint16_t backgroundNoise = readInt16(response.data, 16);
-			uint16_t temperature = readInt16(response.data, 18) / 100;
+			if (distanceDecoder::decode(&packet, &sample)) {
+				printf("Distance: %5d cm  Strength: %5d %%  Temperature: %5d degrees\n", sample.firstReturnFiltered, sample.firstReturnStrength, sample.temperature / 100);
+			} else {
+				printf("Distance data does not match the distance output (%d bytes)\n", packet.payloadSize);
+			}
 
-			printf("Distance: %5d cm  Strength: %5d %%  Temperature: %5d degrees\n", firstReturnFiltered, firstReturnStrength, temperature);
+			lwnxReleasePacketView(serial, &packet);
 		}
 	}
 
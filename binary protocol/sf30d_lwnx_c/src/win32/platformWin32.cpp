@@ -26,8 +26,8 @@ int64_t platformGetMicrosecond() {
 	return (int64_t)(getTimeSeconds() * 1000000);
 }
 
-int32_t platformGetMillisecond() {
-	return (int32_t)(getTimeSeconds() * 1000);
+int64_t platformGetMillisecond() {
+	return (int64_t)(getTimeSeconds() * 1000);
 }
 
 bool platformSleep(int32_t TimeMS) {
@@ -12,7 +12,7 @@
 void platformInit();
 
 int64_t platformGetMicrosecond();
-int32_t platformGetMillisecond();
+int64_t platformGetMillisecond();
 bool platformSleep(int32_t TimeMS);
 
 lwSerialPort* platformCreateSerialPort();
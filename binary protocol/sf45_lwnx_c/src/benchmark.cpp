@@ -0,0 +1,1438 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// LightWare LWNX Benchmark.
+// Measures the protocol implementation against synthetic data and recorded captures, no device is needed. The round trip
+// and streaming latencies are measured over a pseudo terminal, with the emulator answering commands in another thread.
+//
+// Every result is also printed as a line of name,value,unit at the end, and written to a file with -o, so runs of
+// different releases on the same host can be compared.
+//----------------------------------------------------------------------------------------------------------------------------------
+#include "common.h"
+#include "lwNx.h"
+#include "lwDistanceBatch.h"
+#include "lwPolar.h"
+#include "lwSweep.h"
+#include "lwRangeImage.h"
+#include "lwCapture.h"
+#include "lwSerialPortReplay.h"
+#include "linux/lwSerialPortLinux.h"
+#include "linux/lwReactor.h"
+#include "emulator/lwEmulator.h"
+
+#include <math.h>
+#include <algorithm>
+#include <thread>
+
+// Most results kept for the machine readable output.
+#define MAX_RESULTS		128
+// Emulated SF45s served by one reactor.
+#define REACTOR_PORTS	16
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Helper utilities.
+//----------------------------------------------------------------------------------------------------------------------------------
+class benchmarkResult {
+	public:
+		char name[64];
+		double value;
+		const char* unit;
+};
+
+benchmarkResult results[MAX_RESULTS];
+int32_t resultCount = 0;
+
+// Keeps a result for the machine readable output. Names are dotted, like parser.clean.buffer4096.
+void addResult(const char* Name, double Value, const char* Unit) {
+	if (resultCount == MAX_RESULTS) {
+		return;
+	}
+
+	snprintf(results[resultCount].name, sizeof(results[resultCount].name), "%s", Name);
+	results[resultCount].value = Value;
+	results[resultCount].unit = Unit;
+	++resultCount;
+}
+
+void writeResults(FILE* File) {
+	fprintf(File, "# crc=%s convert=%s polar=%s\n", lwCrc16ImplementationName(), lwConvertImplementationName(), lwPolarImplementationName());
+	fprintf(File, "name,value,unit\n");
+
+	for (int32_t i = 0; i < resultCount; ++i) {
+		fprintf(File, "%s,%.3f,%s\n", results[i].name, results[i].value, results[i].unit);
+	}
+}
+
+// Sorts Values and adds its median, 90th and 99th percentile and maximum as Name.p50 and so on.
+void addPercentiles(const char* Name, int64_t* Values, int32_t Count, const char* Unit) {
+	if (Count == 0) {
+		return;
+	}
+
+	std::sort(Values, Values + Count);
+
+	const char* suffixes[] = { "p50", "p90", "p99", "max" };
+	int64_t values[] = { Values[Count / 2], Values[Count * 9 / 10], Values[Count * 99 / 100], Values[Count - 1] };
+	char name[64];
+
+	printf("  %-24s p50 %6lld  p90 %6lld  p99 %6lld  max %6lld %s  (%d samples)\n", Name, (long long)values[0], (long long)values[1],
+		(long long)values[2], (long long)values[3], Unit, Count);
+
+	for (int32_t i = 0; i < 4; ++i) {
+		snprintf(name, sizeof(name), "%s.%s", Name, suffixes[i]);
+		addResult(name, (double)values[i], Unit);
+	}
+}
+
+// Appends a packet to Buffer and returns the number of bytes written.
+int32_t writePacket(uint8_t* Buffer, uint8_t CommandId, uint8_t* Data, uint32_t DataSize) {
+	uint16_t flags = (1 + DataSize) << 6;
+
+	Buffer[0] = PACKET_START_BYTE;
+	Buffer[1] = flags & 0xFF;
+	Buffer[2] = (flags >> 8) & 0xFF;
+	Buffer[3] = CommandId;
+	memcpy(Buffer + 4, Data, DataSize);
+	uint16_t crc = lwnxCreateCrc(Buffer, 4 + DataSize);
+	Buffer[4 + DataSize] = crc & 0xFF;
+	Buffer[5 + DataSize] = (crc >> 8) & 0xFF;
+
+	return 6 + DataSize;
+}
+
+// Fills Buffer with a stream of SF45 distance packets (command 44, 8 byte payload).
+int32_t createDistanceStream(uint8_t* Buffer, int32_t BufferSize, int32_t* PacketCount) {
+	int32_t size = 0;
+	int32_t count = 0;
+	uint8_t data[8];
+
+	while (size + 14 <= BufferSize) {
+		for (int i = 0; i < 8; ++i) {
+			data[i] = (uint8_t)(rand() & 0xFF);
+		}
+
+		size += writePacket(Buffer + size, 44, data, 8);
+		++count;
+	}
+
+	*PacketCount = count;
+
+	return size;
+}
+
+// Fills Buffer with distance packets mixed with line noise: runs of random bytes that often hold false start bytes, and
+// packets with a corrupted byte. PacketCount receives the number of intact packets.
+// NOTE: The stream ends with more than a packet of clean data, so a false start near the end doesn't leave the parser
+// waiting for bytes that never arrive.
+int32_t createNoisyDistanceStream(uint8_t* Buffer, int32_t BufferSize, int32_t* PacketCount) {
+	int32_t size = 0;
+	int32_t count = 0;
+	uint8_t data[8];
+
+	while (size + 14 + 16 <= BufferSize) {
+		if ((rand() % 8) == 0 && size + PACKET_MAX_SIZE * 2 < BufferSize) {
+			int32_t noiseSize = 1 + rand() % 16;
+
+			for (int32_t i = 0; i < noiseSize; ++i) {
+				Buffer[size + i] = (rand() % 4 == 0) ? PACKET_START_BYTE : (uint8_t)(rand() & 0xFF);
+			}
+
+			size += noiseSize;
+		}
+
+		for (int i = 0; i < 8; ++i) {
+			data[i] = (uint8_t)(rand() & 0xFF);
+		}
+
+		int32_t packetSize = writePacket(Buffer + size, 44, data, 8);
+
+		if ((rand() % 32) == 0 && size + PACKET_MAX_SIZE * 2 < BufferSize) {
+			Buffer[size + 4 + rand() % 10] ^= (uint8_t)(1 + rand() % 255);
+		} else {
+			++count;
+		}
+
+		size += packetSize;
+	}
+
+	*PacketCount = count;
+
+	return size;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Benchmarks.
+//----------------------------------------------------------------------------------------------------------------------------------
+// Feeds the stream one byte at a time through lwnxParseData.
+int32_t runStateMachineParser(uint8_t* Stream, int32_t StreamSize) {
+	lwResponsePacket response;
+	int32_t count = 0;
+
+	for (int32_t i = 0; i < StreamSize; ++i) {
+		if (lwnxParseData(&response, Stream[i])) {
+			++count;
+		}
+	}
+
+	return count;
+}
+
+// Feeds the stream in read sized chunks through lwnxParseBuffer, carrying incomplete packets to the next chunk.
+int32_t runBufferParser(uint8_t* Stream, int32_t StreamSize, int32_t ChunkSize) {
+	lwPacketParser parser;
+	lwPacketSpan packets[256];
+	int32_t count = 0;
+	int32_t pos = 0;
+	int32_t end = 0;
+
+	while (pos < StreamSize) {
+		end += ChunkSize;
+
+		if (end > StreamSize) {
+			end = StreamSize;
+		}
+
+		while (true) {
+			int32_t consumed = 0;
+			int32_t found = lwnxParseBuffer(&parser, Stream + pos, end - pos, packets, 256, &consumed);
+			pos += consumed;
+			count += found;
+
+			if (found < 256) {
+				break;
+			}
+		}
+
+		if (end == StreamSize) {
+			break;
+		}
+	}
+
+	return count;
+}
+
+// Measures the parsers over Stream, which holds PacketCount intact packets. Name is the kind of stream, like clean.
+// NOTE: lwnxParseData prints every packet it rejects, so it is only measured on clean streams.
+void benchmarkParserStream(const char* Name, uint8_t* Stream, int32_t StreamSize, int32_t PacketCount, int32_t Iterations, bool Clean) {
+	char name[64];
+	int64_t startTime;
+	int32_t found = 0;
+	double elapsed;
+	double rate;
+
+	printf("Parser, %s stream: %d packets, %d bytes\n", Name, PacketCount, StreamSize);
+
+	if (Clean) {
+		startTime = platformGetMicrosecond();
+
+		for (int i = 0; i < Iterations; ++i) {
+			found = runStateMachineParser(Stream, StreamSize);
+		}
+
+		elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+		rate = (double)PacketCount * Iterations / elapsed;
+		printf("  lwnxParseData:   %10.0f packets/s  (%d found)\n", rate, found);
+		snprintf(name, sizeof(name), "parser.%s.parseData", Name);
+		addResult(name, rate, "packets/s");
+	}
+
+	const int32_t chunkSizes[] = { 64, 4096 };
+
+	for (int c = 0; c < 2; ++c) {
+		startTime = platformGetMicrosecond();
+
+		for (int i = 0; i < Iterations; ++i) {
+			found = runBufferParser(Stream, StreamSize, chunkSizes[c]);
+		}
+
+		elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+		rate = (double)PacketCount * Iterations / elapsed;
+		printf("  lwnxParseBuffer: %10.0f packets/s  (%d found, %d byte reads)\n", rate, found, chunkSizes[c]);
+		snprintf(name, sizeof(name), "parser.%s.buffer%d", Name, chunkSizes[c]);
+		addResult(name, rate, "packets/s");
+
+		if (found != PacketCount) {
+			// NOTE: Noise that passes the 16 bit CRC by chance is taken as a packet, and swallows the real ones it covers.
+			printf("  NOTE: %d packets were lost to the noise\n", PacketCount - found);
+		}
+	}
+}
+
+void benchmarkParser() {
+	const int32_t streamSize = 16 * 1024 * 1024;
+	uint8_t* stream = (uint8_t*)malloc(streamSize);
+	int32_t packetCount = 0;
+
+	int32_t size = createDistanceStream(stream, streamSize, &packetCount);
+	benchmarkParserStream("clean", stream, size, packetCount, 4, true);
+
+	size = createNoisyDistanceStream(stream, streamSize, &packetCount);
+	benchmarkParserStream("noisy", stream, size, packetCount, 4, false);
+
+	free(stream);
+}
+
+// Checks every CRC implementation is bit exact with the reference over random sizes, alignments and initial values.
+bool verifyCrc() {
+	uint8_t buffer[4096 + 16];
+	lwCrc16Func impls[] = { lwCrc16Table, lwCrc16Slice4, lwCrc16Slice8, lwCrc16Fold, lwCrc16 };
+	const char* names[] = { "table", "slice4", "slice8", "fold", "lwCrc16" };
+	int32_t implCount = lwCrc16FoldSupported() ? 5 : 4;
+
+	if (!lwCrc16FoldSupported()) {
+		impls[3] = lwCrc16;
+		names[3] = "lwCrc16";
+	}
+
+	for (uint32_t i = 0; i < sizeof(buffer); ++i) {
+		buffer[i] = (uint8_t)(rand() & 0xFF);
+	}
+
+	for (int32_t test = 0; test < 20000; ++test) {
+		uint32_t size = (test < 4096) ? test : (rand() % 4096);
+		uint32_t offset = rand() % 16;
+		uint16_t initial = (test & 1) ? (uint16_t)rand() : 0;
+		uint16_t expected = lwCrc16Bitwise(initial, buffer + offset, size);
+
+		for (int32_t i = 0; i < implCount; ++i) {
+			if (impls[i](initial, buffer + offset, size) != expected) {
+				printf("CRC mismatch: %s size %d offset %d initial 0x%04X\n", names[i], size, offset, initial);
+				return false;
+			}
+		}
+	}
+
+	printf("CRC: all implementations match lwCrc16Bitwise\n");
+
+	return true;
+}
+
+void benchmarkCrc() {
+	const int32_t bufferSize = 64 * 1024 * 1024;
+	uint8_t* buffer = (uint8_t*)malloc(bufferSize);
+
+	for (int32_t i = 0; i < bufferSize; ++i) {
+		buffer[i] = (uint8_t)(rand() & 0xFF);
+	}
+
+	lwCrc16Func impls[] = { lwCrc16Bitwise, lwCrc16Table, lwCrc16Slice4, lwCrc16Slice8, lwCrc16Fold, lwCrc16 };
+	const char* names[] = { "bitwise", "table", "slice4", "slice8", "fold", "lwCrc16" };
+	const int32_t blockSizes[] = { 14, 1024, bufferSize };
+
+	printf("CRC: lwCrc16 uses %s for large buffers\n", lwCrc16ImplementationName());
+
+	for (int32_t i = 0; i < 6; ++i) {
+		if (impls[i] == lwCrc16Fold && !lwCrc16FoldSupported()) {
+			continue;
+		}
+
+		printf("  %-8s", names[i]);
+
+		for (int32_t b = 0; b < 3; ++b) {
+			int32_t blockSize = blockSizes[b];
+			int32_t blockCount = bufferSize / blockSize;
+			uint16_t crc = 0;
+			int64_t startTime = platformGetMicrosecond();
+
+			for (int32_t block = 0; block < blockCount; ++block) {
+				crc ^= impls[i](0, buffer + block * blockSize, blockSize);
+			}
+
+			double elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+			double rate = (double)blockCount * blockSize / elapsed / 1000000.0;
+			printf("  %8.1f MB/s (%d byte blocks, 0x%04X)", rate, blockSize, crc);
+
+			char name[64];
+			snprintf(name, sizeof(name), "crc.%s.%d", names[i], blockSize);
+			addResult(name, rate, "MB/s");
+		}
+
+		printf("\n");
+	}
+
+	free(buffer);
+}
+
+// Distance data of every field converted to floats, one record per packet.
+class distanceRecord {
+	public:
+		#define DISTANCE_RECORD_FIELD(Bit, Name, Type, Scale) float Name;
+		LW_DISTANCE_FIELDS(DISTANCE_RECORD_FIELD)
+		#undef DISTANCE_RECORD_FIELD
+};
+
+// Checks the SIMD conversion and batch decoding against per packet decoding, including partial blocks and vector tails.
+bool verifyDistanceBatch() {
+	const int32_t count = 1000;
+	const uint32_t masks[] = { 0x185, 0x1FF, 0x0A };
+	uint8_t* payloads = (uint8_t*)malloc(count * 18);
+	const uint8_t** payloadList = (const uint8_t**)malloc(count * sizeof(uint8_t*));
+	float* columns = (float*)malloc(count * LW_DISTANCE_FIELD_COUNT * sizeof(float));
+
+	for (int32_t i = 0; i < count * 18; ++i) {
+		payloads[i] = (uint8_t)(rand() & 0xFF);
+	}
+
+	for (int32_t m = 0; m < 3; ++m) {
+		lwDistanceLayout layout;
+		lwDistanceInitLayout(&layout, masks[m]);
+
+		lwDistanceColumns output;
+		#define DISTANCE_SET_COLUMN(Bit, Name, Type, Scale) output.Name = columns + Bit * count;
+		LW_DISTANCE_FIELDS(DISTANCE_SET_COLUMN)
+		#undef DISTANCE_SET_COLUMN
+
+		for (int32_t i = 0; i < count; ++i) {
+			payloadList[i] = payloads + i * layout.payloadSize;
+		}
+
+		lwDistanceDecodeBatch(&layout, payloadList, count, &output);
+
+		for (int32_t i = 0; i < count; ++i) {
+			lwDistanceSample sample;
+			lwDistanceDecode(&layout, payloadList[i], &sample);
+
+			#define DISTANCE_CHECK(Bit, Name, Type, Scale) \
+				if (output.Name[i] != (float)sample.Name * Scale) { \
+					printf("Distance batch mismatch: mask 0x%X packet %d " #Name "\n", masks[m], i); \
+					return false; \
+				}
+			LW_DISTANCE_FIELDS(DISTANCE_CHECK)
+			#undef DISTANCE_CHECK
+		}
+	}
+
+	free(columns);
+	free(payloadList);
+	free(payloads);
+
+	printf("Distance batch: matches per packet decoding (%s)\n", lwConvertImplementationName());
+
+	return true;
+}
+
+void benchmarkDistanceBatch() {
+	// NOTE: Sized to stay in cache so the decoding itself is measured rather than memory bandwidth.
+	const int32_t count = 16 * 1024;
+	const int32_t iterations = 512;
+	lwDistanceLayout layout;
+	lwDistanceInitLayout(&layout, 0x1FF);
+
+	uint8_t* payloads = (uint8_t*)malloc(count * layout.payloadSize);
+	const uint8_t** payloadList = (const uint8_t**)malloc(count * sizeof(uint8_t*));
+	distanceRecord* records = (distanceRecord*)malloc(count * sizeof(distanceRecord));
+	float* columns = (float*)malloc(count * LW_DISTANCE_FIELD_COUNT * sizeof(float));
+
+	for (int32_t i = 0; i < count * layout.payloadSize; ++i) {
+		payloads[i] = (uint8_t)(rand() & 0xFF);
+	}
+
+	for (int32_t i = 0; i < count; ++i) {
+		payloadList[i] = payloads + i * layout.payloadSize;
+	}
+
+	printf("Distance decoding: %d packets, all fields\n", count);
+
+	int64_t startTime = platformGetMicrosecond();
+
+	for (int32_t n = 0; n < iterations; ++n) {
+		for (int32_t i = 0; i < count; ++i) {
+			lwDistanceSample sample;
+			lwDistanceDecode(&layout, payloadList[i], &sample);
+
+			#define DISTANCE_RECORD_CONVERT(Bit, Name, Type, Scale) records[i].Name = sample.Name * Scale;
+			LW_DISTANCE_FIELDS(DISTANCE_RECORD_CONVERT)
+			#undef DISTANCE_RECORD_CONVERT
+		}
+	}
+
+	double elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+	printf("  per packet records: %10.0f packets/s\n", (double)count * iterations / elapsed);
+	addResult("distance.records", (double)count * iterations / elapsed, "packets/s");
+
+	lwDistanceColumns output;
+	#define DISTANCE_SET_COLUMN(Bit, Name, Type, Scale) output.Name = columns + Bit * count;
+	LW_DISTANCE_FIELDS(DISTANCE_SET_COLUMN)
+	#undef DISTANCE_SET_COLUMN
+
+	startTime = platformGetMicrosecond();
+
+	for (int32_t n = 0; n < iterations; ++n) {
+		lwDistanceDecodeBatch(&layout, payloadList, count, &output);
+	}
+
+	elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+	printf("  batch columns:      %10.0f packets/s  (%s)\n", (double)count * iterations / elapsed, lwConvertImplementationName());
+	addResult("distance.columns", (double)count * iterations / elapsed, "packets/s");
+
+	const int32_t valueCount = count * LW_DISTANCE_FIELD_COUNT;
+	int16_t* values = (int16_t*)payloads;
+	float* result = columns;
+
+	startTime = platformGetMicrosecond();
+
+	for (int32_t n = 0; n < iterations; ++n) {
+		lwConvertInt16ToFloatScalar(values, result, valueCount, 0.01f);
+	}
+
+	elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+	printf("  int16 to float scalar: %10.0f values/s\n", (double)valueCount * iterations / elapsed);
+	addResult("convert.scalar", (double)valueCount * iterations / elapsed, "values/s");
+
+	startTime = platformGetMicrosecond();
+
+	for (int32_t n = 0; n < iterations; ++n) {
+		lwConvertInt16ToFloat(values, result, valueCount, 0.01f);
+	}
+
+	elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+	printf("  int16 to float %s:   %10.0f values/s\n", lwConvertImplementationName(), (double)valueCount * iterations / elapsed);
+	addResult("convert.simd", (double)valueCount * iterations / elapsed, "values/s");
+
+	free(columns);
+	free(records);
+	free(payloadList);
+	free(payloads);
+}
+
+// Fills a sweep with random distances, some of them 0 for no return, across the whole yaw angle range.
+void createPolarSamples(uint16_t* Distance, int16_t* YawAngle, int32_t Count) {
+	for (int32_t i = 0; i < Count; ++i) {
+		Distance[i] = (rand() % 8 == 0) ? 0 : (uint16_t)(rand() % 5000);
+		YawAngle[i] = (int16_t)(rand() & 0xFFFF);
+	}
+}
+
+// Checks the selected kernel matches the scalar one, including vector tails, and the table error against sin and cos.
+bool verifyPolar() {
+	const int32_t count = 4099;
+	uint16_t* distance = (uint16_t*)malloc(count * sizeof(uint16_t));
+	int16_t* yawAngle = (int16_t*)malloc(count * sizeof(int16_t));
+	float* points = (float*)malloc(count * 4 * sizeof(float));
+	uint8_t* valid = (uint8_t*)malloc(count * 2);
+
+	createPolarSamples(distance, yawAngle, count);
+	distance[0] = 9;
+	distance[1] = 10;
+	distance[2] = 4000;
+	distance[3] = 4001;
+
+	float* x = points;
+	float* y = points + count;
+	float* refX = points + count * 2;
+	float* refY = points + count * 3;
+	double maxError = 0;
+
+	for (int32_t n = 1; n <= count; n += (n < 64) ? 1 : 1000) {
+		int32_t validCount = lwPolarToCartesian(distance, yawAngle, n, 10, 4000, x, y, valid);
+		int32_t refValidCount = lwPolarToCartesianScalar(distance, yawAngle, n, 10, 4000, refX, refY, valid + count);
+
+		if (validCount != refValidCount || memcmp(x, refX, n * sizeof(float)) != 0 || memcmp(y, refY, n * sizeof(float)) != 0 || memcmp(valid, valid + count, n) != 0) {
+			printf("Polar mismatch: %s count %d\n", lwPolarImplementationName(), n);
+			return false;
+		}
+
+		for (int32_t i = 0; i < n; ++i) {
+			bool expected = distance[i] >= 10 && distance[i] <= 4000;
+			double angle = yawAngle[i] * 0.01 * 3.14159265358979323846 / 180.0;
+			double d = expected ? distance[i] * 0.01 : 0.0;
+			double error = fabs(x[i] - d * cos(angle)) + fabs(y[i] - d * sin(angle));
+
+			if (valid[i] != expected) {
+				printf("Polar validity mismatch: sample %d distance %d\n", i, distance[i]);
+				return false;
+			}
+
+			if (error > maxError) {
+				maxError = error;
+			}
+		}
+	}
+
+	free(valid);
+	free(points);
+	free(yawAngle);
+	free(distance);
+
+	printf("Polar: %s matches scalar, max error %.2f mm\n", lwPolarImplementationName(), maxError * 1000.0);
+
+	return maxError < 0.001;
+}
+
+void benchmarkPolar() {
+	const int32_t count = 5000;
+	const int32_t iterations = 4000;
+	uint16_t* distance = (uint16_t*)malloc(count * sizeof(uint16_t));
+	int16_t* yawAngle = (int16_t*)malloc(count * sizeof(int16_t));
+	float* x = (float*)malloc(count * sizeof(float));
+	float* y = (float*)malloc(count * sizeof(float));
+	uint8_t* valid = (uint8_t*)malloc(count);
+
+	createPolarSamples(distance, yawAngle, count);
+
+	printf("Polar to cartesian: %d samples\n", count);
+
+	int64_t startTime = platformGetMicrosecond();
+
+	for (int32_t n = 0; n < iterations; ++n) {
+		for (int32_t i = 0; i < count; ++i) {
+			float angle = yawAngle[i] * (0.01f * 3.14159265f / 180.0f);
+			float d = (distance[i] != 0) ? distance[i] * 0.01f : 0.0f;
+			x[i] = d * cosf(angle);
+			y[i] = d * sinf(angle);
+			valid[i] = distance[i] != 0;
+		}
+	}
+
+	double elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+	printf("  sinf/cosf:   %10.0f samples/s\n", (double)count * iterations / elapsed);
+	addResult("polar.sincos", (double)count * iterations / elapsed, "samples/s");
+
+	startTime = platformGetMicrosecond();
+
+	for (int32_t n = 0; n < iterations; ++n) {
+		lwPolarToCartesianScalar(distance, yawAngle, count, 1, 0xFFFF, x, y, valid);
+	}
+
+	elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+	printf("  table scalar: %10.0f samples/s\n", (double)count * iterations / elapsed);
+	addResult("polar.scalar", (double)count * iterations / elapsed, "samples/s");
+
+	startTime = platformGetMicrosecond();
+
+	for (int32_t n = 0; n < iterations; ++n) {
+		lwPolarToCartesian(distance, yawAngle, count, 1, 0xFFFF, x, y, valid);
+	}
+
+	elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+	printf("  table %s:   %10.0f samples/s\n", lwPolarImplementationName(), (double)count * iterations / elapsed);
+	addResult("polar.simd", (double)count * iterations / elapsed, "samples/s");
+
+	free(valid);
+	free(y);
+	free(x);
+	free(yawAngle);
+	free(distance);
+}
+
+// Checks range images against binning every sample by a search over all bins, for odd and even bin widths. Distances are
+// drawn from a small range so bins get ties, which must keep the first return, and some angles fall outside the image.
+bool verifyRangeImage() {
+	const int32_t binWidths[] = { 25, 50, 33, 100 };
+	lwSweepFrame* frame = new lwSweepFrame();
+	lwRangeImage* image = new lwRangeImage();
+	bool result = true;
+
+	frame->sampleCount = 3000;
+
+	for (int32_t w = 0; w < 4 && result; ++w) {
+		int32_t binWidth = binWidths[w];
+
+		if (!lwRangeImageInit(image, -4500, 4500, binWidth)) {
+			printf("Range image init failed: bin width %d\n", binWidth);
+			result = false;
+			break;
+		}
+
+		// Two passes so the second has to clear the bins the first filled.
+		for (int32_t pass = 0; pass < 2 && result; ++pass) {
+			for (int32_t i = 0; i < frame->sampleCount; ++i) {
+				frame->distance[i] = (rand() % 6 == 0) ? 0 : (uint16_t)(100 + rand() % 20);
+				frame->strength[i] = (uint16_t)(rand() % 101);
+				frame->yawAngle[i] = (int16_t)(rand() % 11000 - 5500);
+			}
+
+			// Fewer samples on the second pass leaves bins empty that the first pass filled.
+			if (pass == 1) {
+				frame->sampleCount = 200;
+			}
+
+			int32_t validCount = lwRangeImageFromSweep(image, frame);
+			int32_t refValidCount = 0;
+
+			for (int32_t bin = 0; bin < image->binCount; ++bin) {
+				int32_t low = -4500 + bin * binWidth - binWidth / 2;
+				uint16_t distance = 0;
+				uint16_t strength = 0;
+
+				for (int32_t i = 0; i < frame->sampleCount; ++i) {
+					if (frame->distance[i] != 0 && frame->yawAngle[i] >= low && frame->yawAngle[i] < low + binWidth && (distance == 0 || frame->distance[i] < distance)) {
+						distance = frame->distance[i];
+						strength = frame->strength[i];
+					}
+				}
+
+				refValidCount += distance != 0;
+
+				if (image->valid[bin] != (distance != 0) || image->distance[bin] != distance || image->strength[bin] != strength) {
+					printf("Range image mismatch: bin width %d bin %d got %d/%d/%d expected %d/%d\n", binWidth, bin, image->valid[bin], image->distance[bin], image->strength[bin], distance, strength);
+					result = false;
+					break;
+				}
+			}
+
+			if (result && validCount != refValidCount) {
+				printf("Range image valid count mismatch: bin width %d got %d expected %d\n", binWidth, validCount, refValidCount);
+				result = false;
+			}
+
+			frame->sampleCount = 3000;
+		}
+	}
+
+	// A full circle at 0.25 degrees fits, finer does not.
+	if (result && (!lwRangeImageInit(image, -18000, 18000, 25) || lwRangeImageInit(image, -18000, 18000, 24))) {
+		printf("Range image bin limit mismatch\n");
+		result = false;
+	}
+
+	delete image;
+	delete frame;
+
+	if (result) {
+		printf("Range image: matches brute force binning\n");
+	}
+
+	return result;
+}
+
+// Yaw angle of sample Index of a synthetic scan: a triangle between -45 and 45 degrees with up to 0.2 degrees of jitter,
+// which is less than the default hysteresis.
+int16_t getSweepYaw(int64_t Index) {
+	int32_t position = (int32_t)((Index * 37) % 18000);
+	int32_t yaw = (position < 9000) ? position - 4500 : 13500 - position;
+
+	return (int16_t)(yaw + (int32_t)((Index * 2654435761u) >> 7) % 41 - 20);
+}
+
+// Adds sample Index of the synthetic scan. The index is stored in the distance and strength, and is the arrival time, so
+// every sample of a sweep can be traced back to where it was added.
+void addSweepSample(lwSweepAssembler* Sweep, int64_t Index) {
+	lwSweepAddSample(Sweep, (uint16_t)(Index & 0xFFFF), (uint16_t)(Index >> 16), getSweepYaw(Index), Index);
+}
+
+// Checks a sweep of the synthetic scan holds consecutive samples as added, ends at the sample furthest along its direction,
+// and never moves back by more than the hysteresis. Previous is the last sample index of the sweep before it, or -1.
+bool checkSweep(const lwSweepFrame* Frame, int32_t Hysteresis, int64_t Previous) {
+	int64_t first = Frame->distance[0] | ((int64_t)Frame->strength[0] << 16);
+	int32_t last = Frame->sampleCount - 1;
+
+	if (Frame->sampleCount < 2 || Frame->startTimeUs != first || Frame->endTimeUs != first + last || (Previous != -1 && first != Previous)) {
+		return false;
+	}
+
+	int32_t extreme = Frame->yawAngle[0];
+
+	for (int32_t i = 0; i <= last; ++i) {
+		int64_t index = Frame->distance[i] | ((int64_t)Frame->strength[i] << 16);
+		int32_t yaw = Frame->yawAngle[i];
+
+		if (index != first + i || yaw != getSweepYaw(index)) {
+			return false;
+		}
+
+		if (Frame->direction != 0) {
+			if ((yaw - extreme) * Frame->direction > 0) {
+				extreme = yaw;
+			} else if ((extreme - yaw) * Frame->direction > Hysteresis) {
+				return false;
+			}
+		}
+	}
+
+	return Frame->direction == 0 || extreme == Frame->yawAngle[last];
+}
+
+// Takes sweeps while another thread adds the synthetic scan, and checks every sweep taken is whole and is not changed
+// while it is held. The sweeps taken and the ones replaced before they were taken must add up to the sweeps published.
+bool verifySweepThreaded() {
+	const int64_t sampleCount = 4000000;
+	lwSweepAssembler* sweep = new lwSweepAssembler();
+	std::atomic<bool> done(false);
+	bool result = true;
+	uint32_t taken = 0;
+	int64_t lastSequence = -1;
+
+	std::thread producer([&]() {
+		for (int64_t i = 0; i < sampleCount; ++i) {
+			addSweepSample(sweep, i);
+
+			// Lets the consumer in often on a single core too.
+			if (i % 100 == 0) {
+				std::this_thread::yield();
+			}
+		}
+
+		done.store(true, std::memory_order_release);
+	});
+
+	while (result) {
+		bool finished = done.load(std::memory_order_acquire);
+		lwSweepFrame* frame = lwSweepAcquire(sweep);
+
+		if (frame != NULL) {
+			result = frame->sequence > lastSequence && (frame->partial || checkSweep(frame, sweep->hysteresis, -1));
+
+			// Hold the frame for a while as the producer carries on, long enough for it to replace some sweeps, then check
+			// it again.
+			for (uint32_t n = 0; n < frame->sequence % 8; ++n) {
+				std::this_thread::yield();
+			}
+
+			result = result && (frame->partial || checkSweep(frame, sweep->hysteresis, -1));
+			lastSequence = frame->sequence;
+			++taken;
+		} else if (finished) {
+			break;
+		} else {
+			std::this_thread::yield();
+		}
+	}
+
+	producer.join();
+
+	if (!result) {
+		printf("Sweep %lld changed or incomplete while held\n", (long long)lastSequence);
+	} else if (taken + sweep->droppedCount != sweep->sequence) {
+		printf("Sweeps taken %u and dropped %u, published %u\n", taken, sweep->droppedCount, sweep->sequence);
+		result = false;
+	} else {
+		printf("Sweep: %u sweeps published, %u taken by another thread, all whole\n", sweep->sequence, taken);
+	}
+
+	delete sweep;
+
+	return result;
+}
+
+// Checks the sweeps of a scan that reverses, and that moving back by less than the hysteresis does not end a sweep.
+bool verifySweep() {
+	lwSweepAssembler* sweep = new lwSweepAssembler();
+	bool result = true;
+	int64_t previous = -1;
+	uint32_t sweepCount = 0;
+
+	// Every sweep is taken as soon as it is published, so each starts at the sample that ended the one before.
+	for (int64_t i = 0; i < 200000 && result; ++i) {
+		addSweepSample(sweep, i);
+		lwSweepFrame* frame = lwSweepAcquire(sweep);
+
+		if (frame == NULL) {
+			continue;
+		}
+
+		int64_t first = frame->distance[0] | ((int64_t)frame->strength[0] << 16);
+
+		if (frame->sequence != sweepCount || frame->partial != (sweepCount == 0) || (sweepCount > 0 && !checkSweep(frame, sweep->hysteresis, previous))) {
+			printf("Sweep %u wrong: %d samples from %lld\n", frame->sequence, frame->sampleCount, (long long)first);
+			result = false;
+		}
+
+		previous = first + frame->sampleCount - 1;
+		++sweepCount;
+	}
+
+	// The scan reverses every 9000 / 37 samples.
+	if (result && (sweepCount < 200000 * 37 / 9000 - 1 || sweepCount > 200000 * 37 / 9000 + 1 || sweep->droppedCount != 0)) {
+		printf("Sweep count %u\n", sweepCount);
+		result = false;
+	}
+
+	delete sweep;
+
+	// A dip of 0.4 degrees, less than the hysteresis of 0.5, on the way from 0 to 20 degrees then back to 0.
+	sweep = new lwSweepAssembler();
+	int32_t yaw = 0;
+	int64_t time = 0;
+
+	for (; yaw < 1000; yaw += 10) { lwSweepAddSample(sweep, 1, 1, (int16_t)yaw, time++); }
+	for (; yaw > 960; yaw -= 10) { lwSweepAddSample(sweep, 1, 1, (int16_t)yaw, time++); }
+	for (; yaw < 2000; yaw += 10) { lwSweepAddSample(sweep, 1, 1, (int16_t)yaw, time++); }
+	for (; yaw >= 0; yaw -= 10) { lwSweepAddSample(sweep, 1, 1, (int16_t)yaw, time++); }
+
+	lwSweepFrame* frame = lwSweepAcquire(sweep);
+
+	if (result && (frame == NULL || frame->sequence != 0 || frame->direction != 1 || frame->yawAngle[frame->sampleCount - 1] != 2000 || sweep->sequence != 1)) {
+		printf("Sweep with a dip below the hysteresis was split\n");
+		result = false;
+	}
+
+	delete sweep;
+
+	return result && verifySweepThreaded();
+}
+
+// Counts the packets it is called with in the int64_t at User.
+void countPacket(lwSerialPort* Serial, lwPacketView* Packet, void* User) {
+	++*(int64_t*)User;
+}
+
+// Checks a truncated capture opens with only the entries of the reads that are complete in the data file, and the packets
+// those reads completed. Entries is the index of the whole capture.
+bool verifyTruncatedCapture(const char* Path, const lwCaptureIndexEntry* Entries, uint64_t EntryCount, uint64_t DataSize, uint64_t IndexSize) {
+	char indexPath[1024];
+	snprintf(indexPath, sizeof(indexPath), "%s.idx", Path);
+
+	if (truncate(Path, sizeof(lwCaptureHeader) + DataSize) != 0 || truncate(indexPath, sizeof(lwCaptureHeader) + IndexSize) != 0) {
+		printf("Could not truncate %s\n", Path);
+		return false;
+	}
+
+	lwCaptureReader reader;
+
+	if (!lwCaptureReaderOpen(&reader, Path)) {
+		return false;
+	}
+
+	// The last complete read within the index, then the packets it completed.
+	uint64_t expectedCount = IndexSize / sizeof(lwCaptureIndexEntry);
+
+	while (expectedCount > 0 && (Entries[expectedCount - 1].type != LW_CAPTURE_ENTRY_READ || Entries[expectedCount - 1].offset + Entries[expectedCount - 1].size > DataSize)) {
+		--expectedCount;
+	}
+
+	while (expectedCount < IndexSize / sizeof(lwCaptureIndexEntry) && Entries[expectedCount].type == LW_CAPTURE_ENTRY_PACKET) {
+		++expectedCount;
+	}
+
+	bool result = reader.streamSize == DataSize && reader.entryCount == expectedCount && memcmp(reader.entries, Entries, expectedCount * sizeof(lwCaptureIndexEntry)) == 0;
+
+	for (uint64_t i = 0; i < reader.entryCount; ++i) {
+		result = result && reader.entries[i].offset + reader.entries[i].size <= reader.streamSize;
+	}
+
+	if (!result) {
+		printf("Capture cut to %llu data and %llu index bytes: %llu entries, expected %llu\n", (unsigned long long)DataSize, (unsigned long long)IndexSize,
+			(unsigned long long)reader.entryCount, (unsigned long long)expectedCount);
+	}
+
+	lwCaptureReaderClose(&reader);
+
+	return result;
+}
+
+// Records a noisy stream in reads of random sizes, some larger than the receive buffer and some at the same time, and checks
+// the capture reads back with the same bytes, an entry for every read, and an entry for exactly the packets lwnxParseBuffer
+// finds in the whole stream. Then checks lwCaptureFindTime against a linear search, and opening the capture cut short.
+bool verifyCapture() {
+	const int32_t bufferSize = 2 * 1024 * 1024;
+	uint8_t* stream = (uint8_t*)malloc(bufferSize);
+	lwPacketSpan* spans = (lwPacketSpan*)malloc(bufferSize / 6 * sizeof(lwPacketSpan));
+	int32_t packetCount = 0;
+	int32_t streamSize = createNoisyDistanceStream(stream, bufferSize, &packetCount);
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/lwnxVerify%d.lwcap", (int)getpid());
+
+	// Every packet in the stream, found in one pass.
+	lwPacketParser parser;
+	int32_t spanCount = 0;
+	int32_t offset = 0;
+
+	while (offset < streamSize) {
+		int32_t consumed = 0;
+		int32_t count = lwnxParseBuffer(&parser, stream + offset, streamSize - offset, spans + spanCount, bufferSize / 6 - spanCount, &consumed);
+
+		for (int32_t i = 0; i < count; ++i) {
+			spans[spanCount + i].offset += offset;
+		}
+
+		spanCount += count;
+		offset += consumed;
+
+		if (consumed == 0) {
+			break;
+		}
+	}
+
+	lwCaptureWriter writer;
+
+	if (!lwCaptureOpen(&writer, path)) {
+		free(spans);
+		free(stream);
+		return false;
+	}
+
+	int64_t time = 1000;
+	int32_t readCount = 0;
+
+	for (offset = 0; offset < streamSize; ++readCount) {
+		int32_t size = (rand() % 16 == 0) ? 1 + rand() % (LW_RECV_BUFFER_SIZE * 3) : 1 + rand() % 300;
+
+		if (size > streamSize - offset) {
+			size = streamSize - offset;
+		}
+
+		lwCaptureWrite(&writer, stream + offset, size, time);
+		offset += size;
+		time += rand() % 3 * 100;
+	}
+
+	lwCaptureClose(&writer);
+
+	lwCaptureReader reader;
+	bool result = lwCaptureReaderOpen(&reader, path);
+	uint64_t span = 0;
+	uint64_t readEnd = 0;
+	int64_t readTime = 0;
+	int32_t reads = 0;
+
+	result = result && reader.streamSize == (uint64_t)streamSize && memcmp(reader.stream, stream, streamSize) == 0;
+
+	for (uint64_t i = 0; result && i < reader.entryCount; ++i) {
+		lwCaptureIndexEntry* entry = &reader.entries[i];
+
+		if (entry->type == LW_CAPTURE_ENTRY_READ) {
+			result = entry->offset == readEnd && entry->timeUs >= readTime;
+			readEnd = entry->offset + entry->size;
+			readTime = entry->timeUs;
+			++reads;
+		} else {
+			// NOTE: A packet can be listed a few reads after the one holding its last byte, when a false header before it needed
+			// more bytes to be rejected.
+			result = span < (uint64_t)spanCount && entry->offset == (uint64_t)spans[span].offset && entry->size == (uint32_t)spans[span].size &&
+				entry->commandId == stream[spans[span].offset + 3] && entry->offset + entry->size <= readEnd && entry->timeUs == readTime;
+			++span;
+		}
+	}
+
+	if (!result || span != (uint64_t)spanCount || reads != readCount || spanCount < packetCount) {
+		printf("Capture round trip mismatch: %llu of %d packets, %d of %d reads\n", (unsigned long long)span, spanCount, reads, readCount);
+		result = false;
+	}
+
+	// Times before, between, on and after the entries, many of which share a time.
+	for (int64_t t = 900; result && t <= time + 100; t += 50) {
+		uint64_t expected = 0;
+
+		while (expected < reader.entryCount && reader.entries[expected].timeUs < t) {
+			++expected;
+		}
+
+		if (lwCaptureFindTime(&reader, t) != expected) {
+			printf("Capture find time %lld: %llu, expected %llu\n", (long long)t, (unsigned long long)lwCaptureFindTime(&reader, t), (unsigned long long)expected);
+			result = false;
+		}
+	}
+
+	uint64_t entryCount = reader.entryCount;
+	lwCaptureIndexEntry* entries = (lwCaptureIndexEntry*)malloc(entryCount * sizeof(lwCaptureIndexEntry));
+	memcpy(entries, reader.entries, entryCount * sizeof(lwCaptureIndexEntry));
+	lwCaptureReaderClose(&reader);
+
+	// Cut inside a read, with the index longer than the data and ending partway through an entry, then with the index
+	// shorter than the data.
+	result = result && verifyTruncatedCapture(path, entries, entryCount, streamSize / 2 + 7, entryCount * sizeof(lwCaptureIndexEntry) - 5);
+	result = result && verifyTruncatedCapture(path, entries, entryCount, streamSize / 2, entryCount / 4 * sizeof(lwCaptureIndexEntry));
+	result = result && verifyTruncatedCapture(path, entries, entryCount, 0, 0);
+
+	char indexPath[1024];
+	snprintf(indexPath, sizeof(indexPath), "%s.idx", path);
+	remove(path);
+	remove(indexPath);
+	free(entries);
+	free(spans);
+	free(stream);
+
+	if (result) {
+		printf("Capture: %d packets in %d reads read back and found by time\n", spanCount, readCount);
+	}
+
+	return result;
+}
+
+// Parses a recorded capture with lwnxParseBuffer, then replays it through lwnxPoll as fast as possible.
+void benchmarkCapture(const char* Path) {
+	lwCaptureReader reader;
+
+	if (!lwCaptureReaderOpen(&reader, Path)) {
+		return;
+	}
+
+	int32_t streamSize = (int32_t)reader.streamSize;
+	int32_t packetCount = runBufferParser(reader.stream, streamSize, 4096);
+
+	if (packetCount > 0) {
+		int32_t iterations = 1 + (64 * 1024 * 1024) / (streamSize + 1);
+		benchmarkParserStream("capture", reader.stream, streamSize, packetCount, iterations, false);
+	}
+
+	lwCaptureReaderClose(&reader);
+
+	// NOTE: Every packet is dispatched, the handler only counts them.
+	lwSerialPortReplay replay(Path, 0);
+	int64_t handled = 0;
+
+	if (!replay.connect(Path, 0)) {
+		return;
+	}
+
+	for (int32_t i = 0; i < 256; ++i) {
+		lwnxSetPacketHandler(&replay, i, countPacket, &handled);
+	}
+
+	int64_t startTime = platformGetMicrosecond();
+
+	// NOTE: The read that finishes the replay is parsed in the same call.
+	while (!replay.finished) {
+		if (lwnxPoll(&replay, 0) == -1) {
+			break;
+		}
+	}
+
+	double elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+	printf("  replayed lwnxPoll: %10.0f packets/s  (%lld handled)\n", handled / elapsed, (long long)handled);
+	addResult("parser.capture.replay", handled / elapsed, "packets/s");
+
+	replay.disconnect();
+}
+
+// Opens a pseudo terminal in raw mode, for a client to connect to SlaveName while the benchmark writes to the master side.
+int openLoopback(char* SlaveName, int32_t SlaveNameSize) {
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 || ptsname_r(master, SlaveName, SlaveNameSize) != 0) {
+		printf("Couldn't create pseudo terminal!\n");
+		return -1;
+	}
+
+	struct termios tty;
+	tcgetattr(master, &tty);
+	cfmakeraw(&tty);
+	tcsetattr(master, TCSANOW, &tty);
+
+	return master;
+}
+
+// Times Count managed reads of the firmware version, one after the other, and adds their percentiles as Name.
+bool measureRoundTrip(lwSerialPort* Serial, const char* Name, int32_t Count) {
+	int64_t* times = (int64_t*)malloc(Count * sizeof(int64_t));
+	int32_t measured = 0;
+
+	for (int32_t i = 0; i < Count; ++i) {
+		uint32_t version;
+		int64_t startTime = platformGetMicrosecond();
+
+		if (!lwnxCmdReadUInt32(Serial, 2, &version)) {
+			break;
+		}
+
+		times[measured++] = platformGetMicrosecond() - startTime;
+	}
+
+	addPercentiles(Name, times, measured, "us");
+	free(times);
+
+	return measured == Count;
+}
+
+// Managed command round trips to the emulated SF45, on an idle link and while it streams at 5000 Hz over a 921600 bit/s link.
+void benchmarkRoundTrip() {
+	// NOTE: Holds about 100 KB of buffers, so it is not on the stack.
+	static lwEmulator emulator;
+	volatile bool running = true;
+
+	if (!lwEmulatorOpen(&emulator, lwEmulatorGetDevice(LW_EMULATOR_SF45), 0)) {
+		return;
+	}
+
+	std::thread emulatorThread(lwEmulatorRun, &emulator, &running);
+	lwSerialPortLinux serial;
+	int64_t streamed = 0;
+
+	printf("Round trip: emulated %s on %s\n", emulator.device->model, emulator.slaveName);
+
+	if (serial.connect(emulator.slaveName, 921600)) {
+		lwnxSetPacketHandler(&serial, 44, countPacket, &streamed);
+
+		if (measureRoundTrip(&serial, "roundtrip.idle", 2000) && lwnxCmdWriteUInt8(&serial, 66, 12) && lwnxCmdWriteUInt32(&serial, 30, 5)) {
+			measureRoundTrip(&serial, "roundtrip.streaming", 2000);
+			lwnxCmdWriteUInt32(&serial, 30, 0);
+			printf("  %lld packets streamed while measuring\n", (long long)streamed);
+		}
+
+		serial.disconnect();
+	}
+
+	running = false;
+	emulatorThread.join();
+	lwEmulatorClose(&emulator);
+}
+
+class streamWriter {
+	public:
+		int descriptor;
+		int32_t count;
+		int32_t rate;
+};
+
+// Writes Count distance packets at Rate, each carrying the time it was written.
+void writeTimedStream(streamWriter* Writer) {
+	uint8_t packet[32];
+	int64_t startTime = platformGetMicrosecond();
+
+	for (int32_t i = 0; i < Writer->count; ++i) {
+		int64_t dueTime = startTime + (int64_t)i * 1000000 / Writer->rate;
+		int64_t waitTime = dueTime - platformGetMicrosecond();
+
+		if (waitTime > 0) {
+			platformSleepMicrosecond(waitTime);
+		}
+
+		int64_t writeTime = platformGetMicrosecond();
+		int32_t size = writePacket(packet, 44, (uint8_t*)&writeTime, sizeof(writeTime));
+
+		if (write(Writer->descriptor, packet, size) != size) {
+			break;
+		}
+	}
+}
+
+class streamLatency {
+	public:
+		int64_t* writeToHandler;
+		int64_t* readToHandler;
+		int32_t count;
+};
+
+void handleTimedPacket(lwSerialPort* Serial, lwPacketView* Packet, void* User) {
+	streamLatency* latency = (streamLatency*)User;
+	int64_t handlerTime = platformGetMicrosecond();
+	int64_t writeTime;
+	memcpy(&writeTime, Packet->payload, sizeof(writeTime));
+
+	latency->writeToHandler[latency->count] = handlerTime - writeTime;
+	latency->readToHandler[latency->count] = handlerTime - Packet->lastByteTimeUs;
+	++latency->count;
+}
+
+// Measures the time from a packet being written to the pseudo terminal to its handler being called, and from the read that
+// completed it returning to the handler being called, at the 5000 Hz of an SF45.
+void benchmarkStreamLatency() {
+	const int32_t count = 20000;
+	char slaveName[64];
+	streamWriter writer;
+	writer.count = count;
+	writer.rate = 5000;
+	writer.descriptor = openLoopback(slaveName, sizeof(slaveName));
+
+	if (writer.descriptor < 0) {
+		return;
+	}
+
+	lwSerialPortLinux serial;
+	streamLatency latency;
+	latency.writeToHandler = (int64_t*)malloc(count * sizeof(int64_t));
+	latency.readToHandler = (int64_t*)malloc(count * sizeof(int64_t));
+	latency.count = 0;
+
+	printf("Streaming latency: %d packets at %d Hz on %s\n", count, writer.rate, slaveName);
+
+	if (serial.connect(slaveName, 921600)) {
+		lwnxSetPacketHandler(&serial, 44, handleTimedPacket, &latency);
+
+		std::thread writerThread(writeTimedStream, &writer);
+
+		while (latency.count < count) {
+			if (lwnxPoll(&serial, 200) <= 0) {
+				break;
+			}
+		}
+
+		writerThread.join();
+		serial.disconnect();
+
+		if (latency.count < count) {
+			printf("  NOTE: %d packets were not received\n", count - latency.count);
+		}
+
+		addPercentiles("stream.write_to_handler", latency.writeToHandler, latency.count, "us");
+		addPercentiles("stream.read_to_handler", latency.readToHandler, latency.count, "us");
+	}
+
+	close(writer.descriptor);
+	free(latency.readToHandler);
+	free(latency.writeToHandler);
+}
+
+class reactorCommand {
+	public:
+		lwCommand command;
+		uint32_t version;
+		int64_t completeCount;
+};
+
+void countCommand(lwSerialPort* Serial, lwCommand* Command, void* User) {
+	if (Command->complete) {
+		++((reactorCommand*)User)->completeCount;
+	}
+}
+
+// One thread serving REACTOR_PORTS emulated SF45s streaming at 5000 Hz, each also reading its firmware version 100 times a
+// second. Measures the CPU time of the reactor thread, which excludes the emulator threads, with and without batching.
+void benchmarkReactor() {
+	lwEmulator* emulators = new lwEmulator[REACTOR_PORTS];
+	lwSerialPortLinux* serials = new lwSerialPortLinux[REACTOR_PORTS];
+	reactorCommand* commands = new reactorCommand[REACTOR_PORTS];
+	std::thread* threads[REACTOR_PORTS];
+	volatile bool running = true;
+	int64_t streamed = 0;
+	int32_t portCount = 0;
+
+	printf("Reactor: %d emulated SF45s streaming at 5000 Hz\n", REACTOR_PORTS);
+
+	for (; portCount < REACTOR_PORTS; ++portCount) {
+		lwEmulator* emulator = &emulators[portCount];
+		lwSerialPortLinux* serial = &serials[portCount];
+
+		if (!lwEmulatorOpen(emulator, lwEmulatorGetDevice(LW_EMULATOR_SF45), 0)) {
+			break;
+		}
+
+		threads[portCount] = new std::thread(lwEmulatorRun, emulator, &running);
+
+		if (!serial->connect(emulator->slaveName, 921600) || !lwnxCmdWriteUInt8(serial, 66, 12) || !lwnxCmdWriteUInt32(serial, 30, 5)) {
+			++portCount;
+			break;
+		}
+
+		lwnxSetPacketHandler(serial, 44, countPacket, &streamed);
+	}
+
+	lwReactor reactor;
+
+	if (portCount == REACTOR_PORTS && lwReactorInit(&reactor)) {
+		for (int32_t i = 0; i < REACTOR_PORTS; ++i) {
+			lwReactorAddPort(&reactor, &serials[i]);
+		}
+
+		const int64_t batches[] = { 0, 1000 };
+
+		for (int32_t b = 0; b < 2; ++b) {
+			reactor.batchUs = batches[b];
+			reactor.wakeCount = 0;
+			streamed = 0;
+
+			for (int32_t i = 0; i < REACTOR_PORTS; ++i) {
+				commands[i].completeCount = 0;
+			}
+
+			timespec cpuStart;
+			timespec cpuEnd;
+			clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+			int64_t startTime = platformGetMicrosecond();
+			int64_t commandTime = startTime;
+
+			while (platformGetMicrosecond() - startTime < 2000000) {
+				if (platformGetMicrosecond() >= commandTime) {
+					commandTime += 10000;
+
+					for (int32_t i = 0; i < REACTOR_PORTS; ++i) {
+						if (commands[i].command.attempts == 0 || lwnxCommandDone(&commands[i].command)) {
+							lwnxCmdReadUInt32Async(&serials[i], &commands[i].command, 2, &commands[i].version, countCommand, &commands[i]);
+						}
+					}
+				}
+
+				int64_t waitTime = commandTime - platformGetMicrosecond();
+
+				if (lwReactorRun(&reactor, (waitTime > 0) ? (uint32_t)(waitTime / 1000 + 1) : 0) == -1) {
+					break;
+				}
+			}
+
+			double elapsed = (platformGetMicrosecond() - startTime) / 1000000.0;
+			clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+			double cpu = (cpuEnd.tv_sec - cpuStart.tv_sec) + (cpuEnd.tv_nsec - cpuStart.tv_nsec) / 1000000000.0;
+			int64_t completed = 0;
+
+			for (int32_t i = 0; i < REACTOR_PORTS; ++i) {
+				completed += commands[i].completeCount;
+			}
+
+			char name[64];
+			printf("  batch %4lld us: %8.0f packets/s  %6.0f commands/s  %6.0f wakes/s  %5.1f%% of a core\n", (long long)batches[b],
+				streamed / elapsed, completed / elapsed, reactor.wakeCount / elapsed, cpu * 100.0 / elapsed);
+			snprintf(name, sizeof(name), "reactor.batch%lld.packets", (long long)batches[b]);
+			addResult(name, streamed / elapsed, "packets/s");
+			snprintf(name, sizeof(name), "reactor.batch%lld.cpu", (long long)batches[b]);
+			addResult(name, cpu * 100.0 / elapsed, "%");
+		}
+
+		for (int32_t i = 0; i < REACTOR_PORTS; ++i) {
+			lwnxCancelCommand(&serials[i], &commands[i].command);
+			lwReactorRemovePort(&reactor, &serials[i]);
+		}
+
+		lwReactorClose(&reactor);
+	} else {
+		printf("  NOTE: only %d of the emulators started\n", portCount);
+	}
+
+	running = false;
+
+	for (int32_t i = 0; i < portCount; ++i) {
+		serials[i].disconnect();
+		threads[i]->join();
+		delete threads[i];
+		lwEmulatorClose(&emulators[i]);
+	}
+
+	delete[] commands;
+	delete[] serials;
+	delete[] emulators;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Application Entry.
+//----------------------------------------------------------------------------------------------------------------------------------
+int main(int args, char **argv) {
+	platformInit();
+
+	const char* capturePath = 0;
+	const char* outputPath = 0;
+
+	for (int i = 1; i < args; ++i) {
+		if (i + 1 < args && strcmp(argv[i], "-c") == 0) {
+			capturePath = argv[++i];
+		} else if (i + 1 < args && strcmp(argv[i], "-o") == 0) {
+			outputPath = argv[++i];
+		} else {
+			printf("Usage: benchmark [-c capture] [-o results.csv]\n");
+			return 1;
+		}
+	}
+
+	printf("LWNX benchmark\n");
+
+	if (!verifyCrc() || !verifyDistanceBatch() || !verifyPolar() || !verifyRangeImage() || !verifySweep() || !verifyCapture()) {
+		return 1;
+	}
+
+	benchmarkCrc();
+	benchmarkParser();
+
+	if (capturePath != 0) {
+		benchmarkCapture(capturePath);
+	}
+
+	benchmarkDistanceBatch();
+	benchmarkPolar();
+	benchmarkRoundTrip();
+	benchmarkStreamLatency();
+	benchmarkReactor();
+
+	printf("\n");
+	writeResults(stdout);
+
+	if (outputPath != 0) {
+		FILE* file = fopen(outputPath, "w");
+
+		if (file == 0) {
+			printf("Could not create %s\n", outputPath);
+			return 1;
+		}
+
+		writeResults(file);
+		fclose(file);
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// LightWare LWNX Device Emulator.
+// Emulates a device on a pseudo terminal, so the samples can be run without hardware. See lwEmulator.h.
+//----------------------------------------------------------------------------------------------------------------------------------
+#include "lwEmulator.h"
+
+#include <signal.h>
+
+static volatile bool _running = true;
+
+static void _stop(int Signal) {
+	_running = false;
+}
+
+void printHexDebug(uint8_t* Data, uint32_t Size) {
+	printf("Buffer: ");
+
+	for (int i = 0; i < Size; ++i) {
+		printf("0x%02X ", Data[i]);
+	}
+
+	printf("\n");
+}
+
+void printUsage() {
+	printf("Usage: emulator [-d device] [-r rate] [-b bitrate] [-l link]\n");
+	printf("  -d  Device to emulate: ");
+
+	for (int32_t i = 0; i < LW_EMULATOR_DEVICE_COUNT; ++i) {
+		printf("%s%s", lwEmulatorGetDevice(i)->name, i + 1 < LW_EMULATOR_DEVICE_COUNT ? ", " : " (default sf45)\n");
+	}
+
+	printf("  -r  Rate of the stream in Hz, readings or waveforms per second. Default is the rate set by the commands.\n");
+	printf("  -b  Bit rate of the emulated serial link, 0 for no limit. Default 921600.\n");
+	printf("  -l  Path of a symbolic link to create to the pseudo terminal, like /tmp/ttyLW0.\n");
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Application Entry.
+//----------------------------------------------------------------------------------------------------------------------------------
+int main(int args, char **argv)
+{
+	platformInit();
+
+	const lwEmulatorDevice* device = lwEmulatorGetDevice(LW_EMULATOR_SF45);
+	const char* linkPath = 0;
+	// NOTE: Holds about 100 KB of buffers, so it is not on the stack.
+	static lwEmulator emulator;
+
+	for (int i = 1; i < args; ++i) {
+		const char* value = (i + 1 < args) ? argv[i + 1] : 0;
+
+		if (value == 0) {
+			printUsage();
+			return 1;
+		}
+
+		if (strcmp(argv[i], "-d") == 0) {
+			device = lwEmulatorFindDevice(value);
+
+			if (device == 0) {
+				printf("Unknown device %s\n", value);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-r") == 0) {
+			emulator.rate = atof(value);
+		} else if (strcmp(argv[i], "-b") == 0) {
+			emulator.bitRate = atoi(value);
+		} else if (strcmp(argv[i], "-l") == 0) {
+			linkPath = value;
+		} else {
+			printUsage();
+			return 1;
+		}
+
+		++i;
+	}
+
+	if (!lwEmulatorOpen(&emulator, device, linkPath)) {
+		return 1;
+	}
+
+	printf("Emulating %s on %s%s%s\n", device->model, emulator.slaveName, linkPath ? " linked at " : "", linkPath ? linkPath : "");
+
+	signal(SIGINT, _stop);
+	signal(SIGTERM, _stop);
+
+	lwEmulatorRun(&emulator, &_running);
+
+	printf("Commands: %llu  Packets sent: %llu  Dropped: %llu  Bytes: %llu\n", (unsigned long long)emulator.commandCount,
+		(unsigned long long)emulator.packetCount, (unsigned long long)emulator.droppedCount, (unsigned long long)emulator.byteCount);
+
+	if (linkPath != 0) {
+		unlink(linkPath);
+	}
+
+	lwEmulatorClose(&emulator);
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,588 @@
+#include "lwEmulator.h"
+#include "../lwDistanceOutput.h"
+
+#include <math.h>
+
+// Bytes the link may send at once after being idle, about the FIFO of a USB serial adapter.
+#define LW_EMULATOR_LINK_BURST		256
+// A stream that falls further behind than this, like after the emulator was suspended, skips ahead instead of catching up.
+#define LW_EMULATOR_MAX_LAG_US		100000
+// Commands are ignored for this long after a reset, while the device restarts.
+#define LW_EMULATOR_RESET_TIME_US	500000
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Devices.
+//----------------------------------------------------------------------------------------------------------------------------------
+static const lwEmulatorDevice _devices[LW_EMULATOR_DEVICE_COUNT] = {
+	// Name		Model		Hardware	Firmware	Rate	Output	Fields	Full speed	Waveforms
+	{ "sf45",	"SF45",		1,			0x020003,	66,		27,		0x1FF,	0,			0 },
+	{ "sf30d",	"SF30/D",	1,			0x010102,	76,		29,		0x0FF,	20010,		0 },
+	{ "sf000",	"SF000",	1,			0x010001,	66,		27,		0x0FF,	0,			0 },
+	{ "sf11",	"SF11",		1,			0x010300,	0,		0,		0,		0,			10 },
+	{ "sf23",	"SF23",		2,			0x010004,	66,		27,		0x0FF,	0,			0 },
+};
+
+const lwEmulatorDevice* lwEmulatorFindDevice(const char* Name) {
+	for (int32_t i = 0; i < LW_EMULATOR_DEVICE_COUNT; ++i) {
+		if (strcmp(_devices[i].name, Name) == 0) {
+			return &_devices[i];
+		}
+	}
+
+	return 0;
+}
+
+const lwEmulatorDevice* lwEmulatorGetDevice(int32_t Index) {
+	return &_devices[Index];
+}
+
+// Rate of Command 44 for a value of the update rate command.
+// NOTE: The SF45/B rates are from its documentation. The other devices halve their rate for each step, through the rates
+// given in the comments of their samples: 78 Hz at 8 on the SF30/D and 97 Hz at 5 on the SF000.
+static double _getUpdateRate(const lwEmulatorDevice* Device, uint8_t Value) {
+	static const double sf45Rates[12] = { 50, 100, 200, 400, 500, 625, 1000, 1250, 1538, 2000, 2500, 5000 };
+
+	if (Device == &_devices[LW_EMULATOR_SF45]) {
+		return sf45Rates[(Value < 1 ? 1 : (Value > 12 ? 12 : Value)) - 1];
+	}
+
+	double baseRate = (Device == &_devices[LW_EMULATOR_SF30D]) ? 20010 : 3104;
+
+	return baseRate / (1 << (Value > 12 ? 12 : Value));
+}
+
+double lwEmulatorGetRate(lwEmulator* Emulator) {
+	const lwEmulatorDevice* device = Emulator->device;
+	double deviceRate = 0;
+
+	if (Emulator->streamMode == 5 && device->distanceOutputCommand != 0) {
+		deviceRate = _getUpdateRate(device, Emulator->updateRate);
+	} else if (Emulator->streamMode == 11 && device->fullSpeedRate != 0) {
+		deviceRate = device->fullSpeedRate;
+	} else if (Emulator->streamMode == 1 && device->waveformRate != 0) {
+		deviceRate = device->waveformRate;
+	}
+
+	if (deviceRate == 0 || Emulator->rate <= 0) {
+		return deviceRate;
+	}
+
+	return Emulator->rate;
+}
+
+// Restores the settings a device has after power up.
+static void _reset(lwEmulator* Emulator, int64_t TimeUs) {
+	Emulator->updateRate = (Emulator->device == &_devices[LW_EMULATOR_SF30D]) ? 8 : 5;
+	Emulator->distanceOutput = 0x105 & Emulator->device->fieldMask;
+	Emulator->streamMode = 0;
+	Emulator->returnMode = 0;
+	Emulator->token = (uint16_t)(Emulator->token * 31421 + 6927);
+	Emulator->firmwarePageCount = 0;
+	Emulator->firmwareFailed = false;
+	Emulator->streamStartUs = TimeUs;
+	Emulator->streamCount = 0;
+	Emulator->fullSpeedCount = 0;
+	Emulator->waveformCount = 0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Scene.
+//----------------------------------------------------------------------------------------------------------------------------------
+// Uniform in [0, 1).
+static double _random(lwEmulator* Emulator) {
+	uint32_t x = Emulator->randomState;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	Emulator->randomState = x;
+
+	return (x >> 8) / 16777216.0;
+}
+
+// About normal with a standard deviation of 1.
+static double _randomNormal(lwEmulator* Emulator) {
+	return (_random(Emulator) + _random(Emulator) + _random(Emulator) + _random(Emulator) - 2.0) * 1.732;
+}
+
+// Yaw angle of the SF45 in degrees, sweeping from 45 degrees on one side to the other once a second.
+static double _getYaw(double TimeS) {
+	return 45.0 * sin(TimeS * 2.0 * M_PI * 0.5);
+}
+
+// Distance in m seen by the SF45 at a yaw angle. The sensor is in a 6 by 6 m room, 1 m from the back wall and facing the
+// front wall, with a 0.5 m wide target moving across the room 3 m in front of it.
+static double _getRoomDistance(double TimeS, double YawDeg) {
+	double x = sin(YawDeg * M_PI / 180.0);
+	double y = cos(YawDeg * M_PI / 180.0);
+	double distance = 5.0 / y;
+
+	if (fabs(x) * distance > 3.0) {
+		distance = 3.0 / fabs(x);
+	}
+
+	double targetX = 2.0 * sin(TimeS * 2.0 * M_PI * 0.1) - x * 3.0 / y;
+
+	if (fabs(targetX) < 0.25) {
+		distance = 3.0 / y;
+	}
+
+	return distance;
+}
+
+// Distance in m seen by the single point devices, a target moving between 1 and 20 m and back every 20 s.
+static double _getPointDistance(double TimeS) {
+	return 10.5 - 9.5 * cos(TimeS * 2.0 * M_PI * 0.05);
+}
+
+static uint16_t _toCentimetres(lwEmulator* Emulator, double Distance) {
+	double value = Distance * 100.0 + _randomNormal(Emulator);
+
+	return (uint16_t)(value < 0 ? 0 : (value > 65535 ? 65535 : value));
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Sending.
+//----------------------------------------------------------------------------------------------------------------------------------
+// Queues a packet, or drops it if the send buffer is full.
+static void _sendPacket(lwEmulator* Emulator, uint8_t CommandId, uint8_t* Data, int32_t DataSize) {
+	if (Emulator->sendSize + 6 + DataSize > LW_EMULATOR_SEND_BUFFER_SIZE) {
+		++Emulator->droppedCount;
+		return;
+	}
+
+	uint8_t* buffer = Emulator->sendBuffer + Emulator->sendSize;
+	uint16_t flags = (1 + DataSize) << 6;
+
+	buffer[0] = PACKET_START_BYTE;
+	buffer[1] = flags & 0xFF;
+	buffer[2] = (flags >> 8) & 0xFF;
+	buffer[3] = CommandId;
+	memcpy(buffer + 4, Data, DataSize);
+	uint16_t crc = lwnxCreateCrc(buffer, 4 + DataSize);
+	buffer[4 + DataSize] = crc & 0xFF;
+	buffer[5 + DataSize] = (crc >> 8) & 0xFF;
+
+	Emulator->sendSize += 6 + DataSize;
+	++Emulator->packetCount;
+}
+
+// Writes as much of the send buffer to the PTY as the link allows. Returns when more can be sent, or 0 if all was sent.
+static int64_t _flush(lwEmulator* Emulator, int64_t TimeUs) {
+	double bytesPerUs = Emulator->bitRate / 10.0 / 1000000.0;
+	int32_t size = Emulator->sendSize;
+
+	if (Emulator->bitRate > 0) {
+		Emulator->linkCredit += (TimeUs - Emulator->linkTimeUs) * bytesPerUs;
+
+		if (Emulator->linkCredit > LW_EMULATOR_LINK_BURST) {
+			Emulator->linkCredit = LW_EMULATOR_LINK_BURST;
+		}
+
+		if (size > (int32_t)Emulator->linkCredit) {
+			size = (int32_t)Emulator->linkCredit;
+		}
+	}
+
+	Emulator->linkTimeUs = TimeUs;
+
+	if (size > 0) {
+		int32_t written = write(Emulator->masterDescriptor, Emulator->sendBuffer, size);
+
+		if (written > 0) {
+			Emulator->sendSize -= written;
+			Emulator->byteCount += written;
+			Emulator->linkCredit -= written;
+			memmove(Emulator->sendBuffer, Emulator->sendBuffer + written, Emulator->sendSize);
+		}
+	}
+
+	if (Emulator->sendSize == 0) {
+		return 0;
+	}
+
+	// NOTE: Without a bit rate the PTY is full, so try again shortly.
+	if (Emulator->bitRate <= 0) {
+		return TimeUs + 1000;
+	}
+
+	int32_t next = Emulator->sendSize < LW_EMULATOR_LINK_BURST ? Emulator->sendSize : LW_EMULATOR_LINK_BURST;
+
+	return TimeUs + 1 + (int64_t)((next - Emulator->linkCredit) / bytesPerUs);
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Commands.
+//----------------------------------------------------------------------------------------------------------------------------------
+static void _respondUInt32(lwEmulator* Emulator, uint8_t CommandId, uint32_t Value) {
+	_sendPacket(Emulator, CommandId, (uint8_t*)&Value, 4);
+}
+
+static void _respondString(lwEmulator* Emulator, uint8_t CommandId, const char* Value) {
+	char string[16] = {};
+	strncpy(string, Value, 16);
+	_sendPacket(Emulator, CommandId, (uint8_t*)string, 16);
+}
+
+// Copies a written value of up to Size bytes, missing bytes are 0.
+static uint32_t _readValue(uint8_t* Payload, int32_t PayloadSize, int32_t Size) {
+	uint32_t value = 0;
+	memcpy(&value, Payload, PayloadSize < Size ? PayloadSize : Size);
+
+	return value;
+}
+
+// Starts the stream over at the current rate, keeping the time of the scene.
+static void _restartStream(lwEmulator* Emulator, int64_t TimeUs) {
+	Emulator->streamStartUs = TimeUs;
+	Emulator->streamCount = 0;
+	Emulator->fullSpeedCount = 0;
+	Emulator->waveformCount = 0;
+}
+
+static void _handleFirmwarePage(lwEmulator* Emulator, uint8_t* Payload, int32_t PayloadSize) {
+	int32_t response = -1;
+
+	if (PayloadSize == 2 + LW_EMULATOR_FIRMWARE_PAGE_SIZE) {
+		int32_t pageIndex = Payload[0] | (Payload[1] << 8);
+
+		// NOTE: Sending a page again, like after a lost response, is accepted.
+		if (pageIndex == Emulator->firmwarePageCount || pageIndex == Emulator->firmwarePageCount - 1) {
+			Emulator->firmwarePageCount = pageIndex + 1;
+			response = pageIndex;
+		}
+	}
+
+	if (response == -1) {
+		Emulator->firmwareFailed = true;
+	}
+
+	_respondUInt32(Emulator, 16, (uint32_t)response);
+}
+
+static void _handleFirmwareCommit(lwEmulator* Emulator) {
+	bool valid = Emulator->firmwarePageCount > 0 && !Emulator->firmwareFailed;
+
+	Emulator->firmwareCommitted = Emulator->firmwareCommitted || valid;
+	Emulator->firmwarePageCount = 0;
+	Emulator->firmwareFailed = false;
+
+	_respondUInt32(Emulator, 17, valid ? 1 : 0);
+}
+
+static void _handleReset(lwEmulator* Emulator, uint8_t* Payload, int32_t PayloadSize, int64_t TimeUs) {
+	if (_readValue(Payload, PayloadSize, 2) != Emulator->token) {
+		return;
+	}
+
+	_sendPacket(Emulator, 14, Payload, PayloadSize);
+
+	// A committed firmware upload takes effect at the restart, and shows as a newer patch version.
+	if (Emulator->firmwareCommitted) {
+		Emulator->firmwareCommitted = false;
+		++Emulator->firmwareVersion;
+	}
+
+	_reset(Emulator, TimeUs);
+	Emulator->resetEndUs = TimeUs + LW_EMULATOR_RESET_TIME_US;
+}
+
+static void _handleCommand(lwEmulator* Emulator, uint8_t* Packet, int32_t PacketSize, int64_t TimeUs) {
+	const lwEmulatorDevice* device = Emulator->device;
+	uint8_t commandId = Packet[3];
+	bool write = (Packet[1] & 0x1) != 0;
+	uint8_t* payload = Packet + 4;
+	int32_t payloadSize = PacketSize - 6;
+
+	if (TimeUs < Emulator->resetEndUs) {
+		return;
+	}
+
+	++Emulator->commandCount;
+
+	if (write) {
+		if (commandId == 14) {
+			_handleReset(Emulator, payload, payloadSize, TimeUs);
+		} else if (commandId == 16) {
+			_handleFirmwarePage(Emulator, payload, payloadSize);
+		} else if (commandId == 17) {
+			_handleFirmwareCommit(Emulator);
+		} else if (commandId == 30) {
+			Emulator->streamMode = _readValue(payload, payloadSize, 4);
+			_restartStream(Emulator, TimeUs);
+			_sendPacket(Emulator, commandId, payload, payloadSize);
+		} else if (commandId != 0 && commandId == device->distanceOutputCommand) {
+			Emulator->distanceOutput = _readValue(payload, payloadSize, 4);
+			_sendPacket(Emulator, commandId, payload, payloadSize);
+		} else if (commandId != 0 && commandId == device->updateRateCommand) {
+			Emulator->updateRate = (uint8_t)_readValue(payload, payloadSize, 1);
+			_restartStream(Emulator, TimeUs);
+			_sendPacket(Emulator, commandId, payload, payloadSize);
+		} else if (commandId == 77 && device->fullSpeedRate != 0) {
+			Emulator->returnMode = (uint16_t)_readValue(payload, payloadSize, 2);
+			_sendPacket(Emulator, commandId, payload, payloadSize);
+		}
+
+		return;
+	}
+
+	char serialNumber[16];
+
+	switch (commandId) {
+		case 0: { _respondString(Emulator, 0, device->model); } break;
+		case 1: { _respondUInt32(Emulator, 1, device->hardwareVersion); } break;
+		case 2: { _respondUInt32(Emulator, 2, Emulator->firmwareVersion); } break;
+		case 3: {
+			snprintf(serialNumber, sizeof(serialNumber), "EMU%05d", (int)(device - _devices));
+			_respondString(Emulator, 3, serialNumber);
+		} break;
+		case 10: { _sendPacket(Emulator, 10, (uint8_t*)&Emulator->token, 2); } break;
+		case 30: { _respondUInt32(Emulator, 30, Emulator->streamMode); } break;
+		case 77: {
+			if (device->fullSpeedRate != 0) {
+				_sendPacket(Emulator, 77, (uint8_t*)&Emulator->returnMode, 2);
+			}
+		} break;
+		default: {
+			if (commandId != 0 && commandId == device->distanceOutputCommand) {
+				_respondUInt32(Emulator, commandId, Emulator->distanceOutput);
+			} else if (commandId != 0 && commandId == device->updateRateCommand) {
+				_sendPacket(Emulator, commandId, &Emulator->updateRate, 1);
+			}
+		}
+	}
+}
+
+// Reads everything the client sent and answers each complete command.
+static void _receive(lwEmulator* Emulator, int64_t TimeUs) {
+	lwPacketSpan spans[64];
+
+	while (1) {
+		int32_t bytesRead = read(Emulator->masterDescriptor, Emulator->recvBuffer + Emulator->recvSize, LW_RECV_BUFFER_SIZE);
+
+		if (bytesRead <= 0) {
+			break;
+		}
+
+		Emulator->recvSize += bytesRead;
+		int32_t count;
+
+		do {
+			int32_t consumed = 0;
+			count = lwnxParseBuffer(&Emulator->parser, Emulator->recvBuffer, Emulator->recvSize, spans, 64, &consumed);
+
+			for (int32_t i = 0; i < count; ++i) {
+				_handleCommand(Emulator, Emulator->recvBuffer + spans[i].offset, spans[i].size, TimeUs);
+			}
+
+			Emulator->recvSize -= consumed;
+			memmove(Emulator->recvBuffer, Emulator->recvBuffer + consumed, Emulator->recvSize);
+		} while (count == 64);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Streaming.
+//----------------------------------------------------------------------------------------------------------------------------------
+// Sends a Command 44 reading with the fields selected by the distance output.
+static void _streamDistance(lwEmulator* Emulator, double TimeS) {
+	lwDistanceSample sample = {};
+	bool sweeps = (Emulator->device == &_devices[LW_EMULATOR_SF45]);
+	double yaw = sweeps ? _getYaw(TimeS) : 0;
+	double distance = sweeps ? _getRoomDistance(TimeS, yaw) : _getPointDistance(TimeS);
+
+	sample.firstReturnRaw = _toCentimetres(Emulator, distance);
+	sample.firstReturnFiltered = (uint16_t)(distance * 100.0);
+	sample.firstReturnStrength = (uint16_t)(distance < 50 ? 100 - distance * 2 : 0);
+	sample.lastReturnRaw = sample.firstReturnRaw;
+	sample.lastReturnFiltered = sample.firstReturnFiltered;
+	sample.lastReturnStrength = sample.firstReturnStrength;
+	sample.backgroundNoise = (uint16_t)(10 + _random(Emulator) * 4);
+	sample.temperature = 2500;
+	sample.yawAngle = (int16_t)lround(yaw * 100.0);
+
+	uint32_t mask = Emulator->distanceOutput & Emulator->device->fieldMask;
+	uint8_t data[LW_DISTANCE_FIELD_COUNT * 2];
+	int32_t size = 0;
+
+	#define LW_EMULATOR_WRITE_FIELD(Bit, Name, Type, Scale) \
+		if ((mask >> Bit) & 1) { data[size] = (uint16_t)sample.Name & 0xFF; data[size + 1] = ((uint16_t)sample.Name >> 8) & 0xFF; size += 2; }
+	LW_DISTANCE_FIELDS(LW_EMULATOR_WRITE_FIELD)
+	#undef LW_EMULATOR_WRITE_FIELD
+
+	_sendPacket(Emulator, 44, data, size);
+}
+
+// Adds a distance to the next Command 40 packet, and sends it once it is full.
+static void _streamFullSpeed(lwEmulator* Emulator, double TimeS) {
+	Emulator->fullSpeed[Emulator->fullSpeedCount++] = _toCentimetres(Emulator, _getPointDistance(TimeS));
+
+	if (Emulator->fullSpeedCount == LW_EMULATOR_FULL_SPEED_BATCH) {
+		uint8_t data[1 + LW_EMULATOR_FULL_SPEED_BATCH * 2];
+		data[0] = LW_EMULATOR_FULL_SPEED_BATCH;
+		memcpy(data + 1, Emulator->fullSpeed, sizeof(Emulator->fullSpeed));
+		_sendPacket(Emulator, 40, data, sizeof(data));
+		Emulator->fullSpeedCount = 0;
+	}
+}
+
+// Sends a whole SF11 waveform in Command 32 packets, and its distance in a Command 39 packet. The waveform has a noise floor,
+// the outgoing pulse near its start and the return from the target, which is weaker further away.
+static void _streamWaveform(lwEmulator* Emulator, double TimeS) {
+	double distance = _getPointDistance(TimeS);
+	double echoPosition = 60.0 + distance * 60.0;
+	double echoAmplitude = 20000.0 / (1.0 + distance * distance / 25.0);
+
+	for (int32_t i = 0; i < LW_EMULATOR_WAVEFORM_SAMPLES; ++i) {
+		double outgoing = (i - 30.0) / 4.0;
+		double echo = (i - echoPosition) / 3.0;
+		double value = 200.0 + _randomNormal(Emulator) * 6.0 + 3000.0 * exp(-0.5 * outgoing * outgoing) + echoAmplitude * exp(-0.5 * echo * echo);
+		uint16_t sample = (uint16_t)(value < 0 ? 0 : (value > 0x7FFF ? 0x7FFF : value));
+
+		Emulator->waveform[Emulator->waveformCount++] = (i == 0) ? (sample | 0x8000) : sample;
+
+		if (Emulator->waveformCount == LW_EMULATOR_WAVEFORM_BATCH) {
+			// Each sample takes 4 bytes, of which the SF11 samples use the first 2.
+			uint8_t data[2 + LW_EMULATOR_WAVEFORM_BATCH * 4] = {};
+			data[0] = LW_EMULATOR_WAVEFORM_BATCH;
+
+			for (int32_t j = 0; j < LW_EMULATOR_WAVEFORM_BATCH; ++j) {
+				data[2 + j * 4] = Emulator->waveform[j] & 0xFF;
+				data[3 + j * 4] = (Emulator->waveform[j] >> 8) & 0xFF;
+			}
+
+			_sendPacket(Emulator, 32, data, sizeof(data));
+			Emulator->waveformCount = 0;
+		}
+	}
+
+	// NOTE: The SF11 sample reads the filtered distance in m as a float at byte 55 of the packet.
+	uint8_t info[60] = {};
+	float filteredDistance = (float)distance;
+	memcpy(info + 51, &filteredDistance, 4);
+	_sendPacket(Emulator, 39, info, sizeof(info));
+}
+
+// Sends every sample due by TimeUs. Returns when the next one is due.
+static int64_t _stream(lwEmulator* Emulator, int64_t TimeUs) {
+	double rate = lwEmulatorGetRate(Emulator);
+
+	if (rate <= 0) {
+		return TimeUs + 1000000;
+	}
+
+	double periodUs = 1000000.0 / rate;
+	int64_t dueCount = (int64_t)((TimeUs - Emulator->streamStartUs) / periodUs) + 1;
+
+	if ((dueCount - Emulator->streamCount) * periodUs > LW_EMULATOR_MAX_LAG_US) {
+		Emulator->sampleIndex += dueCount - Emulator->streamCount - 1;
+		Emulator->streamCount = dueCount - 1;
+	}
+
+	for (; Emulator->streamCount < dueCount; ++Emulator->streamCount, ++Emulator->sampleIndex) {
+		double timeS = Emulator->sampleIndex / rate;
+
+		if (Emulator->streamMode == 5) {
+			_streamDistance(Emulator, timeS);
+		} else if (Emulator->streamMode == 11) {
+			_streamFullSpeed(Emulator, timeS);
+		} else {
+			_streamWaveform(Emulator, timeS);
+		}
+	}
+
+	return Emulator->streamStartUs + (int64_t)ceil(Emulator->streamCount * periodUs);
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Emulator.
+//----------------------------------------------------------------------------------------------------------------------------------
+bool lwEmulatorOpen(lwEmulator* Emulator, const lwEmulatorDevice* Device, const char* LinkPath) {
+	Emulator->device = Device;
+	Emulator->firmwareVersion = Device->firmwareVersion;
+	Emulator->masterDescriptor = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if (Emulator->masterDescriptor < 0 || grantpt(Emulator->masterDescriptor) != 0 || unlockpt(Emulator->masterDescriptor) != 0 ||
+		ptsname_r(Emulator->masterDescriptor, Emulator->slaveName, sizeof(Emulator->slaveName)) != 0) {
+		printf("Couldn't create pseudo terminal!\n");
+		lwEmulatorClose(Emulator);
+		return false;
+	}
+
+	Emulator->slaveDescriptor = open(Emulator->slaveName, O_RDWR | O_NOCTTY);
+
+	struct termios tty;
+
+	if (Emulator->slaveDescriptor < 0 || tcgetattr(Emulator->slaveDescriptor, &tty) != 0) {
+		printf("Couldn't open pseudo terminal %s!\n", Emulator->slaveName);
+		lwEmulatorClose(Emulator);
+		return false;
+	}
+
+	// NOTE: Raw until the client sets its own mode, so nothing is echoed back to the emulator.
+	cfmakeraw(&tty);
+	tcsetattr(Emulator->slaveDescriptor, TCSANOW, &tty);
+	fcntl(Emulator->masterDescriptor, F_SETFL, fcntl(Emulator->masterDescriptor, F_GETFL) | O_NONBLOCK);
+
+	if (LinkPath != 0) {
+		unlink(LinkPath);
+
+		if (symlink(Emulator->slaveName, LinkPath) != 0) {
+			printf("Couldn't create link %s\n", LinkPath);
+		}
+	}
+
+	int64_t now = platformGetMicrosecond();
+	Emulator->linkTimeUs = now;
+	Emulator->randomState = 0x9E3779B9;
+	_reset(Emulator, now);
+
+	return true;
+}
+
+void lwEmulatorClose(lwEmulator* Emulator) {
+	if (Emulator->slaveDescriptor >= 0) {
+		close(Emulator->slaveDescriptor);
+	}
+
+	if (Emulator->masterDescriptor >= 0) {
+		close(Emulator->masterDescriptor);
+	}
+
+	Emulator->slaveDescriptor = -1;
+	Emulator->masterDescriptor = -1;
+}
+
+int64_t lwEmulatorUpdate(lwEmulator* Emulator, int64_t TimeUs) {
+	_receive(Emulator, TimeUs);
+
+	int64_t nextTime = _stream(Emulator, TimeUs);
+	int64_t flushTime = _flush(Emulator, TimeUs);
+
+	if (flushTime != 0 && flushTime < nextTime) {
+		nextTime = flushTime;
+	}
+
+	return nextTime;
+}
+
+void lwEmulatorRun(lwEmulator* Emulator, volatile bool* Running) {
+	while (*Running) {
+		int64_t nextTime = lwEmulatorUpdate(Emulator, platformGetMicrosecond());
+		int64_t waitTime = nextTime - platformGetMicrosecond();
+
+		if (waitTime <= 0) {
+			continue;
+		}
+
+		// NOTE: ppoll waits with microsecond resolution, poll only with milliseconds.
+		struct pollfd descriptor = {};
+		descriptor.fd = Emulator->masterDescriptor;
+		descriptor.events = POLLIN;
+
+		timespec timeout;
+		timeout.tv_sec = waitTime / 1000000;
+		timeout.tv_nsec = (waitTime % 1000000) * 1000;
+
+		ppoll(&descriptor, 1, &timeout, 0);
+	}
+}
\ No newline at end of file
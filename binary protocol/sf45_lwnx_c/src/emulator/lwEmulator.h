@@ -0,0 +1,141 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// Software emulation of LightWare devices over a pseudo terminal.
+//
+// The emulator opens a PTY and answers the LWNX commands the samples use, so the library and the samples can be run end to
+// end, at full rate, without hardware. Point lwSerialPortLinux::connect at the PTY name it prints, or at the link it creates.
+//
+// Commands:
+//   0-3      Product name, hardware version, firmware version and serial number.
+//   10, 14   Token and reset.
+//   16, 17   Firmware page upload and commit, as used by the SF23 upgrade.
+//   27, 29   Distance output, which selects the fields of Command 44.
+//   30       Stream: 5 streams Command 44, 11 streams Command 40 on the SF30/D, 1 streams Command 32 and 39 on the SF11.
+//   66, 76   Update rate of Command 44.
+//   77       Return mode on the SF30/D, stored and read back only.
+//
+// The streamed data comes from a synthetic scene. The SF45 sweeps across a room with a target moving through it, and the
+// single point devices see a target that moves slowly between near and far. Commands are answered as soon as they arrive.
+// Streamed packets are limited to the bit rate of the serial link, and packets that don't fit in the send buffer are dropped,
+// so a client that reads too slowly sees gaps like it would with a device.
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../common.h"
+#include "../lwNx.h"
+
+#define LW_EMULATOR_SF45			0
+#define LW_EMULATOR_SF30D			1
+#define LW_EMULATOR_SF000			2
+#define LW_EMULATOR_SF11			3
+#define LW_EMULATOR_SF23			4
+#define LW_EMULATOR_DEVICE_COUNT	5
+
+// Bytes of packets held while the link or the PTY is busy.
+#define LW_EMULATOR_SEND_BUFFER_SIZE	65536
+// Distances per Command 40 packet.
+#define LW_EMULATOR_FULL_SPEED_BATCH	32
+// Samples per Command 32 packet, and per SF11 waveform.
+#define LW_EMULATOR_WAVEFORM_BATCH		32
+#define LW_EMULATOR_WAVEFORM_SAMPLES	1450
+// Size of the firmware pages of Command 16.
+#define LW_EMULATOR_FIRMWARE_PAGE_SIZE	128
+
+class lwEmulatorDevice {
+	public:
+		const char* name;
+		// Returned by Command 0.
+		const char* model;
+		uint32_t hardwareVersion;
+		uint32_t firmwareVersion;
+		// Command ids of the update rate and the distance output, 0 if the device has none.
+		uint8_t updateRateCommand;
+		uint8_t distanceOutputCommand;
+		// Distance output fields the device has, see LW_DISTANCE_FIELDS.
+		uint32_t fieldMask;
+		// Rate of Command 40 in Hz, 0 if the device has no full speed streaming.
+		int32_t fullSpeedRate;
+		// Rate of waveforms in Hz, 0 if the device streams no waveforms.
+		int32_t waveformRate;
+};
+
+class lwEmulator {
+	public:
+		const lwEmulatorDevice* device;
+		int masterDescriptor;
+		// NOTE: The emulator keeps the slave side open, so the PTY survives clients that connect and disconnect.
+		int slaveDescriptor;
+		char slaveName[64];
+
+		// Rate of the stream in Hz, readings for Command 44 and 40 and waveforms for Command 32. 0 for the rate of the device.
+		double rate;
+		// Bits per second of the emulated serial link, 0 for no limit.
+		int32_t bitRate;
+
+		// Settings, as written by commands.
+		uint8_t updateRate;
+		uint32_t distanceOutput;
+		uint32_t streamMode;
+		uint16_t returnMode;
+		uint16_t token;
+		uint32_t firmwareVersion;
+		// Firmware pages received in order since the last commit, and whether a page was out of order.
+		int32_t firmwarePageCount;
+		bool firmwareFailed;
+		bool firmwareCommitted;
+		// Commands are ignored until this time after a reset.
+		int64_t resetEndUs;
+
+		lwPacketParser parser;
+		uint8_t recvBuffer[LW_RECV_BUFFER_SIZE + PACKET_MAX_SIZE];
+		int32_t recvSize;
+
+		uint8_t sendBuffer[LW_EMULATOR_SEND_BUFFER_SIZE];
+		int32_t sendSize;
+		// Bytes the link can send now, and when that was last updated.
+		double linkCredit;
+		int64_t linkTimeUs;
+
+		// When streaming started at the current rate and the samples streamed since, which set when the next one is due.
+		int64_t streamStartUs;
+		int64_t streamCount;
+		// Samples streamed in total, the time base of the scene.
+		uint64_t sampleIndex;
+		uint16_t fullSpeed[LW_EMULATOR_FULL_SPEED_BATCH];
+		int32_t fullSpeedCount;
+		uint16_t waveform[LW_EMULATOR_WAVEFORM_BATCH];
+		int32_t waveformCount;
+		uint32_t randomState;
+
+		uint64_t commandCount;
+		uint64_t packetCount;
+		uint64_t droppedCount;
+		uint64_t byteCount;
+
+		lwEmulator() :
+			device(0), masterDescriptor(-1), slaveDescriptor(-1), rate(0), bitRate(921600), updateRate(0), distanceOutput(0), streamMode(0),
+			returnMode(0), token(0), firmwareVersion(0), firmwarePageCount(0), firmwareFailed(false), firmwareCommitted(false), resetEndUs(0),
+			recvSize(0), sendSize(0), linkCredit(0), linkTimeUs(0), streamStartUs(0), streamCount(0), sampleIndex(0), fullSpeedCount(0), waveformCount(0),
+			randomState(1), commandCount(0), packetCount(0), droppedCount(0), byteCount(0) {
+			slaveName[0] = 0;
+		}
+};
+
+// Returns the device called Name, like "sf45", or 0 if there is none.
+const lwEmulatorDevice* lwEmulatorFindDevice(const char* Name);
+
+const lwEmulatorDevice* lwEmulatorGetDevice(int32_t Index);
+
+// Opens a PTY and resets the device to its defaults. If LinkPath is not 0 a symbolic link to the PTY is created there.
+bool lwEmulatorOpen(lwEmulator* Emulator, const lwEmulatorDevice* Device, const char* LinkPath);
+
+void lwEmulatorClose(lwEmulator* Emulator);
+
+// Answers the commands received so far and streams the samples due by TimeUs. Returns when the next sample is due, or
+// TimeUs + 1 s if nothing is streamed.
+int64_t lwEmulatorUpdate(lwEmulator* Emulator, int64_t TimeUs);
+
+// Calls lwEmulatorUpdate whenever data arrives or a sample is due, until Running is cleared.
+void lwEmulatorRun(lwEmulator* Emulator, volatile bool* Running);
+
+// Rate of the current stream in Hz, from the settings of the device or the rate set on the emulator. 0 if nothing is streamed.
+double lwEmulatorGetRate(lwEmulator* Emulator);
\ No newline at end of file
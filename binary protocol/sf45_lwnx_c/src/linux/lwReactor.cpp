@@ -0,0 +1,182 @@
+#include "lwReactor.h"
+
+#include <sys/epoll.h>
+
+bool lwReactorInit(lwReactor* Reactor) {
+	Reactor->epollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+
+	if (Reactor->epollDescriptor < 0) {
+		printf("Couldn't create epoll instance!\n");
+		return false;
+	}
+
+	return true;
+}
+
+void lwReactorClose(lwReactor* Reactor) {
+	if (Reactor->epollDescriptor >= 0) {
+		close(Reactor->epollDescriptor);
+	}
+
+	*Reactor = lwReactor();
+}
+
+static lwReactorPort* _findPort(lwReactor* Reactor, lwSerialPort* Serial) {
+	for (int32_t i = 0; i < LW_REACTOR_MAX_PORTS; ++i) {
+		if (Reactor->ports[i].serial == Serial) {
+			return &Reactor->ports[i];
+		}
+	}
+
+	return 0;
+}
+
+bool lwReactorAddPort(lwReactor* Reactor, lwSerialPort* Serial, lwReactorPortFunc Callback, void* User) {
+	int descriptor = Serial->getDescriptor();
+
+	if (descriptor < 0) {
+		printf("Port has no descriptor to wait on\n");
+		return false;
+	}
+
+	lwReactorPort* port = _findPort(Reactor, 0);
+
+	if (port == 0) {
+		printf("Reactor is full\n");
+		return false;
+	}
+
+	epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = port;
+
+	if (epoll_ctl(Reactor->epollDescriptor, EPOLL_CTL_ADD, descriptor, &event) != 0) {
+		printf("Couldn't add port to epoll instance!\n");
+		return false;
+	}
+
+	port->serial = Serial;
+	port->descriptor = descriptor;
+	port->callback = Callback;
+	port->user = User;
+	port->packetCount = 0;
+	++Reactor->portCount;
+
+	return true;
+}
+
+void lwReactorRemovePort(lwReactor* Reactor, lwSerialPort* Serial) {
+	lwReactorPort* port = _findPort(Reactor, Serial);
+
+	if (Serial == 0 || port == 0) {
+		return;
+	}
+
+	epoll_ctl(Reactor->epollDescriptor, EPOLL_CTL_DEL, port->descriptor, 0);
+	*port = lwReactorPort();
+	--Reactor->portCount;
+}
+
+// Services a port and calls its callback. Hangup is set when epoll reported an error or hangup, which fails the port if it
+// has nothing left to read, as a serial port that was unplugged keeps reading 0 bytes.
+static int32_t _servicePort(lwReactor* Reactor, lwReactorPort* Port, bool Hangup) {
+	lwSerialPort* serial = Port->serial;
+	int32_t count = lwnxService(serial);
+
+	// NOTE: A handler may have removed the port.
+	if (Port->serial != serial) {
+		return (count > 0) ? count : 0;
+	}
+
+	if (count == -1 || (count == 0 && Hangup && serial->recvHead == serial->recvTail)) {
+		lwReactorPortFunc callback = Port->callback;
+		void* user = Port->user;
+
+		lwReactorRemovePort(Reactor, serial);
+
+		if (callback != NULL) {
+			callback(Reactor, serial, -1, user);
+		}
+
+		return 0;
+	}
+
+	Port->packetCount += count;
+
+	if (Port->callback != NULL) {
+		Port->callback(Reactor, serial, count, Port->user);
+	}
+
+	return count;
+}
+
+int32_t lwReactorRun(lwReactor* Reactor, uint32_t TimeoutMs) {
+	int64_t now = platformGetMicrosecond();
+	int64_t timeoutTime = now + (int64_t)TimeoutMs * 1000;
+
+	// The earliest command due to be resent on any port ends the wait early.
+	for (int32_t i = 0; i < LW_REACTOR_MAX_PORTS; ++i) {
+		if (Reactor->ports[i].serial != 0) {
+			int64_t serviceTime = lwnxGetServiceTime(Reactor->ports[i].serial);
+
+			if (serviceTime != -1 && serviceTime < timeoutTime) {
+				timeoutTime = serviceTime;
+			}
+		}
+	}
+
+	if (Reactor->batchUs > 0) {
+		int64_t batchTime = Reactor->lastWakeUs + Reactor->batchUs;
+
+		if (batchTime > timeoutTime) {
+			batchTime = timeoutTime;
+		}
+
+		if (batchTime > now) {
+			platformSleepMicrosecond(batchTime - now);
+			now = platformGetMicrosecond();
+		}
+	}
+
+	// NOTE: Rounded up, so a due command is not serviced a wake early.
+	int32_t timeoutMs = (timeoutTime > now) ? (int32_t)((timeoutTime - now + 999) / 1000) : 0;
+	epoll_event events[LW_REACTOR_MAX_PORTS];
+	int32_t eventCount = epoll_wait(Reactor->epollDescriptor, events, LW_REACTOR_MAX_PORTS, timeoutMs);
+
+	if (eventCount < 0) {
+		if (errno == EINTR) {
+			return 0;
+		}
+
+		printf("epoll_wait failed\n");
+		return -1;
+	}
+
+	Reactor->lastWakeUs = platformGetMicrosecond();
+	++Reactor->wakeCount;
+
+	int32_t count = 0;
+
+	for (int32_t i = 0; i < eventCount; ++i) {
+		lwReactorPort* port = (lwReactorPort*)events[i].data.ptr;
+
+		if (port->serial != 0) {
+			count += _servicePort(Reactor, port, (events[i].events & (EPOLLHUP | EPOLLERR)) != 0);
+		}
+	}
+
+	// Ports without data can still have commands to resend or fail. Those serviced above are not due again yet.
+	for (int32_t i = 0; i < LW_REACTOR_MAX_PORTS; ++i) {
+		lwReactorPort* port = &Reactor->ports[i];
+
+		if (port->serial != 0) {
+			int64_t serviceTime = lwnxGetServiceTime(port->serial);
+
+			if (serviceTime != -1 && serviceTime <= Reactor->lastWakeUs) {
+				count += _servicePort(Reactor, port, false);
+			}
+		}
+	}
+
+	return count;
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// Serves many serial ports from one thread.
+//
+// Each port is registered with one epoll instance. lwReactorRun waits until any port has data or a pending command is due,
+// then calls lwnxService on the ports that need it, so packet handlers, async command callbacks and the port callback all run
+// on the thread that calls lwReactorRun. Use the lwnxCmd*Async functions from that thread, the blocking lwnxCmd* functions
+// wait on their own port and stall every other port while they do.
+//
+// Each wake costs a system call per ready port, and at 5000 Hz a port can be ready for every packet. Set batchUs to let data
+// collect between waits: the reactor then wakes at most once per batchUs, and each port's read returns every packet that
+// arrived since. 1000 us keeps 16 SF45s at 5000 Hz to a few percent of one core, at up to 1 ms of added latency.
+//
+// Linux only, ports must have a descriptor (see lwSerialPort::getDescriptor), so replayed captures can't be registered.
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../common.h"
+#include "../lwNx.h"
+
+#define LW_REACTOR_MAX_PORTS	64
+
+class lwReactor;
+
+// Called after a port was serviced with the number of packets received, and once with -1 when the port fails, after which it
+// is removed from the reactor.
+typedef void (*lwReactorPortFunc)(lwReactor* Reactor, lwSerialPort* Serial, int32_t PacketCount, void* User);
+
+class lwReactorPort {
+	public:
+		// 0 while the slot is free.
+		lwSerialPort* serial;
+		int descriptor;
+		lwReactorPortFunc callback;
+		void* user;
+		uint64_t packetCount;
+
+		lwReactorPort() : serial(0), descriptor(-1), callback(0), user(0), packetCount(0) { }
+};
+
+class lwReactor {
+	public:
+		int epollDescriptor;
+		// NOTE: Slots keep their place while others are removed, epoll events point at them.
+		lwReactorPort ports[LW_REACTOR_MAX_PORTS];
+		int32_t portCount;
+		// Least time between waits, 0 to wake as soon as any port has data.
+		int64_t batchUs;
+		int64_t lastWakeUs;
+
+		uint64_t wakeCount;
+
+		lwReactor() : epollDescriptor(-1), portCount(0), batchUs(0), lastWakeUs(0), wakeCount(0) { }
+};
+
+bool lwReactorInit(lwReactor* Reactor);
+
+// Closes the epoll instance. The ports are not disconnected.
+void lwReactorClose(lwReactor* Reactor);
+
+// Registers a connected port. Callback may be NULL. Returns false if the port has no descriptor or the reactor is full.
+bool lwReactorAddPort(lwReactor* Reactor, lwSerialPort* Serial, lwReactorPortFunc Callback = NULL, void* User = NULL);
+
+// Removes a port, which can then be used on its own again. May be called from the callbacks.
+void lwReactorRemovePort(lwReactor* Reactor, lwSerialPort* Serial);
+
+// Waits up to TimeoutMs for data or a due command, and services every port that needs it. Returns the number of packets
+// received across all ports, or -1 if the wait failed.
+int32_t lwReactorRun(lwReactor* Reactor, uint32_t TimeoutMs);
\ No newline at end of file
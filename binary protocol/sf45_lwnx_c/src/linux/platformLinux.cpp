@@ -1,16 +1,19 @@
 #include "platformLinux.h"
 #include "lwSerialPortLinux.h"
+#include "../lwCapture.h"
+#include "../lwSerialPortReplay.h"
 
 void platformInit() { }
 
+// NOTE: CLOCK_MONOTONIC_RAW is not stepped or slewed by NTP, so timeouts and packet timestamps stay consistent.
 int64_t platformGetMicrosecond() {
 	timespec time;
-	clock_gettime(CLOCK_REALTIME, &time);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &time);
 
-	return time.tv_sec * 1000000 + time.tv_nsec / 1000;
+	return (int64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
 }
 
-int32_t platformGetMillisecond() {
+int64_t platformGetMillisecond() {
 	return (platformGetMicrosecond() / 1000);
 }
 
@@ -19,6 +22,61 @@ bool platformSleep(int32_t TimeMS) {
 	return true;
 };
 
+bool platformSleepMicrosecond(int64_t TimeUs) {
+	if (TimeUs > 0) {
+		usleep(TimeUs);
+	}
+
+	return true;
+}
+
+uint8_t* platformMapFile(const char* Path, uint64_t* Size, void** Handle) {
+	int descriptor = open(Path, O_RDONLY);
+
+	if (descriptor < 0) {
+		return 0;
+	}
+
+	struct stat status;
+
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+		close(descriptor);
+		return 0;
+	}
+
+	void* data = mmap(0, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	// NOTE: The mapping stays valid after the descriptor is closed.
+	close(descriptor);
+
+	if (data == MAP_FAILED) {
+		return 0;
+	}
+
+	*Size = status.st_size;
+	*Handle = 0;
+
+	return (uint8_t*)data;
+}
+
+void platformUnmapFile(uint8_t* Data, uint64_t Size, void* Handle) {
+	munmap(Data, Size);
+}
+
+// NOTE: Set LWNX_CAPTURE to a file name to record everything received, see lwCapture.h. Set LWNX_REPLAY to a capture to
+// play it back instead of connecting to a device, see lwSerialPortReplay.h.
 lwSerialPort* platformCreateSerialPort() {
-	return new lwSerialPortLinux();
+	const char* replayPath = getenv("LWNX_REPLAY");
+
+	if (replayPath != 0) {
+		return lwReplayCreateSerialPort(replayPath);
+	}
+
+	lwSerialPort* port = new lwSerialPortLinux();
+	const char* capturePath = getenv("LWNX_CAPTURE");
+
+	if (capturePath != 0) {
+		port = lwCaptureCreateSerialPort(port, capturePath);
+	}
+
+	return port;
 }
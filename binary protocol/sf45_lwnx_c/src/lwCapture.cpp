@@ -0,0 +1,279 @@
+#include "lwCapture.h"
+#include "lwNx.h"
+
+// Size of the stdio buffer of each capture file, so a read costs a copy and not a system call.
+#define LW_CAPTURE_FILE_BUFFER	65536
+// Packets located per call to lwnxParseBuffer while indexing.
+#define LW_CAPTURE_PARSE_SPANS	256
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Writing.
+//----------------------------------------------------------------------------------------------------------------------------------
+static FILE* _createFile(const char* Path, int64_t StartTimeUs, uint32_t Magic) {
+	FILE* file = fopen(Path, "wb");
+
+	if (file == 0) {
+		return 0;
+	}
+
+	setvbuf(file, 0, _IOFBF, LW_CAPTURE_FILE_BUFFER);
+
+	lwCaptureHeader header;
+	header.magic = Magic;
+	header.version = LW_CAPTURE_VERSION;
+	header.startTimeUs = StartTimeUs;
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1) {
+		fclose(file);
+		return 0;
+	}
+
+	return file;
+}
+
+bool lwCaptureOpen(lwCaptureWriter* Writer, const char* Path) {
+	char indexPath[1024];
+	snprintf(indexPath, sizeof(indexPath), "%s.idx", Path);
+
+	int64_t startTime = platformGetMicrosecond();
+	Writer->dataFile = _createFile(Path, startTime, LW_CAPTURE_MAGIC);
+	Writer->indexFile = _createFile(indexPath, startTime, LW_CAPTURE_INDEX_MAGIC);
+	Writer->streamSize = 0;
+	Writer->entryCount = 0;
+	Writer->parseSize = 0;
+	Writer->parseOffset = 0;
+	Writer->parser = lwPacketParser();
+	Writer->failed = (Writer->dataFile == 0 || Writer->indexFile == 0);
+
+	if (Writer->failed) {
+		printf("Could not create capture %s\n", Path);
+		lwCaptureClose(Writer);
+		return false;
+	}
+
+	return true;
+}
+
+static void _writeEntry(lwCaptureWriter* Writer, int64_t TimeUs, uint64_t Offset, uint32_t Size, uint8_t Type, uint8_t CommandId) {
+	lwCaptureIndexEntry entry;
+	entry.timeUs = TimeUs;
+	entry.offset = Offset;
+	entry.size = Size;
+	entry.type = Type;
+	entry.commandId = CommandId;
+	entry.reserved = 0;
+
+	if (fwrite(&entry, sizeof(entry), 1, Writer->indexFile) != 1) {
+		Writer->failed = true;
+	}
+
+	++Writer->entryCount;
+}
+
+// Finds the packets completed by the bytes just written and adds an entry for each.
+static void _indexPackets(lwCaptureWriter* Writer, uint8_t* Data, int32_t Size, int64_t TimeUs) {
+	lwPacketSpan spans[LW_CAPTURE_PARSE_SPANS];
+
+	// NOTE: The parse buffer only keeps the start of an incomplete packet between reads, so it holds a whole read after it.
+	memcpy(Writer->parseBuffer + Writer->parseSize, Data, Size);
+	Writer->parseSize += Size;
+
+	int32_t count;
+
+	do {
+		int32_t consumed = 0;
+		count = lwnxParseBuffer(&Writer->parser, Writer->parseBuffer, Writer->parseSize, spans, LW_CAPTURE_PARSE_SPANS, &consumed);
+
+		for (int32_t i = 0; i < count; ++i) {
+			_writeEntry(Writer, TimeUs, Writer->parseOffset + spans[i].offset, spans[i].size, LW_CAPTURE_ENTRY_PACKET, Writer->parseBuffer[spans[i].offset + 3]);
+		}
+
+		Writer->parseSize -= consumed;
+		Writer->parseOffset += consumed;
+		memmove(Writer->parseBuffer, Writer->parseBuffer + consumed, Writer->parseSize);
+	} while (count == LW_CAPTURE_PARSE_SPANS);
+}
+
+void lwCaptureWrite(lwCaptureWriter* Writer, uint8_t* Data, int32_t Size, int64_t TimeUs) {
+	if (Writer->failed || Size <= 0) {
+		return;
+	}
+
+	if (fwrite(Data, 1, Size, Writer->dataFile) != (size_t)Size) {
+		Writer->failed = true;
+	}
+
+	_writeEntry(Writer, TimeUs, Writer->streamSize, Size, LW_CAPTURE_ENTRY_READ, 0);
+	Writer->streamSize += Size;
+
+	for (int32_t offset = 0; offset < Size; offset += LW_RECV_BUFFER_SIZE) {
+		int32_t size = Size - offset;
+
+		if (size > LW_RECV_BUFFER_SIZE) {
+			size = LW_RECV_BUFFER_SIZE;
+		}
+
+		_indexPackets(Writer, Data + offset, size, TimeUs);
+	}
+
+	if (Writer->failed) {
+		printf("Capture write failed, recording stopped\n");
+	}
+}
+
+void lwCaptureFlush(lwCaptureWriter* Writer) {
+	if (Writer->dataFile != 0) {
+		fflush(Writer->dataFile);
+	}
+
+	if (Writer->indexFile != 0) {
+		fflush(Writer->indexFile);
+	}
+}
+
+void lwCaptureClose(lwCaptureWriter* Writer) {
+	lwCaptureFlush(Writer);
+
+	if (Writer->dataFile != 0) {
+		fclose(Writer->dataFile);
+		Writer->dataFile = 0;
+	}
+
+	if (Writer->indexFile != 0) {
+		fclose(Writer->indexFile);
+		Writer->indexFile = 0;
+	}
+}
+
+int32_t lwCaptureSerialPort::readData(uint8_t *Buffer, int32_t BufferSize) {
+	int32_t bytesRead = port->readData(Buffer, BufferSize);
+
+	if (bytesRead > 0) {
+		lwCaptureWrite(writer, Buffer, bytesRead, platformGetMicrosecond());
+	}
+
+	return bytesRead;
+}
+
+lwSerialPort* lwCaptureCreateSerialPort(lwSerialPort* Port, const char* Path) {
+	lwCaptureWriter* writer = new lwCaptureWriter();
+
+	if (!lwCaptureOpen(writer, Path)) {
+		delete writer;
+		return Port;
+	}
+
+	printf("Recording to %s\n", Path);
+
+	return new lwCaptureSerialPort(Port, writer);
+}
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Reading.
+//----------------------------------------------------------------------------------------------------------------------------------
+bool lwCaptureReaderOpen(lwCaptureReader* Reader, const char* Path) {
+	char indexPath[1024];
+	snprintf(indexPath, sizeof(indexPath), "%s.idx", Path);
+
+	Reader->dataView = platformMapFile(Path, &Reader->dataViewSize, &Reader->dataMapping);
+	Reader->indexView = platformMapFile(indexPath, &Reader->indexViewSize, &Reader->indexMapping);
+
+	if (Reader->dataView == 0 || Reader->indexView == 0 || Reader->dataViewSize < sizeof(lwCaptureHeader) || Reader->indexViewSize < sizeof(lwCaptureHeader)) {
+		printf("Could not open capture %s\n", Path);
+		lwCaptureReaderClose(Reader);
+		return false;
+	}
+
+	lwCaptureHeader indexHeader;
+	memcpy(&Reader->header, Reader->dataView, sizeof(lwCaptureHeader));
+	memcpy(&indexHeader, Reader->indexView, sizeof(lwCaptureHeader));
+
+	if (Reader->header.magic != LW_CAPTURE_MAGIC || indexHeader.magic != LW_CAPTURE_INDEX_MAGIC || Reader->header.version != LW_CAPTURE_VERSION) {
+		printf("%s is not a capture\n", Path);
+		lwCaptureReaderClose(Reader);
+		return false;
+	}
+
+	Reader->stream = Reader->dataView + sizeof(lwCaptureHeader);
+	Reader->streamSize = Reader->dataViewSize - sizeof(lwCaptureHeader);
+	// NOTE: The header keeps the entries 8 byte aligned in the page aligned mapping.
+	Reader->entries = (lwCaptureIndexEntry*)(Reader->indexView + sizeof(lwCaptureHeader));
+	Reader->entryCount = (Reader->indexViewSize - sizeof(lwCaptureHeader)) / sizeof(lwCaptureIndexEntry);
+
+	// A capture that was cut short can have entries for bytes that did not reach the data file. The entries end after the
+	// packets of the last read that is complete in the data file, as a read's packets end within it.
+	uint64_t indexCount = Reader->entryCount;
+	uint64_t lastRead = indexCount;
+
+	while (lastRead > 0) {
+		lwCaptureIndexEntry* entry = &Reader->entries[lastRead - 1];
+
+		if (entry->type == LW_CAPTURE_ENTRY_READ && entry->offset + entry->size <= Reader->streamSize) {
+			break;
+		}
+
+		--lastRead;
+	}
+
+	Reader->entryCount = lastRead;
+
+	while (Reader->entryCount < indexCount && Reader->entries[Reader->entryCount].type == LW_CAPTURE_ENTRY_PACKET) {
+		++Reader->entryCount;
+	}
+
+	return true;
+}
+
+void lwCaptureReaderClose(lwCaptureReader* Reader) {
+	if (Reader->dataView != 0) {
+		platformUnmapFile(Reader->dataView, Reader->dataViewSize, Reader->dataMapping);
+	}
+
+	if (Reader->indexView != 0) {
+		platformUnmapFile(Reader->indexView, Reader->indexViewSize, Reader->indexMapping);
+	}
+
+	*Reader = lwCaptureReader();
+}
+
+uint64_t lwCaptureFindTime(lwCaptureReader* Reader, int64_t TimeUs) {
+	uint64_t low = 0;
+	uint64_t high = Reader->entryCount;
+
+	while (low < high) {
+		uint64_t middle = low + (high - low) / 2;
+
+		if (Reader->entries[middle].timeUs < TimeUs) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+uint64_t lwCaptureNextPacket(lwCaptureReader* Reader, uint64_t Index, int32_t CommandId) {
+	for (; Index < Reader->entryCount; ++Index) {
+		lwCaptureIndexEntry* entry = &Reader->entries[Index];
+
+		if (entry->type == LW_CAPTURE_ENTRY_PACKET && (CommandId == -1 || entry->commandId == CommandId)) {
+			break;
+		}
+	}
+
+	return Index;
+}
+
+void lwCaptureGetPacketView(lwCaptureReader* Reader, uint64_t Index, lwPacketView* View) {
+	lwCaptureIndexEntry* entry = &Reader->entries[Index];
+
+	View->data = Reader->stream + entry->offset;
+	View->size = entry->size;
+	View->commandId = View->data[3];
+	View->write = (View->data[1] & 0x1) != 0;
+	View->payload = View->data + 4;
+	View->payloadSize = entry->size - 6;
+	View->firstByteTimeUs = entry->timeUs;
+	View->lastByteTimeUs = entry->timeUs;
+}
\ No newline at end of file
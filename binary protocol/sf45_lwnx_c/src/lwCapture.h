@@ -0,0 +1,129 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// Recording of the raw bytes received from a device.
+//
+// A capture is two files. The data file holds a small header followed by every received byte exactly as it arrived, so a
+// mapped capture is one contiguous stream that the packet parser can read in place. The index file beside it, with ".idx"
+// appended to the name, holds fixed size entries in time order: one per read, with its receive time, and one per valid
+// packet found in the stream, with its offset, size and command id. Both files are only ever appended to, and a capture cut
+// short by a crash or power loss can still be read up to the last complete entry.
+//
+// lwCaptureSerialPort records everything read through another serial port, so any sample can record by wrapping the port it
+// creates. lwCaptureReader maps both files and finds the packets around a point in time with a binary search.
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "common.h"
+
+#define LW_CAPTURE_MAGIC			0x5043574C		// "LWCP"
+#define LW_CAPTURE_INDEX_MAGIC		0x4943574C		// "LWCI"
+#define LW_CAPTURE_VERSION			1
+
+// An entry for the bytes returned by one read.
+#define LW_CAPTURE_ENTRY_READ		0
+// An entry for a packet with a valid CRC.
+#define LW_CAPTURE_ENTRY_PACKET		1
+
+// Starts both files.
+class lwCaptureHeader {
+	public:
+		uint32_t magic;
+		uint32_t version;
+		// platformGetMicrosecond when the capture was started, the time base of the entries.
+		int64_t startTimeUs;
+};
+
+class lwCaptureIndexEntry {
+	public:
+		// When the read returned, or for a packet when the read holding its last byte returned.
+		int64_t timeUs;
+		// Position in the received stream, which starts right after the header of the data file.
+		uint64_t offset;
+		uint32_t size;
+		uint8_t type;
+		// Command id of a packet, 0 for a read.
+		uint8_t commandId;
+		uint16_t reserved;
+};
+
+class lwCaptureWriter {
+	public:
+		FILE* dataFile;
+		FILE* indexFile;
+		// Number of bytes and index entries written.
+		uint64_t streamSize;
+		uint64_t entryCount;
+		// Bytes that may hold the start of a packet, and their position in the stream.
+		uint8_t parseBuffer[LW_RECV_BUFFER_SIZE + PACKET_MAX_SIZE];
+		int32_t parseSize;
+		uint64_t parseOffset;
+		lwPacketParser parser;
+		// Set when a file could not be written. Recording stops, the serial port keeps working.
+		bool failed;
+
+		lwCaptureWriter() : dataFile(0), indexFile(0), streamSize(0), entryCount(0), parseSize(0), parseOffset(0), failed(false) { }
+};
+
+// Creates the data file at Path and the index file at Path with ".idx" appended, replacing existing files.
+bool lwCaptureOpen(lwCaptureWriter* Writer, const char* Path);
+
+// Appends the bytes returned by a read at TimeUs, and index entries for the read and any packets it completed.
+void lwCaptureWrite(lwCaptureWriter* Writer, uint8_t* Data, int32_t Size, int64_t TimeUs);
+
+// Passes buffered data and entries to the OS. The data file is flushed first, so entries never point past its end.
+void lwCaptureFlush(lwCaptureWriter* Writer);
+
+void lwCaptureClose(lwCaptureWriter* Writer);
+
+// A serial port that records everything read through Port, which it owns.
+class lwCaptureSerialPort : public lwSerialPort {
+	public:
+		lwSerialPort* port;
+		lwCaptureWriter* writer;
+
+		lwCaptureSerialPort(lwSerialPort* Port, lwCaptureWriter* Writer) : port(Port), writer(Writer) { }
+
+		bool connect(const char* Name, int BitRate) { return port->connect(Name, BitRate); }
+		bool disconnect() { lwCaptureFlush(writer); return port->disconnect(); }
+		int writeData(uint8_t *Buffer, int32_t BufferSize) { return port->writeData(Buffer, BufferSize); }
+		int32_t readData(uint8_t *Buffer, int32_t BufferSize);
+		bool waitForData(int64_t TimeoutUs) { return port->waitForData(TimeoutUs); }
+		int getDescriptor() { return port->getDescriptor(); }
+};
+
+// Wraps Port to record to Path. Returns Port itself if the capture files can't be created.
+lwSerialPort* lwCaptureCreateSerialPort(lwSerialPort* Port, const char* Path);
+
+class lwCaptureReader {
+	public:
+		lwCaptureHeader header;
+		// The received stream and the index entries, mapped read only.
+		uint8_t* stream;
+		uint64_t streamSize;
+		lwCaptureIndexEntry* entries;
+		uint64_t entryCount;
+		// The whole mapped files, with their headers.
+		uint8_t* dataView;
+		uint64_t dataViewSize;
+		void* dataMapping;
+		uint8_t* indexView;
+		uint64_t indexViewSize;
+		void* indexMapping;
+
+		lwCaptureReader() :
+			stream(0), streamSize(0), entries(0), entryCount(0), dataView(0), dataViewSize(0), dataMapping(0), indexView(0), indexViewSize(0),
+			indexMapping(0) { }
+};
+
+// Maps a capture. Entries that point past the end of the data file are left out.
+bool lwCaptureReaderOpen(lwCaptureReader* Reader, const char* Path);
+
+void lwCaptureReaderClose(lwCaptureReader* Reader);
+
+// Returns the first entry at or after TimeUs, or entryCount if there is none.
+uint64_t lwCaptureFindTime(lwCaptureReader* Reader, int64_t TimeUs);
+
+// Returns the first entry from Index that is a packet, optionally of one command id (-1 for any), or entryCount.
+uint64_t lwCaptureNextPacket(lwCaptureReader* Reader, uint64_t Index, int32_t CommandId = -1);
+
+// Points View at the packet of a packet entry in the mapped stream. The view must not be written to.
+void lwCaptureGetPacketView(lwCaptureReader* Reader, uint64_t Index, lwPacketView* View);
\ No newline at end of file
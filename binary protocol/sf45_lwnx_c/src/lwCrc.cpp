@@ -0,0 +1,307 @@
+#include "lwCrc.h"
+#include "lwCpu.h"
+
+#include <string.h>
+
+#if defined(LW_CPU_X86)
+	#define LW_CRC_FOLD_X86
+	#define LW_CRC_FOLD_TARGET LW_CPU_TARGET("pclmul,ssse3")
+#elif defined(LW_CPU_NEON) && defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+	#define LW_CRC_FOLD_ARM
+#endif
+
+#define LW_CRC_POLY				0x1021
+// Size thresholds measured with the benchmark: short packets are fastest with slice by 4, folding wins above 128 bytes.
+#define LW_CRC_SLICE8_MIN_SIZE	32
+#define LW_CRC_FOLD_MIN_SIZE	128
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Tables.
+//----------------------------------------------------------------------------------------------------------------------------------
+#ifdef LW_CRC_SMALL
+	#define LW_CRC_TABLE_COUNT 1
+#else
+	#define LW_CRC_TABLE_COUNT 8
+#endif
+
+// _crcTable[k][b] is the CRC of byte b followed by k zero bytes.
+static uint16_t _crcTable[LW_CRC_TABLE_COUNT][256];
+uint16_t lwCrc16ByteTable[256];
+
+#ifndef LW_CRC_SMALL
+// Fold constants x^N mod P for moving a 128 bit block forward by 16 and 64 bytes.
+static uint64_t _foldK16[2];
+static uint64_t _foldK64[2];
+static bool _foldSupported = false;
+#endif
+
+#ifndef LW_CRC_SMALL
+static lwCrc16Func _crcLarge = lwCrc16Table;
+static lwCrc16Func _crcSmall = lwCrc16Table;
+#endif
+static const char* _crcLargeName = "table";
+
+#ifndef LW_CRC_SMALL
+// Returns x^Power mod P.
+static uint16_t _crcPowerMod(uint32_t Power) {
+	uint32_t result = 1;
+
+	for (uint32_t i = 0; i < Power; ++i) {
+		result <<= 1;
+
+		if (result & 0x10000) {
+			result ^= 0x10000 | LW_CRC_POLY;
+		}
+	}
+
+	return (uint16_t)result;
+}
+
+static bool _crcDetectFold() {
+#if defined(LW_CRC_FOLD_X86)
+	return lwCpuHasPclmul();
+#elif defined(LW_CRC_FOLD_ARM)
+	return true;
+#else
+	return false;
+#endif
+}
+#endif
+
+static void _crcInit() {
+	for (uint32_t b = 0; b < 256; ++b) {
+		uint16_t crc = (uint16_t)(b << 8);
+
+		for (int bit = 0; bit < 8; ++bit) {
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ LW_CRC_POLY) : (uint16_t)(crc << 1);
+		}
+
+		_crcTable[0][b] = crc;
+		lwCrc16ByteTable[b] = crc;
+	}
+
+	for (int k = 1; k < LW_CRC_TABLE_COUNT; ++k) {
+		for (uint32_t b = 0; b < 256; ++b) {
+			uint16_t prev = _crcTable[k - 1][b];
+			_crcTable[k][b] = (uint16_t)(prev << 8) ^ _crcTable[0][prev >> 8];
+		}
+	}
+
+#ifndef LW_CRC_SMALL
+	_foldK16[0] = _crcPowerMod(128);
+	_foldK16[1] = _crcPowerMod(192);
+	_foldK64[0] = _crcPowerMod(512);
+	_foldK64[1] = _crcPowerMod(576);
+	_foldSupported = _crcDetectFold();
+
+	_crcSmall = lwCrc16Slice4;
+	_crcLarge = lwCrc16Slice8;
+	_crcLargeName = "slice8";
+
+	if (_foldSupported) {
+		_crcLarge = lwCrc16Fold;
+		_crcLargeName = "fold";
+	}
+#endif
+}
+
+LW_CPU_INITIALIZER(_crcInit);
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Implementations.
+//----------------------------------------------------------------------------------------------------------------------------------
+uint16_t lwCrc16Bitwise(uint16_t Crc, const uint8_t* Data, uint32_t Size) {
+	uint16_t crc = Crc;
+
+	for (uint32_t i = 0; i < Size; ++i) {
+		uint16_t code = crc >> 8;
+		code ^= Data[i];
+		code ^= code >> 4;
+		crc = crc << 8;
+		crc ^= code;
+		code = code << 5;
+		crc ^= code;
+		code = code << 7;
+		crc ^= code;
+	}
+
+	return crc;
+}
+
+uint16_t lwCrc16Table(uint16_t Crc, const uint8_t* Data, uint32_t Size) {
+	uint16_t crc = Crc;
+
+	for (uint32_t i = 0; i < Size; ++i) {
+		crc = (uint16_t)(crc << 8) ^ _crcTable[0][(crc >> 8) ^ Data[i]];
+	}
+
+	return crc;
+}
+
+#ifndef LW_CRC_SMALL
+uint16_t lwCrc16Slice4(uint16_t Crc, const uint8_t* Data, uint32_t Size) {
+	uint16_t crc = Crc;
+
+	while (Size >= 4) {
+		crc = _crcTable[3][Data[0] ^ (crc >> 8)] ^ _crcTable[2][Data[1] ^ (crc & 0xFF)] ^
+			_crcTable[1][Data[2]] ^ _crcTable[0][Data[3]];
+		Data += 4;
+		Size -= 4;
+	}
+
+	return lwCrc16Table(crc, Data, Size);
+}
+
+uint16_t lwCrc16Slice8(uint16_t Crc, const uint8_t* Data, uint32_t Size) {
+	uint16_t crc = Crc;
+
+	while (Size >= 8) {
+		crc = _crcTable[7][Data[0] ^ (crc >> 8)] ^ _crcTable[6][Data[1] ^ (crc & 0xFF)] ^
+			_crcTable[5][Data[2]] ^ _crcTable[4][Data[3]] ^
+			_crcTable[3][Data[4]] ^ _crcTable[2][Data[5]] ^
+			_crcTable[1][Data[6]] ^ _crcTable[0][Data[7]];
+		Data += 8;
+		Size -= 8;
+	}
+
+	return lwCrc16Table(crc, Data, Size);
+}
+
+// Folding treats each 16 byte block as a 128 bit polynomial, first byte most significant. A block A followed by Distance bytes
+// is congruent (mod P) to A.hi * x^(8 * Distance + 64) + A.lo * x^(8 * Distance), and since P is degree 16 each product fits in
+// 80 bits. Folding never reduces fully, the last 128 bit block plus the tail is finished with the slicing tables.
+#if defined(LW_CRC_FOLD_X86)
+LW_CRC_FOLD_TARGET static inline __m128i _foldLoad(const uint8_t* Data, __m128i Reverse) {
+	return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)Data), Reverse);
+}
+
+LW_CRC_FOLD_TARGET static inline __m128i _fold(__m128i Block, __m128i K, __m128i Next) {
+	__m128i hi = _mm_clmulepi64_si128(Block, K, 0x11);
+	__m128i lo = _mm_clmulepi64_si128(Block, K, 0x00);
+	return _mm_xor_si128(_mm_xor_si128(hi, lo), Next);
+}
+
+LW_CRC_FOLD_TARGET uint16_t lwCrc16Fold(uint16_t Crc, const uint8_t* Data, uint32_t Size) {
+	if (Size < 64) {
+		return lwCrc16Slice8(Crc, Data, Size);
+	}
+
+	const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i k16 = _mm_set_epi64x((int64_t)_foldK16[1], (int64_t)_foldK16[0]);
+	const __m128i k64 = _mm_set_epi64x((int64_t)_foldK64[1], (int64_t)_foldK64[0]);
+
+	// NOTE: The initial CRC is equivalent to xoring it into the first two message bytes.
+	__m128i x0 = _mm_xor_si128(_foldLoad(Data + 0, reverse), _mm_set_epi64x((int64_t)((uint64_t)Crc << 48), 0));
+	__m128i x1 = _foldLoad(Data + 16, reverse);
+	__m128i x2 = _foldLoad(Data + 32, reverse);
+	__m128i x3 = _foldLoad(Data + 48, reverse);
+	Data += 64;
+	Size -= 64;
+
+	while (Size >= 64) {
+		x0 = _fold(x0, k64, _foldLoad(Data + 0, reverse));
+		x1 = _fold(x1, k64, _foldLoad(Data + 16, reverse));
+		x2 = _fold(x2, k64, _foldLoad(Data + 32, reverse));
+		x3 = _fold(x3, k64, _foldLoad(Data + 48, reverse));
+		Data += 64;
+		Size -= 64;
+	}
+
+	x0 = _fold(x0, k16, x1);
+	x0 = _fold(x0, k16, x2);
+	x0 = _fold(x0, k16, x3);
+
+	while (Size >= 16) {
+		x0 = _fold(x0, k16, _foldLoad(Data, reverse));
+		Data += 16;
+		Size -= 16;
+	}
+
+	uint8_t block[16];
+	_mm_storeu_si128((__m128i*)block, _mm_shuffle_epi8(x0, reverse));
+
+	return lwCrc16Slice8(lwCrc16Slice8(0, block, 16), Data, Size);
+}
+#elif defined(LW_CRC_FOLD_ARM)
+static inline uint8x16_t _foldLoad(const uint8_t* Data) {
+	uint8x16_t v = vrev64q_u8(vld1q_u8(Data));
+	return vextq_u8(v, v, 8);
+}
+
+static inline uint8x16_t _fold(uint8x16_t Block, const uint64_t* K, uint8x16_t Next) {
+	uint64x2_t block = vreinterpretq_u64_u8(Block);
+	poly128_t hi = vmull_p64((poly64_t)vgetq_lane_u64(block, 1), (poly64_t)K[1]);
+	poly128_t lo = vmull_p64((poly64_t)vgetq_lane_u64(block, 0), (poly64_t)K[0]);
+	return veorq_u8(veorq_u8(vreinterpretq_u8_p128(hi), vreinterpretq_u8_p128(lo)), Next);
+}
+
+uint16_t lwCrc16Fold(uint16_t Crc, const uint8_t* Data, uint32_t Size) {
+	if (Size < 64) {
+		return lwCrc16Slice8(Crc, Data, Size);
+	}
+
+	// NOTE: The initial CRC is equivalent to xoring it into the first two message bytes.
+	uint64x2_t initial = vcombine_u64(vcreate_u64(0), vcreate_u64((uint64_t)Crc << 48));
+	uint8x16_t x0 = veorq_u8(_foldLoad(Data + 0), vreinterpretq_u8_u64(initial));
+	uint8x16_t x1 = _foldLoad(Data + 16);
+	uint8x16_t x2 = _foldLoad(Data + 32);
+	uint8x16_t x3 = _foldLoad(Data + 48);
+	Data += 64;
+	Size -= 64;
+
+	while (Size >= 64) {
+		x0 = _fold(x0, _foldK64, _foldLoad(Data + 0));
+		x1 = _fold(x1, _foldK64, _foldLoad(Data + 16));
+		x2 = _fold(x2, _foldK64, _foldLoad(Data + 32));
+		x3 = _fold(x3, _foldK64, _foldLoad(Data + 48));
+		Data += 64;
+		Size -= 64;
+	}
+
+	x0 = _fold(x0, _foldK16, x1);
+	x0 = _fold(x0, _foldK16, x2);
+	x0 = _fold(x0, _foldK16, x3);
+
+	while (Size >= 16) {
+		x0 = _fold(x0, _foldK16, _foldLoad(Data));
+		Data += 16;
+		Size -= 16;
+	}
+
+	uint8_t block[16];
+	uint8x16_t reversed = vrev64q_u8(x0);
+	vst1q_u8(block, vextq_u8(reversed, reversed, 8));
+
+	return lwCrc16Slice8(lwCrc16Slice8(0, block, 16), Data, Size);
+}
+#else
+uint16_t lwCrc16Fold(uint16_t Crc, const uint8_t* Data, uint32_t Size) {
+	return lwCrc16Slice8(Crc, Data, Size);
+}
+#endif
+
+bool lwCrc16FoldSupported() {
+	return _foldSupported;
+}
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Dispatch.
+//----------------------------------------------------------------------------------------------------------------------------------
+uint16_t lwCrc16(uint16_t Crc, const uint8_t* Data, uint32_t Size) {
+#ifdef LW_CRC_SMALL
+	return lwCrc16Table(Crc, Data, Size);
+#else
+	if (Size >= LW_CRC_FOLD_MIN_SIZE) {
+		return _crcLarge(Crc, Data, Size);
+	} else if (Size >= LW_CRC_SLICE8_MIN_SIZE) {
+		return lwCrc16Slice8(Crc, Data, Size);
+	}
+
+	return _crcSmall(Crc, Data, Size);
+#endif
+}
+
+const char* lwCrc16ImplementationName() {
+	return _crcLargeName;
+}
\ No newline at end of file
@@ -4,10 +4,7 @@
 #pragma once
 
 #include "common.h"
-
-#define PACKET_START_BYTE	0xAA
-#define PACKET_TIMEOUT		200
-#define PACKET_RETRIES		4
+#include "lwCrc.h"
 
 class lwResponsePacket {
 	public:
@@ -15,6 +12,10 @@ class lwResponsePacket {
 		int32_t size;
 		int32_t payloadSize;
 		uint8_t parseState;
+		uint16_t crc;
+		// Arrival time of the first and last byte when received through a serial port, see lwPacketView.
+		int64_t firstByteTimeUs;
+		int64_t lastByteTimeUs;
 
 		lwResponsePacket();
 };
@@ -28,16 +29,60 @@ uint16_t lwnxCreateCrc(uint8_t* Data, uint16_t Size);
 // Breaks an integer firmware version into Major, Minor, and Patch.
 void lwnxConvertFirmwareVersionToStr(uint32_t Version, char* String);
 
+// Adds a round trip time measurement to the estimate and derives a new retry timeout from it.
+void lwnxUpdateLinkTiming(lwLinkTiming* Timing, int64_t RoundTripUs);
+
 //----------------------------------------------------------------------------------------------------------------------------------
 // LWNX protocol implementation.
 //----------------------------------------------------------------------------------------------------------------------------------
 // Prepare a response packet for a new incoming response.
 void lwnxInitResponsePacket(lwResponsePacket* Response);
 
+// Feeds a single byte to the response packet parser.
+// Returns true when the byte completes a valid packet in Response.
+bool lwnxParseData(lwResponsePacket* Response, uint8_t Data);
+
+// Finds every complete, CRC-valid packet in Data and writes its location to Packets, up to MaxPackets.
+// Returns the number of packets found. Consumed receives the number of bytes processed; any remaining bytes
+// hold the start of an incomplete packet and must be passed again at the start of the next call.
+int32_t lwnxParseBuffer(lwPacketParser* Parser, uint8_t* Data, int32_t Size, lwPacketSpan* Packets, int32_t MaxPackets, int32_t* Consumed);
+
+// Reads as many bytes as are available from the serial port into its receive buffer.
+// Returns the number of bytes read, or -1 if the serial port failed.
+int32_t lwnxFillRecvBuffer(lwSerialPort* Serial);
+
 // Waits to receive a packet of specific command id.
 // Does not return until a response is received or a timeout occurs.
 bool lwnxRecvPacket(lwSerialPort* Serial, uint8_t CommandId, lwResponsePacket* Response, uint32_t TimeoutMs);
 
+// Waits to receive a packet of specific command id and returns a view of it in the receive buffer, without copying.
+// The view stays valid until it is passed to lwnxReleasePacketView, and the receive buffer is not compacted while
+// any view is held. Release views promptly: once the buffer is full no more data is read from the port, and the receive,
+// poll and command wait functions return without waiting until the views are released.
+bool lwnxRecvPacketView(lwSerialPort* Serial, uint8_t CommandId, lwPacketView* View, uint32_t TimeoutMs);
+
+// Releases a view returned by lwnxRecvPacketView so the receive buffer can reuse its memory.
+void lwnxReleasePacketView(lwSerialPort* Serial, lwPacketView* View);
+
+// Registers a handler for every received packet of a command id that is not the response a receive call is waiting for.
+// Packets without a handler are discarded. Pass NULL to remove the handler.
+// Handlers run on the thread that calls the receive functions, including while a managed command waits for its response.
+void lwnxSetPacketHandler(lwSerialPort* Serial, uint8_t CommandId, lwPacketHandlerFunc Handler, void* User = NULL);
+
+// Reads available data, dispatches every received packet to its handler or pending command, and resends or fails
+// pending commands whose timeout has passed.
+// Waits up to TimeoutMs for at least one packet. Returns the number of packets received, or -1 if the serial port failed.
+int32_t lwnxPoll(lwSerialPort* Serial, uint32_t TimeoutMs);
+
+// Does the work of lwnxPoll without waiting: one read of the data the port has now, then dispatching and servicing.
+// For callers that wait on many ports at once, see lwReactor. Returns the number of packets received, or -1 if the serial
+// port failed.
+int32_t lwnxService(lwSerialPort* Serial);
+
+// Returns when the earliest pending command is due to be resent or failed, from platformGetMicrosecond, or -1 if no
+// command is pending. Callers of lwnxService must call it again by then even if no data arrives.
+int64_t lwnxGetServiceTime(lwSerialPort* Serial);
+
 // Returns true if full packet was received, otherwise finishes immediately and returns false while waiting for more data.
 bool lwnxRecvPacketNoBlock(lwSerialPort* Serial, uint8_t CommandId, lwResponsePacket* Response);
 
@@ -48,6 +93,34 @@ void lwnxSendPacketBytes(lwSerialPort* Serial, uint8_t CommandId, uint8_t Write,
 // Does not return until a response is received or all retries have expired.
 bool lwnxHandleManagedCmd(lwSerialPort* Serial, uint8_t CommandId, uint8_t* Response, uint32_t ResponseSize, bool Write = false, uint8_t* WriteData = NULL, uint32_t WriteSize = 0);
 
+// Prepare a command that reads ResponseSize bytes of data.
+void lwnxInitReadCommand(lwCommand* Command, uint8_t CommandId, uint8_t* Response, uint32_t ResponseSize);
+
+// Prepare a command that writes DataSize bytes of data. The command is sent once, see lwCommand::maxAttempts.
+void lwnxInitWriteCommand(lwCommand* Command, uint8_t CommandId, uint8_t* Data, uint32_t DataSize);
+
+// Sends a prepared command and returns immediately. The command stays on the pending list of the serial port until its
+// response arrives or its deadline passes, and is resent as needed by lwnxPoll and the other receive functions.
+// Callback, if given, is then called from one of those functions.
+// The command, its response and its write data must stay valid until the command is done or cancelled.
+void lwnxSubmitCommand(lwSerialPort* Serial, lwCommand* Command, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+
+// Returns true once a submitted command has its response or has failed.
+bool lwnxCommandDone(lwCommand* Command);
+
+// Polls the serial port until the command is done or TimeoutMs has elapsed.
+// Returns true if the command has its response.
+bool lwnxWaitCommand(lwSerialPort* Serial, lwCommand* Command, uint32_t TimeoutMs);
+
+// Removes a submitted command from the pending list without calling its callback.
+void lwnxCancelCommand(lwSerialPort* Serial, lwCommand* Command);
+
+// Sends all the commands back to back, then matches the responses by command id as they arrive.
+// Only reads that did not get a response are sent again. Responses to the same command id are matched in order.
+// Does not return until every command has a response or its deadline has passed.
+// Timeouts come from Serial->linkTiming, which adapts to the measured round trip time of the link.
+bool lwnxHandleManagedBatch(lwSerialPort* Serial, lwCommand* Commands, int32_t Count);
+
 //----------------------------------------------------------------------------------------------------------------------------------
 // Command functions.
 //----------------------------------------------------------------------------------------------------------------------------------
@@ -73,4 +146,28 @@ bool lwnxCmdWriteUInt16(lwSerialPort* Serial, uint8_t CommandId, uint16_t Value)
 bool lwnxCmdWriteUInt32(lwSerialPort* Serial, uint8_t CommandId, uint32_t Value);
 
 bool lwnxCmdWriteString(lwSerialPort* Serial, uint8_t CommandId, char* String);
-bool lwnxCmdWriteData(lwSerialPort* Serial, uint8_t CommandId, uint8_t* Data, uint32_t DataSize);
\ No newline at end of file
+bool lwnxCmdWriteData(lwSerialPort* Serial, uint8_t CommandId, uint8_t* Data, uint32_t DataSize);
+
+// Issue commands without waiting for the response. Command is the handle of the request, see lwnxSubmitCommand.
+void lwnxCmdReadInt8Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int8_t* Response, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+void lwnxCmdReadInt16Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int16_t* Response, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+void lwnxCmdReadInt32Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int32_t* Response, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+
+void lwnxCmdReadUInt8Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint8_t* Response, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+void lwnxCmdReadUInt16Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint16_t* Response, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+void lwnxCmdReadUInt32Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint32_t* Response, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+
+void lwnxCmdReadStringAsync(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, char* Response, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+void lwnxCmdReadDataAsync(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint8_t* Response, uint32_t ResponseSize, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+
+// Values are copied into the command. The data of lwnxCmdWriteDataAsync must stay valid until the command is done.
+void lwnxCmdWriteInt8Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int8_t Value, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+void lwnxCmdWriteInt16Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int16_t Value, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+void lwnxCmdWriteInt32Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, int32_t Value, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+
+void lwnxCmdWriteUInt8Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint8_t Value, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+void lwnxCmdWriteUInt16Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint16_t Value, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+void lwnxCmdWriteUInt32Async(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint32_t Value, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+
+void lwnxCmdWriteStringAsync(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, char* String, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
+void lwnxCmdWriteDataAsync(lwSerialPort* Serial, lwCommand* Command, uint8_t CommandId, uint8_t* Data, uint32_t DataSize, lwCommandCallbackFunc Callback = NULL, void* User = NULL);
\ No newline at end of file
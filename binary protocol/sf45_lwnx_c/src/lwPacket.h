@@ -0,0 +1,150 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// Packet types shared by the serial port receive state and the LWNX protocol implementation.
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+
+#define PACKET_START_BYTE	0xAA
+#define PACKET_MAX_SIZE		1022
+#define PACKET_TIMEOUT		200
+#define PACKET_RETRIES		4
+
+// A complete packet located in a buffer passed to lwnxParseBuffer.
+class lwPacketSpan {
+	public:
+		int32_t offset;
+		int32_t size;
+};
+
+// A received packet that points into the receive buffer of its serial port instead of holding a copy.
+class lwPacketView {
+	public:
+		// The whole packet, from the start byte to the checksum.
+		uint8_t* data;
+		int32_t size;
+		uint8_t commandId;
+		bool write;
+		// The packet data after the command id, excluding the checksum.
+		uint8_t* payload;
+		int32_t payloadSize;
+		// When the reads holding the first and last byte of the packet returned, from platformGetMicrosecond.
+		int64_t firstByteTimeUs;
+		int64_t lastByteTimeUs;
+
+		lwPacketView() : data(0), size(0), commandId(0), write(false), payload(0), payloadSize(0), firstByteTimeUs(0), lastByteTimeUs(0) { }
+};
+
+class lwSerialPort;
+
+// Called with each received packet of the command id the handler is registered for.
+// The view is only valid for the duration of the call.
+typedef void (*lwPacketHandlerFunc)(lwSerialPort* Serial, lwPacketView* Packet, void* User);
+
+class lwPacketHandler {
+	public:
+		lwPacketHandlerFunc func;
+		void* user;
+
+		lwPacketHandler() : func(0), user(0) { }
+};
+
+// Replies that may still arrive for earlier sends of a command that is no longer pending.
+class lwLateReplies {
+	public:
+		int32_t count;
+		// After this the sends are assumed lost and replies are matched again.
+		int64_t expireTimeUs;
+
+		lwLateReplies() : count(0), expireTimeUs(0) { }
+};
+
+class lwCommand;
+
+// Called once an asynchronous command has finished, either with its response (complete is true) or after its retries or
+// deadline ran out (failed is true). The command may be submitted again from the callback.
+typedef void (*lwCommandCallbackFunc)(lwSerialPort* Serial, lwCommand* Command, void* User);
+
+// A command sent to the device and matched with its response by command id.
+// Prepare with lwnxInitReadCommand or lwnxInitWriteCommand, or use the lwnxCmd*Async functions.
+class lwCommand {
+	public:
+		uint8_t commandId;
+		bool write;
+		uint8_t* writeData;
+		uint32_t writeSize;
+		// Receives the response payload after the command id, up to responseSize bytes.
+		uint8_t* response;
+		uint32_t responseSize;
+		bool complete;
+		bool failed;
+		// Number of times the command has been sent, and when it was last sent.
+		int32_t attempts;
+		int64_t sendTimeUs;
+		// Times the command may be sent, 0 for the maxAttempts of the link. lwnxInitWriteCommand sets 1, since sending a write
+		// again repeats its effect, like a parameter save or a firmware page. Set it for writes that are safe to repeat.
+		int32_t maxAttempts;
+		// Timeout of the current attempt, when the command is sent again, and when it is given up.
+		// The last attempt waits until the deadline.
+		int64_t timeoutUs;
+		int64_t retryTimeUs;
+		int64_t deadlineTimeUs;
+		lwCommandCallbackFunc callback;
+		void* user;
+		// Holds the value written by the lwnxCmdWrite*Async functions, so the caller does not have to keep it.
+		uint8_t writeBuffer[16];
+		// Link in the pending command list of the serial port while waiting for a response.
+		lwCommand* next;
+
+		lwCommand() :
+			commandId(0), write(false), writeData(0), writeSize(0), response(0), responseSize(0), complete(false), failed(false),
+			attempts(0), sendTimeUs(0), maxAttempts(0), timeoutUs(0), retryTimeUs(0), deadlineTimeUs(0), callback(0), user(0), next(0) { }
+};
+
+// Round trip time estimate and retry policy of a link.
+// The retry timeout follows the smoothed round trip time and its variation, as TCP does (RFC 6298).
+class lwLinkTiming {
+	public:
+		// Smoothed round trip time and its mean deviation, 0 until the first response is measured.
+		int64_t srttUs;
+		int64_t rttvarUs;
+		// Timeout for the first attempt of a command.
+		int64_t timeoutUs;
+
+		// Policy, can be changed at any time.
+		int64_t minTimeoutUs;
+		int64_t maxTimeoutUs;
+		// Each retry waits this percentage of the previous timeout, up to maxTimeoutUs.
+		int32_t backoffPercent;
+		// Times a command is sent unless it sets its own maxAttempts.
+		int32_t maxAttempts;
+		// Overall time allowed for a command, including all retries.
+		int64_t deadlineUs;
+
+		lwLinkTiming() :
+			srttUs(0), rttvarUs(0), timeoutUs(PACKET_TIMEOUT * 1000),
+			minTimeoutUs(2000), maxTimeoutUs(PACKET_TIMEOUT * 1000), backoffPercent(200), maxAttempts(PACKET_RETRIES),
+			deadlineUs(PACKET_TIMEOUT * PACKET_RETRIES * 1000) { }
+};
+
+// A range of the receive buffer filled by one read, ending at offset end.
+class lwRecvChunk {
+	public:
+		int32_t end;
+		int64_t timeUs;
+};
+
+// State carried between calls to lwnxParseBuffer.
+class lwPacketParser {
+	public:
+		// Size of the incomplete packet left unconsumed by the last call, or 0 if its header was not complete.
+		int32_t pendingSize;
+		// Running CRC over the first crcSize bytes of the incomplete packet, so they are not hashed again.
+		uint16_t crc;
+		int32_t crcSize;
+		int32_t packetCount;
+		int32_t invalidCrcCount;
+		int32_t invalidSizeCount;
+
+		lwPacketParser() : pendingSize(0), crc(0), crcSize(0), packetCount(0), invalidCrcCount(0), invalidSizeCount(0) { }
+};
\ No newline at end of file
@@ -0,0 +1,225 @@
+#include "lwPolar.h"
+#include "lwCpu.h"
+
+#include <math.h>
+#include <string.h>
+
+// Yaw angles are offset by 32768 so they index the table from 0, the top bits select the entry and the rest interpolate.
+#define LW_POLAR_OFFSET			32768
+#define LW_POLAR_SHIFT			5
+#define LW_POLAR_FRACTION_MASK	((1 << LW_POLAR_SHIFT) - 1)
+#define LW_POLAR_TABLE_SIZE		((65536 >> LW_POLAR_SHIFT) + 1)
+
+typedef int32_t (*lwPolarFunc)(const uint16_t* Distance, const int16_t* YawAngle, int32_t Count, uint16_t MinDistance, uint16_t MaxDistance, float* X, float* Y, uint8_t* Valid);
+
+static float _cosTable[LW_POLAR_TABLE_SIZE];
+static float _sinTable[LW_POLAR_TABLE_SIZE];
+static const float _fractionScale = 1.0f / (1 << LW_POLAR_SHIFT);
+
+static lwPolarFunc _polar = lwPolarToCartesianScalar;
+static const char* _polarName = "scalar";
+
+//----------------------------------------------------------------------------------------------------------------------------------
+// Conversion kernels.
+//----------------------------------------------------------------------------------------------------------------------------------
+// NOTE: Every kernel computes each point with the same operations in the same order as this one, so their results match.
+int32_t lwPolarToCartesianScalar(const uint16_t* Distance, const int16_t* YawAngle, int32_t Count, uint16_t MinDistance, uint16_t MaxDistance, float* X, float* Y, uint8_t* Valid) {
+	int32_t validCount = 0;
+
+	for (int32_t i = 0; i < Count; ++i) {
+		int32_t yaw = YawAngle[i] + LW_POLAR_OFFSET;
+		int32_t index = yaw >> LW_POLAR_SHIFT;
+		float fraction = (float)(yaw & LW_POLAR_FRACTION_MASK) * _fractionScale;
+		float c = _cosTable[index] + (_cosTable[index + 1] - _cosTable[index]) * fraction;
+		float s = _sinTable[index] + (_sinTable[index + 1] - _sinTable[index]) * fraction;
+
+		bool valid = Distance[i] >= MinDistance && Distance[i] <= MaxDistance;
+		float distance = valid ? (float)Distance[i] * 0.01f : 0.0f;
+
+		X[i] = distance * c;
+		Y[i] = distance * s;
+		Valid[i] = valid;
+		validCount += valid;
+	}
+
+	return validCount;
+}
+
+#if defined(LW_CPU_X86)
+// NOTE: SSE2 has no gather, so the table entries are loaded one lane at a time and the rest of the point is vectorized.
+LW_CPU_TARGET("sse2") static int32_t _polarSse2(const uint16_t* Distance, const int16_t* YawAngle, int32_t Count, uint16_t MinDistance, uint16_t MaxDistance, float* X, float* Y, uint8_t* Valid) {
+	__m128i offset = _mm_set1_epi32(LW_POLAR_OFFSET);
+	__m128i fractionMask = _mm_set1_epi32(LW_POLAR_FRACTION_MASK);
+	__m128 fractionScale = _mm_set1_ps(_fractionScale);
+	__m128 distanceScale = _mm_set1_ps(0.01f);
+	__m128i minDistance = _mm_set1_epi32(MinDistance);
+	__m128i maxDistance = _mm_set1_epi32(MaxDistance);
+	__m128i one = _mm_set1_epi8(1);
+	__m128i zero = _mm_setzero_si128();
+	__m128i invalidCount = _mm_setzero_si128();
+	int32_t i = 0;
+
+	for (; i + 4 <= Count; i += 4) {
+		__m128i yawValues = _mm_loadl_epi64((const __m128i*)(YawAngle + i));
+		__m128i yaw = _mm_add_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(yawValues, yawValues), 16), offset);
+		__m128 fraction = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(yaw, fractionMask)), fractionScale);
+
+		int32_t index[4];
+		_mm_storeu_si128((__m128i*)index, _mm_srli_epi32(yaw, LW_POLAR_SHIFT));
+
+		__m128 c0 = _mm_setr_ps(_cosTable[index[0]], _cosTable[index[1]], _cosTable[index[2]], _cosTable[index[3]]);
+		__m128 c1 = _mm_setr_ps(_cosTable[index[0] + 1], _cosTable[index[1] + 1], _cosTable[index[2] + 1], _cosTable[index[3] + 1]);
+		__m128 s0 = _mm_setr_ps(_sinTable[index[0]], _sinTable[index[1]], _sinTable[index[2]], _sinTable[index[3]]);
+		__m128 s1 = _mm_setr_ps(_sinTable[index[0] + 1], _sinTable[index[1] + 1], _sinTable[index[2] + 1], _sinTable[index[3] + 1]);
+		__m128 c = _mm_add_ps(c0, _mm_mul_ps(_mm_sub_ps(c1, c0), fraction));
+		__m128 s = _mm_add_ps(s0, _mm_mul_ps(_mm_sub_ps(s1, s0), fraction));
+
+		__m128i distanceValues = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(Distance + i)), zero);
+		__m128i invalid = _mm_or_si128(_mm_cmpgt_epi32(minDistance, distanceValues), _mm_cmpgt_epi32(distanceValues, maxDistance));
+		__m128 distance = _mm_andnot_ps(_mm_castsi128_ps(invalid), _mm_mul_ps(_mm_cvtepi32_ps(distanceValues), distanceScale));
+
+		_mm_storeu_ps(X + i, _mm_mul_ps(distance, c));
+		_mm_storeu_ps(Y + i, _mm_mul_ps(distance, s));
+
+		// NOTE: Invalid lanes are -1, so adding 1 to the narrowed mask gives 0 for invalid and 1 for valid.
+		__m128i validBytes = _mm_add_epi8(_mm_packs_epi16(_mm_packs_epi32(invalid, invalid), zero), one);
+		int32_t validWord = _mm_cvtsi128_si32(validBytes);
+		memcpy(Valid + i, &validWord, 4);
+		invalidCount = _mm_sub_epi32(invalidCount, invalid);
+	}
+
+	int32_t counts[4];
+	_mm_storeu_si128((__m128i*)counts, invalidCount);
+	int32_t validCount = i - (counts[0] + counts[1] + counts[2] + counts[3]);
+
+	return validCount + lwPolarToCartesianScalar(Distance + i, YawAngle + i, Count - i, MinDistance, MaxDistance, X + i, Y + i, Valid + i);
+}
+
+LW_CPU_TARGET("avx2") static int32_t _polarAvx2(const uint16_t* Distance, const int16_t* YawAngle, int32_t Count, uint16_t MinDistance, uint16_t MaxDistance, float* X, float* Y, uint8_t* Valid) {
+	__m256i offset = _mm256_set1_epi32(LW_POLAR_OFFSET);
+	__m256i fractionMask = _mm256_set1_epi32(LW_POLAR_FRACTION_MASK);
+	__m256 fractionScale = _mm256_set1_ps(_fractionScale);
+	__m256 distanceScale = _mm256_set1_ps(0.01f);
+	__m256i minDistance = _mm256_set1_epi32(MinDistance);
+	__m256i maxDistance = _mm256_set1_epi32(MaxDistance);
+	__m128i one = _mm_set1_epi8(1);
+	__m256i invalidCount = _mm256_setzero_si256();
+	int32_t i = 0;
+
+	for (; i + 8 <= Count; i += 8) {
+		__m256i yaw = _mm256_add_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(YawAngle + i))), offset);
+		__m256i index = _mm256_srli_epi32(yaw, LW_POLAR_SHIFT);
+		__m256 fraction = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(yaw, fractionMask)), fractionScale);
+
+		__m256 c0 = _mm256_i32gather_ps(_cosTable, index, 4);
+		__m256 c1 = _mm256_i32gather_ps(_cosTable + 1, index, 4);
+		__m256 s0 = _mm256_i32gather_ps(_sinTable, index, 4);
+		__m256 s1 = _mm256_i32gather_ps(_sinTable + 1, index, 4);
+		__m256 c = _mm256_add_ps(c0, _mm256_mul_ps(_mm256_sub_ps(c1, c0), fraction));
+		__m256 s = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_sub_ps(s1, s0), fraction));
+
+		__m256i distanceValues = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(Distance + i)));
+		__m256i invalid = _mm256_or_si256(_mm256_cmpgt_epi32(minDistance, distanceValues), _mm256_cmpgt_epi32(distanceValues, maxDistance));
+		__m256 distance = _mm256_andnot_ps(_mm256_castsi256_ps(invalid), _mm256_mul_ps(_mm256_cvtepi32_ps(distanceValues), distanceScale));
+
+		_mm256_storeu_ps(X + i, _mm256_mul_ps(distance, c));
+		_mm256_storeu_ps(Y + i, _mm256_mul_ps(distance, s));
+
+		__m128i invalidWords = _mm_packs_epi32(_mm256_castsi256_si128(invalid), _mm256_extracti128_si256(invalid, 1));
+		__m128i validBytes = _mm_add_epi8(_mm_packs_epi16(invalidWords, invalidWords), one);
+		_mm_storel_epi64((__m128i*)(Valid + i), validBytes);
+		invalidCount = _mm256_sub_epi32(invalidCount, invalid);
+	}
+
+	int32_t counts[8];
+	_mm256_storeu_si256((__m256i*)counts, invalidCount);
+	int32_t validCount = i;
+
+	for (int32_t lane = 0; lane < 8; ++lane) {
+		validCount -= counts[lane];
+	}
+
+	return validCount + lwPolarToCartesianScalar(Distance + i, YawAngle + i, Count - i, MinDistance, MaxDistance, X + i, Y + i, Valid + i);
+}
+
+#elif defined(LW_CPU_NEON)
+// NOTE: NEON has no gather, so the table entries are loaded one lane at a time and the rest of the point is vectorized.
+static int32_t _polarNeon(const uint16_t* Distance, const int16_t* YawAngle, int32_t Count, uint16_t MinDistance, uint16_t MaxDistance, float* X, float* Y, uint8_t* Valid) {
+	int32x4_t offset = vdupq_n_s32(LW_POLAR_OFFSET);
+	int32x4_t fractionMask = vdupq_n_s32(LW_POLAR_FRACTION_MASK);
+	uint32x4_t minDistance = vdupq_n_u32(MinDistance);
+	uint32x4_t maxDistance = vdupq_n_u32(MaxDistance);
+	uint32x4_t validCount4 = vdupq_n_u32(0);
+	int32_t i = 0;
+
+	for (; i + 4 <= Count; i += 4) {
+		int32x4_t yaw = vaddq_s32(vmovl_s16(vld1_s16(YawAngle + i)), offset);
+		float32x4_t fraction = vmulq_n_f32(vcvtq_f32_s32(vandq_s32(yaw, fractionMask)), _fractionScale);
+
+		int32_t index[4];
+		vst1q_s32(index, vshrq_n_s32(yaw, LW_POLAR_SHIFT));
+
+		float c0v[4] = { _cosTable[index[0]], _cosTable[index[1]], _cosTable[index[2]], _cosTable[index[3]] };
+		float c1v[4] = { _cosTable[index[0] + 1], _cosTable[index[1] + 1], _cosTable[index[2] + 1], _cosTable[index[3] + 1] };
+		float s0v[4] = { _sinTable[index[0]], _sinTable[index[1]], _sinTable[index[2]], _sinTable[index[3]] };
+		float s1v[4] = { _sinTable[index[0] + 1], _sinTable[index[1] + 1], _sinTable[index[2] + 1], _sinTable[index[3] + 1] };
+		float32x4_t c0 = vld1q_f32(c0v);
+		float32x4_t s0 = vld1q_f32(s0v);
+		// NOTE: Separate multiply and add rather than vmlaq, which may fuse and round differently from the scalar kernel.
+		float32x4_t c = vaddq_f32(c0, vmulq_f32(vsubq_f32(vld1q_f32(c1v), c0), fraction));
+		float32x4_t s = vaddq_f32(s0, vmulq_f32(vsubq_f32(vld1q_f32(s1v), s0), fraction));
+
+		uint32x4_t distanceValues = vmovl_u16(vld1_u16(Distance + i));
+		uint32x4_t valid = vandq_u32(vcgeq_u32(distanceValues, minDistance), vcleq_u32(distanceValues, maxDistance));
+		float32x4_t distance = vmulq_n_f32(vcvtq_f32_u32(distanceValues), 0.01f);
+		distance = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(distance), valid));
+
+		vst1q_f32(X + i, vmulq_f32(distance, c));
+		vst1q_f32(Y + i, vmulq_f32(distance, s));
+
+		uint32x4_t validOnes = vshrq_n_u32(valid, 31);
+		uint8x8_t validBytes = vmovn_u16(vcombine_u16(vmovn_u32(validOnes), vdup_n_u16(0)));
+		vst1_lane_u32((uint32_t*)(Valid + i), vreinterpret_u32_u8(validBytes), 0);
+		validCount4 = vaddq_u32(validCount4, validOnes);
+	}
+
+	int32_t validCount = (int32_t)(vgetq_lane_u32(validCount4, 0) + vgetq_lane_u32(validCount4, 1) + vgetq_lane_u32(validCount4, 2) + vgetq_lane_u32(validCount4, 3));
+
+	return validCount + lwPolarToCartesianScalar(Distance + i, YawAngle + i, Count - i, MinDistance, MaxDistance, X + i, Y + i, Valid + i);
+}
+#endif
+
+static void _polarInit() {
+	for (int32_t i = 0; i < LW_POLAR_TABLE_SIZE; ++i) {
+		double angle = ((i << LW_POLAR_SHIFT) - LW_POLAR_OFFSET) * 0.01 * 3.14159265358979323846 / 180.0;
+		_cosTable[i] = (float)cos(angle);
+		_sinTable[i] = (float)sin(angle);
+	}
+
+#if defined(LW_CPU_X86)
+	_polar = _polarSse2;
+	_polarName = "sse2";
+
+	if (lwCpuHasAvx2()) {
+		_polar = _polarAvx2;
+		_polarName = "avx2";
+	}
+#elif defined(LW_CPU_NEON)
+	_polar = _polarNeon;
+	_polarName = "neon";
+#endif
+}
+
+LW_CPU_INITIALIZER(_polarInit);
+
+int32_t lwPolarToCartesian(const uint16_t* Distance, const int16_t* YawAngle, int32_t Count, uint16_t MinDistance, uint16_t MaxDistance, float* X, float* Y, uint8_t* Valid) {
+	return _polar(Distance, YawAngle, Count, MinDistance, MaxDistance, X, Y, Valid);
+}
+
+int32_t lwSweepToCartesian(const lwSweepFrame* Frame, float* X, float* Y, uint8_t* Valid) {
+	return _polar(Frame->distance, Frame->yawAngle, Frame->sampleCount, 1, 0xFFFF, X, Y, Valid);
+}
+
+const char* lwPolarImplementationName() {
+	return _polarName;
+}
\ No newline at end of file
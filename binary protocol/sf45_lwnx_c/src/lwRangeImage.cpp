@@ -0,0 +1,60 @@
+#include "lwRangeImage.h"
+#include <string.h>
+
+bool lwRangeImageInit(lwRangeImage* Image, int32_t StartAngle, int32_t EndAngle, int32_t BinWidth) {
+	if (BinWidth <= 0 || EndAngle <= StartAngle) {
+		return false;
+	}
+
+	int32_t binCount = (EndAngle - StartAngle + BinWidth - 1) / BinWidth + 1;
+
+	if (binCount > LW_RANGE_IMAGE_MAX_BINS) {
+		return false;
+	}
+
+	Image->startAngle = StartAngle;
+	Image->binWidth = BinWidth;
+	Image->binCount = binCount;
+	lwRangeImageClear(Image);
+
+	return true;
+}
+
+void lwRangeImageClear(lwRangeImage* Image) {
+	memset(Image->distance, 0, Image->binCount * sizeof(uint16_t));
+	memset(Image->strength, 0, Image->binCount * sizeof(uint16_t));
+	memset(Image->valid, 0, Image->binCount);
+}
+
+void lwRangeImageAdd(lwRangeImage* Image, uint16_t Distance, uint16_t Strength, int16_t YawAngle) {
+	int32_t bin = lwRangeImageBin(Image, YawAngle);
+
+	if (bin == -1 || Distance == 0) {
+		return;
+	}
+
+	if (!Image->valid[bin] || Distance < Image->distance[bin]) {
+		Image->distance[bin] = Distance;
+		Image->strength[bin] = Strength;
+		Image->valid[bin] = 1;
+	}
+}
+
+int32_t lwRangeImageFromSweep(lwRangeImage* Image, const lwSweepFrame* Frame) {
+	lwRangeImageClear(Image);
+	Image->sequence = Frame->sequence;
+	Image->startTimeUs = Frame->startTimeUs;
+	Image->endTimeUs = Frame->endTimeUs;
+
+	for (int32_t i = 0; i < Frame->sampleCount; ++i) {
+		lwRangeImageAdd(Image, Frame->distance[i], Frame->strength[i], Frame->yawAngle[i]);
+	}
+
+	int32_t validCount = 0;
+
+	for (int32_t i = 0; i < Image->binCount; ++i) {
+		validCount += Image->valid[i];
+	}
+
+	return validCount;
+}
\ No newline at end of file
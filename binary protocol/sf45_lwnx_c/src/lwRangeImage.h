@@ -0,0 +1,61 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// Resampling of SF45/B sweeps onto a fixed angular grid.
+//
+// The spacing of the samples in a sweep depends on the update rate and scan speed. A range image divides the scan into bins
+// of a fixed width, like 0.25 degrees, and keeps the closest return that fell in each bin, so every sweep gives arrays of the
+// same size that can be indexed directly by angle.
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "lwSweep.h"
+
+// Maximum number of bins, enough for a full circle at 0.25 degrees.
+#define LW_RANGE_IMAGE_MAX_BINS	1441
+
+class lwRangeImage {
+	public:
+		// Angle at the centre of the first bin and width of every bin, in 1/100 degrees. Bin i is centred on
+		// startAngle + i * binWidth.
+		int32_t startAngle;
+		int32_t binWidth;
+		int32_t binCount;
+
+		// Sequence number and times of the sweep the image was made from.
+		uint32_t sequence;
+		int64_t startTimeUs;
+		int64_t endTimeUs;
+
+		// Closest return in each bin, distance in cm and strength in percent. Both are 0 where valid is 0, which means no
+		// sample with a return fell in the bin.
+		uint16_t distance[LW_RANGE_IMAGE_MAX_BINS];
+		uint16_t strength[LW_RANGE_IMAGE_MAX_BINS];
+		uint8_t valid[LW_RANGE_IMAGE_MAX_BINS];
+
+		lwRangeImage() : startAngle(0), binWidth(1), binCount(0), sequence(0), startTimeUs(0), endTimeUs(0) { }
+};
+
+// Sets up bins of BinWidth centred from StartAngle to EndAngle, all in 1/100 degrees, like -4500, 4500 and 25 for a 90 degree
+// scan at 0.25 degrees. Returns false if that needs more than LW_RANGE_IMAGE_MAX_BINS bins.
+bool lwRangeImageInit(lwRangeImage* Image, int32_t StartAngle, int32_t EndAngle, int32_t BinWidth);
+
+// Marks every bin as empty.
+void lwRangeImageClear(lwRangeImage* Image);
+
+// Returns the bin that holds a yaw angle, or -1 if it is outside the image.
+inline int32_t lwRangeImageBin(const lwRangeImage* Image, int32_t YawAngle) {
+	int32_t offset = YawAngle - Image->startAngle + Image->binWidth / 2;
+
+	if (offset < 0) {
+		return -1;
+	}
+
+	int32_t bin = offset / Image->binWidth;
+
+	return (bin < Image->binCount) ? bin : -1;
+}
+
+// Adds a sample to its bin if it is closer than the return already there. Distances of 0 are no return and are ignored.
+void lwRangeImageAdd(lwRangeImage* Image, uint16_t Distance, uint16_t Strength, int16_t YawAngle);
+
+// Clears the image and adds every sample of a sweep. Returns the number of valid bins.
+int32_t lwRangeImageFromSweep(lwRangeImage* Image, const lwSweepFrame* Frame);
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "lwSerialPortReplay.h"
+
+// Moves to the next read entry from entryIndex, skipping packet entries, and finishes the replay after the last one.
+static void _findRead(lwSerialPortReplay* Port) {
+	while (Port->entryIndex < Port->reader.entryCount && Port->reader.entries[Port->entryIndex].type != LW_CAPTURE_ENTRY_READ) {
+		++Port->entryIndex;
+	}
+
+	if (Port->entryIndex == Port->reader.entryCount && !Port->finished) {
+		Port->finished = true;
+		printf("Replay finished: %llu bytes in %.3f s\n", (unsigned long long)Port->bytesReplayed, (platformGetMicrosecond() - Port->startTimeUs) / 1000000.0);
+	}
+}
+
+// When the next read is due, 0 when replaying as fast as possible.
+static int64_t _getDueTime(lwSerialPortReplay* Port) {
+	if (Port->speed <= 0) {
+		return 0;
+	}
+
+	int64_t captureTime = Port->reader.entries[Port->entryIndex].timeUs - Port->captureStartUs;
+
+	return Port->startTimeUs + (int64_t)(captureTime / Port->speed);
+}
+
+bool lwSerialPortReplay::connect(const char* Name, int BitRate) {
+	// NOTE: The capture path given at construction replaces the port name and bit rate.
+	(void)Name;
+	(void)BitRate;
+
+	printf("Attempt replay: %s\n", path);
+
+	if (!lwCaptureReaderOpen(&reader, path)) {
+		return false;
+	}
+
+	entryIndex = 0;
+	entryOffset = 0;
+	bytesReplayed = 0;
+	finished = false;
+	startTimeUs = platformGetMicrosecond();
+	_findRead(this);
+
+	if (!finished) {
+		captureStartUs = reader.entries[entryIndex].timeUs;
+	}
+
+	printf("Replaying %llu bytes at speed %g\n", (unsigned long long)reader.streamSize, speed);
+
+	return true;
+}
+
+bool lwSerialPortReplay::disconnect() {
+	lwCaptureReaderClose(&reader);
+	finished = true;
+
+	return true;
+}
+
+int lwSerialPortReplay::writeData(uint8_t *Buffer, int32_t BufferSize) {
+	(void)Buffer;
+
+	if (reader.stream == 0) {
+		printf("Can't write to null coms\n");
+		return -1;
+	}
+
+	return BufferSize;
+}
+
+int32_t lwSerialPortReplay::readData(uint8_t *Buffer, int32_t BufferSize) {
+	if (reader.stream == 0) {
+		printf("Can't read from null coms\n");
+		return -1;
+	}
+
+	if (finished || platformGetMicrosecond() < _getDueTime(this)) {
+		return 0;
+	}
+
+	lwCaptureIndexEntry* entry = &reader.entries[entryIndex];
+	int32_t size = entry->size - entryOffset;
+
+	if (size > BufferSize) {
+		size = BufferSize;
+	}
+
+	memcpy(Buffer, reader.stream + entry->offset + entryOffset, size);
+	entryOffset += size;
+	bytesReplayed += size;
+
+	if (entryOffset == entry->size) {
+		entryOffset = 0;
+		++entryIndex;
+		_findRead(this);
+	}
+
+	return size;
+}
+
+bool lwSerialPortReplay::waitForData(int64_t TimeoutUs) {
+	if (reader.stream == 0) {
+		return false;
+	}
+
+	if (finished) {
+		platformSleepMicrosecond(TimeoutUs);
+		return false;
+	}
+
+	int64_t waitTime = _getDueTime(this) - platformGetMicrosecond();
+
+	if (waitTime <= 0) {
+		return true;
+	}
+
+	if (waitTime > TimeoutUs) {
+		platformSleepMicrosecond(TimeoutUs);
+		return false;
+	}
+
+	platformSleepMicrosecond(waitTime);
+
+	return true;
+}
+
+lwSerialPort* lwReplayCreateSerialPort(const char* Path) {
+	double speed = 1.0;
+	const char* speedValue = getenv("LWNX_REPLAY_SPEED");
+
+	if (speedValue != 0) {
+		speed = atof(speedValue);
+	}
+
+	return new lwSerialPortReplay(Path, speed);
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// A serial port that plays back a capture recorded with lwCaptureSerialPort, so the samples and the receive path can run
+// without a device.
+//
+// Each read returns the bytes of one recorded read, so packets arrive in the same pieces as they did from the device. A command
+// sent during a replay is discarded, and its response is whatever the capture holds next. As long as the sample sends the same
+// commands it sent while recording, the responses it waits for arrive after it sends them.
+//
+// At a speed of 1 the recorded reads are returned at their recorded times, measured from the connect. A speed of 2 plays twice
+// as fast, and a speed of 0 returns every read as soon as it is asked for, to measure throughput.
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "common.h"
+#include "lwCapture.h"
+
+class lwSerialPortReplay : public lwSerialPort {
+	public:
+		const char* path;
+		double speed;
+		lwCaptureReader reader;
+		// Next read entry to return, and how much of it has been returned.
+		uint64_t entryIndex;
+		uint32_t entryOffset;
+		// platformGetMicrosecond at the connect, and the time of the first read in the capture.
+		int64_t startTimeUs;
+		int64_t captureStartUs;
+		uint64_t bytesReplayed;
+		// Set when every read in the capture has been returned.
+		bool finished;
+
+		lwSerialPortReplay(const char* Path, double Speed) :
+			path(Path), speed(Speed), entryIndex(0), entryOffset(0), startTimeUs(0), captureStartUs(0), bytesReplayed(0), finished(false) { }
+
+		// Opens the capture given to the constructor. Name and BitRate are ignored.
+		bool connect(const char* Name, int BitRate);
+		bool disconnect();
+		// Discards the bytes.
+		int writeData(uint8_t *Buffer, int32_t BufferSize);
+		int32_t readData(uint8_t *Buffer, int32_t BufferSize);
+		bool waitForData(int64_t TimeoutUs);
+};
+
+// Creates a replay of the capture at Path. Speed comes from LWNX_REPLAY_SPEED if it is set, otherwise 1.
+lwSerialPort* lwReplayCreateSerialPort(const char* Path);
\ No newline at end of file
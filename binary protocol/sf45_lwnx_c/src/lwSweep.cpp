@@ -0,0 +1,142 @@
+#include "lwSweep.h"
+#include <string.h>
+
+lwSweepAssembler::lwSweepAssembler() :
+	backIndex(0),
+	frontIndex(2),
+	sharedIndex(1),
+	hysteresis(50),
+	direction(0),
+	extremeIndex(0),
+	minYaw(0),
+	maxYaw(0),
+	sequence(0),
+	droppedCount(0) {
+	// NOTE: Defaults to the first return raw distance, first return strength and yaw angle.
+	lwDistanceInitLayout(&layout, 0x105);
+
+	// NOTE: The first sweep starts wherever the sensor happens to be.
+	frames[backIndex].partial = true;
+}
+
+// Hands the back frame to the consumer and takes the shared frame in its place.
+static void _sweepPublish(lwSweepAssembler* Sweep) {
+	lwSweepFrame* frame = &Sweep->frames[Sweep->backIndex];
+	frame->sequence = Sweep->sequence++;
+
+	uint32_t previous = Sweep->sharedIndex.exchange(Sweep->backIndex | LW_SWEEP_FRESH, std::memory_order_acq_rel);
+
+	if (previous & LW_SWEEP_FRESH) {
+		++Sweep->droppedCount;
+	}
+
+	Sweep->backIndex = previous & 3;
+}
+
+void lwSweepAddSample(lwSweepAssembler* Sweep, uint16_t Distance, uint16_t Strength, int16_t YawAngle, int64_t TimeUs) {
+	lwSweepFrame* frame = &Sweep->frames[Sweep->backIndex];
+
+	if (frame->sampleCount == LW_SWEEP_MAX_SAMPLES) {
+		frame->partial = true;
+		frame->direction = Sweep->direction;
+		_sweepPublish(Sweep);
+
+		frame = &Sweep->frames[Sweep->backIndex];
+		frame->sampleCount = 0;
+		frame->partial = true;
+		Sweep->direction = 0;
+	}
+
+	int32_t index = frame->sampleCount++;
+	frame->distance[index] = Distance;
+	frame->strength[index] = Strength;
+	frame->yawAngle[index] = YawAngle;
+	frame->endTimeUs = TimeUs;
+	Sweep->sampleTimeUs[index] = TimeUs;
+
+	if (index == 0) {
+		frame->startTimeUs = TimeUs;
+		Sweep->minYaw = YawAngle;
+		Sweep->maxYaw = YawAngle;
+	}
+
+	if (Sweep->direction == 0) {
+		if (YawAngle < Sweep->minYaw) { Sweep->minYaw = YawAngle; }
+		if (YawAngle > Sweep->maxYaw) { Sweep->maxYaw = YawAngle; }
+
+		if (YawAngle - Sweep->minYaw > Sweep->hysteresis) {
+			Sweep->direction = 1;
+		} else if (Sweep->maxYaw - YawAngle > Sweep->hysteresis) {
+			Sweep->direction = -1;
+		} else {
+			return;
+		}
+
+		Sweep->extremeIndex = index;
+		return;
+	}
+
+	int32_t progress = (YawAngle - frame->yawAngle[Sweep->extremeIndex]) * Sweep->direction;
+
+	if (progress >= 0) {
+		Sweep->extremeIndex = index;
+		return;
+	}
+
+	if (-progress <= Sweep->hysteresis) {
+		return;
+	}
+
+	// The yaw angle has reversed, so the sweep ends at the sample furthest along it.
+	int32_t extremeIndex = Sweep->extremeIndex;
+	frame->sampleCount = extremeIndex + 1;
+	frame->endTimeUs = Sweep->sampleTimeUs[extremeIndex];
+	frame->direction = Sweep->direction;
+	_sweepPublish(Sweep);
+
+	// NOTE: The published frame is only read from here on, so its samples after the reversal can still be copied out.
+	// The sample at the reversal starts the next sweep as well as ending this one.
+	lwSweepFrame* next = &Sweep->frames[Sweep->backIndex];
+	int32_t count = index - extremeIndex + 1;
+	memcpy(next->distance, frame->distance + extremeIndex, count * sizeof(uint16_t));
+	memcpy(next->strength, frame->strength + extremeIndex, count * sizeof(uint16_t));
+	memcpy(next->yawAngle, frame->yawAngle + extremeIndex, count * sizeof(int16_t));
+	memmove(Sweep->sampleTimeUs, Sweep->sampleTimeUs + extremeIndex, count * sizeof(int64_t));
+	next->sampleCount = count;
+	next->partial = false;
+	next->startTimeUs = Sweep->sampleTimeUs[0];
+	next->endTimeUs = TimeUs;
+
+	Sweep->direction = -Sweep->direction;
+	Sweep->extremeIndex = 0;
+
+	for (int32_t i = 1; i < count; ++i) {
+		if ((next->yawAngle[i] - next->yawAngle[Sweep->extremeIndex]) * Sweep->direction >= 0) {
+			Sweep->extremeIndex = i;
+		}
+	}
+}
+
+void lwSweepPacketHandler(lwSerialPort* Serial, lwPacketView* Packet, void* User) {
+	(void)Serial;
+	lwSweepAssembler* sweep = (lwSweepAssembler*)User;
+	lwDistanceSample sample;
+
+	if (!lwDistanceDecode(&sweep->layout, Packet, &sample)) {
+		return;
+	}
+
+	lwSweepAddSample(sweep, sample.firstReturnRaw, sample.firstReturnStrength, sample.yawAngle, Packet->lastByteTimeUs);
+}
+
+lwSweepFrame* lwSweepAcquire(lwSweepAssembler* Sweep) {
+	// NOTE: Only the consumer clears LW_SWEEP_FRESH, so it is still set at the exchange.
+	if (!(Sweep->sharedIndex.load(std::memory_order_relaxed) & LW_SWEEP_FRESH)) {
+		return NULL;
+	}
+
+	uint32_t previous = Sweep->sharedIndex.exchange(Sweep->frontIndex, std::memory_order_acq_rel);
+	Sweep->frontIndex = previous & 3;
+
+	return &Sweep->frames[Sweep->frontIndex];
+}
\ No newline at end of file
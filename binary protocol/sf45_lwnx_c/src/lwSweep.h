@@ -0,0 +1,85 @@
+//----------------------------------------------------------------------------------------------------------------------------------
+// Assembles the streamed SF45/B distance data into complete sweeps.
+//
+// A sweep ends where the yaw angle reverses direction. Samples are written into preallocated frames and each completed frame
+// is handed to a consumer through a lock free triple buffer: the receive thread fills one frame, the consumer reads another
+// and the third holds the newest completed sweep. Neither side blocks or allocates, and the consumer never sees a frame
+// that is still being written.
+//----------------------------------------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include "lwDistanceOutput.h"
+
+// Maximum number of samples in a sweep. A sweep that grows beyond this is published early and marked partial.
+#define LW_SWEEP_MAX_SAMPLES	16384
+
+// Set in lwSweepAssembler::sharedIndex while the shared frame holds a sweep the consumer has not taken.
+#define LW_SWEEP_FRESH			0x4
+
+class lwSweepFrame {
+	public:
+		int32_t sampleCount;
+		// Increases by one for every published sweep.
+		uint32_t sequence;
+		// 1 if the yaw angle increases through the sweep, -1 if it decreases, 0 if not known.
+		int32_t direction;
+		// The sweep did not start or end at a reversal, like the first sweep after the assembler was created.
+		bool partial;
+		// Arrival time of the first and last sample, from lwPacketView::lastByteTimeUs.
+		int64_t startTimeUs;
+		int64_t endTimeUs;
+
+		// Samples in the order received. Distance in cm, strength in percent, yaw angle in 1/100 degrees.
+		uint16_t distance[LW_SWEEP_MAX_SAMPLES];
+		uint16_t strength[LW_SWEEP_MAX_SAMPLES];
+		int16_t yawAngle[LW_SWEEP_MAX_SAMPLES];
+
+		lwSweepFrame() : sampleCount(0), sequence(0), direction(0), partial(false), startTimeUs(0), endTimeUs(0) { }
+};
+
+// NOTE: Holds three frames of about 100 KB each and the arrival time of every sample being filled, so create it on the heap.
+// lwSweepAddSample and lwSweepPacketHandler must be called from one thread, lwSweepAcquire from one other thread (or the same).
+class lwSweepAssembler {
+	public:
+		lwSweepFrame frames[3];
+		// Frame being filled, owned by the receive thread.
+		int32_t backIndex;
+		// Frame returned by the last lwSweepAcquire, owned by the consumer.
+		int32_t frontIndex;
+		// Frame passed between the two, with LW_SWEEP_FRESH.
+		std::atomic<uint32_t> sharedIndex;
+
+		// Movement of the yaw angle back from its furthest point, in 1/100 degrees, that counts as a reversal.
+		int32_t hysteresis;
+		// Layout of the distance data decoded by lwSweepPacketHandler, 0x105 unless set with lwDistanceInitLayout to the
+		// distance output of the device. The distance output must include the first return raw distance and yaw angle.
+		lwDistanceLayout layout;
+
+		// Direction of the sweep being filled, and the sample furthest along it.
+		int32_t direction;
+		int32_t extremeIndex;
+		// Range of the yaw angle while the direction is not known.
+		int16_t minYaw;
+		int16_t maxYaw;
+
+		uint32_t sequence;
+		// Sweeps replaced by a newer one before the consumer took them.
+		uint32_t droppedCount;
+
+		// Arrival time of each sample of the frame being filled, so the sweep can end and the next start at any of them.
+		int64_t sampleTimeUs[LW_SWEEP_MAX_SAMPLES];
+
+		lwSweepAssembler();
+};
+
+// Adds a sample to the sweep being filled, and publishes the sweep when the yaw angle reverses.
+void lwSweepAddSample(lwSweepAssembler* Sweep, uint16_t Distance, uint16_t Strength, int16_t YawAngle, int64_t TimeUs);
+
+// Packet handler for distance data (Command 44) that adds the first return raw distance, first return strength and yaw angle
+// of each packet. Register with lwnxSetPacketHandler and the assembler as User.
+void lwSweepPacketHandler(lwSerialPort* Serial, lwPacketView* Packet, void* User);
+
+// Returns the newest completed sweep if there is one that has not been returned before, otherwise NULL.
+// The frame stays valid and unchanged until the next call that returns a frame.
+lwSweepFrame* lwSweepAcquire(lwSweepAssembler* Sweep);
\ No newline at end of file
@@ -3,6 +3,15 @@
 //----------------------------------------------------------------------------------------------------------------------------------
 #include "common.h"
 #include "lwNx.h"
+#include "lwDistanceOutput.h"
+#include "lwSweep.h"
+
+// Distance output written to the sensor, which also fixes the layout of the streamed packets. (Command 27: Distance output)
+// first return raw distance: 0
+// first return strength: 2
+// temperature: 7
+// yaw angle: 8
+typedef lwDistanceDecoder<0x185> distanceDecoder;
 
 //----------------------------------------------------------------------------------------------------------------------------------
 // Helper utilities.
@@ -27,10 +36,44 @@ void exitCommandFailure() {
 	exitWithMessage("No response to command, terminating sample.\n");
 }
 
-uint16_t readInt16(uint8_t* Buffer, uint32_t Offset) {
-	uint16_t result;
-	result = (Buffer[Offset + 0] << 0) | (Buffer[Offset + 1] << 8);
-	return result;
+//----------------------------------------------------------------------------------------------------------------------------------
+// Sweep output.
+//----------------------------------------------------------------------------------------------------------------------------------
+// Temperature of the latest reading, in 1/100 degrees.
+int16_t latestTemperature = 0;
+
+// Passes each streamed reading to the sweep assembler, and keeps the temperature that the sweeps don't hold.
+void handleDistance(lwSerialPort* Serial, lwPacketView* Packet, void* User) {
+	lwSweepAssembler* sweep = (lwSweepAssembler*)User;
+	lwDistanceSample sample;
+
+	if (!distanceDecoder::decode(Packet, &sample)) {
+		return;
+	}
+
+	latestTemperature = sample.temperature;
+	lwSweepAddSample(sweep, sample.firstReturnRaw, sample.firstReturnStrength, sample.yawAngle, Packet->lastByteTimeUs);
+}
+
+// Called for each completed sweep, with the samples of a full pass from one side of the scan to the other.
+void printSweep(lwSweepFrame* Frame) {
+	int32_t closest = -1;
+
+	for (int32_t i = 0; i < Frame->sampleCount; ++i) {
+		if (Frame->distance[i] != 0 && (closest == -1 || Frame->distance[i] < Frame->distance[closest])) {
+			closest = i;
+		}
+	}
+
+	float startAngle = Frame->yawAngle[0] / 100.0;
+	float endAngle = Frame->yawAngle[Frame->sampleCount - 1] / 100.0;
+	float duration = (Frame->endTimeUs - Frame->startTimeUs) / 1000.0;
+
+	printf("Sweep %u: %5d samples  Angle: %7.2f to %7.2f degrees  Time: %6.1f ms  Temperature: %.2f degrees%s\n", Frame->sequence, Frame->sampleCount, startAngle, endAngle, duration, latestTemperature / 100.0, Frame->partial ? "  (partial)" : "");
+
+	if (closest != -1) {
+		printf("  Closest: %5d cm  Strength: %5d %%  Angle: %f degrees\n", Frame->distance[closest], Frame->strength[closest], Frame->yawAngle[closest] / 100.0);
+	}
 }
 
 //----------------------------------------------------------------------------------------------------------------------------------
@@ -42,13 +85,18 @@ int main(int args, char **argv)
 	
 	printf("LWNX sample\n");
 
-	// NOTE: Change the port name to the one assigned by the OS to the plugged in lidar.
+	// NOTE: Change the port name to the one assigned by the OS to the plugged in lidar, or pass it as the first argument,
+	// like the pseudo terminal of the emulator.
 #ifdef __linux__
 	const char* portName = "/dev/ttyUSB0";
 #else
 	const char* portName = "\\\\.\\COM10";
 #endif
 
+	if (args > 1) {
+		portName = argv[1];
+	}
+
 	int32_t baudRate = 921600;
 
 	lwSerialPort* serial = platformCreateSerialPort();
@@ -58,55 +106,58 @@ int main(int args, char **argv)
 
 	// NOTE: Find descriptions of each command here http://support.lightware.co.za/sf45b/#/commands
 
-	// Read the product name. (Command 0: Product name)
+	// Read the product information. The commands in a batch are sent back to back and their responses matched by command id,
+	// so the whole batch costs about one round trip.
 	char modelName[16];
-	if (!lwnxCmdReadString(serial, 0, modelName)) { exitCommandFailure(); }
-
-	// Read the hardware version. (Command 1: Hardware version)
 	uint32_t hardwareVersion;
-	if (!lwnxCmdReadUInt32(serial, 1, &hardwareVersion)) { exitCommandFailure(); }
+	uint32_t firmwareVersion;
+	char serialNumber[16];
+
+	lwCommand productInfo[4];
+	lwnxInitReadCommand(&productInfo[0], 0, (uint8_t*)modelName, 16);			// Command 0: Product name
+	lwnxInitReadCommand(&productInfo[1], 1, (uint8_t*)&hardwareVersion, 4);	// Command 1: Hardware version
+	lwnxInitReadCommand(&productInfo[2], 2, (uint8_t*)&firmwareVersion, 4);	// Command 2: Firmware version
+	lwnxInitReadCommand(&productInfo[3], 3, (uint8_t*)serialNumber, 16);		// Command 3: Serial number
+	if (!lwnxHandleManagedBatch(serial, productInfo, 4)) { exitCommandFailure(); }
 
-	// Read the firmware version. (Command 2: Firmware version)
-	uint32_t firmwareVersion;	
-	if (!lwnxCmdReadUInt32(serial, 2, &firmwareVersion)) { exitCommandFailure(); }
 	char firmwareVersionStr[16];
 	lwnxConvertFirmwareVersionToStr(firmwareVersion, firmwareVersionStr);
 
-	// Read the serial number. (Command 3: Serial number)
-	char serialNumber[16];
-	if (!lwnxCmdReadString(serial, 3, serialNumber)) { exitCommandFailure(); }
-
 	printf("Model: %.16s\n", modelName);
 	printf("Hardware: %d\n", hardwareVersion);
 	printf("Firmware: %.16s (%d)\n", firmwareVersionStr, firmwareVersion);
 	printf("Serial: %.16s\n", serialNumber);
 
 	// Set the output rate to 500 readings per second. (Command 66: Update rate)
-	if (!lwnxCmdWriteUInt8(serial, 66, 5)) { exitCommandFailure(); }
-
-	// Set distance output to include the following: (Command 27: Distance output)
-	// first return raw distance: 0
-	// first return strength: 2
-	// temperature: 7
-	// yaw angle: 8
-	if (!lwnxCmdWriteUInt32(serial, 27, 0x185)) { exitCommandFailure(); }
-	
+	uint8_t updateRate = 5;
+
+	// Set distance output to the fields decoded by distanceDecoder. (Command 27: Distance output)
+	uint32_t distanceOutput = distanceDecoder::mask;
+
+	lwCommand settings[2];
+	lwnxInitWriteCommand(&settings[0], 66, &updateRate, 1);
+	lwnxInitWriteCommand(&settings[1], 27, (uint8_t*)&distanceOutput, 4);
+	if (!lwnxHandleManagedBatch(serial, settings, 2)) { exitCommandFailure(); }
+
+	// Streamed point data packets are passed to the sweep assembler as they arrive, including while later commands wait for
+	// their responses, so no samples are lost when the sensor is reconfigured.
+	lwSweepAssembler* sweep = new lwSweepAssembler();
+	lwnxSetPacketHandler(serial, 44, handleDistance, sweep);
+
 	// Enable streaming of point data. (Command 30: Stream)
 	if (!lwnxCmdWriteUInt32(serial, 30, 5)) { exitCommandFailure(); }
 
-	// Continuously wait for and process the streamed point data packets.
-	// The incoming point data packet is Command 44: Distance data in cm.
+	// Continuously receive the streamed point data packets and print each completed sweep.
+	// NOTE: lwSweepAcquire can also be called from another thread, which then never sees a sweep still being filled.
 	while (1) {
-		lwResponsePacket response;
-		
-		if (lwnxRecvPacket(serial, 44, &response, 1000)) {
-			// NOTE: There is a 4 byte offset to account for the packet header.
-			uint16_t firstReturnRaw = readInt16(response.data, 4);
-			uint16_t firstReturnStrength = readInt16(response.data, 6);
-			float temperature = readInt16(response.data, 8) / 100.0;
-			float yawAngle = (((int16_t)readInt16(response.data, 10)) / 100.0);
-
-			printf("Distance: %5d cm  Strength: %5d %%  Temperature: %f degrees  Angle: %f degrees\n", firstReturnRaw, firstReturnStrength, temperature, yawAngle);
+		if (lwnxPoll(serial, 1000) == -1) {
+			exitWithMessage("Serial port failed\n");
+		}
+
+		lwSweepFrame* frame = lwSweepAcquire(sweep);
+
+		if (frame != NULL) {
+			printSweep(frame);
 		}
 	}
 
@@ -1,5 +1,7 @@
 #include "platformWin32.h"
 #include "lwSerialPortWin32.h"
+#include "../lwCapture.h"
+#include "../lwSerialPortReplay.h"
 
 static int64_t timeFrequency;
 static int64_t timeCounterStart;
@@ -26,8 +28,8 @@ int64_t platformGetMicrosecond() {
 	return (int64_t)(getTimeSeconds() * 1000000);
 }
 
-int32_t platformGetMillisecond() {
-	return (int32_t)(getTimeSeconds() * 1000);
+int64_t platformGetMillisecond() {
+	return (int64_t)(getTimeSeconds() * 1000);
 }
 
 bool platformSleep(int32_t TimeMS) {
@@ -35,6 +37,70 @@ bool platformSleep(int32_t TimeMS) {
 	return true;
 };
 
+// NOTE: Sleep has millisecond resolution, so the time is rounded up.
+bool platformSleepMicrosecond(int64_t TimeUs) {
+	if (TimeUs > 0) {
+		Sleep((DWORD)((TimeUs + 999) / 1000));
+	}
+
+	return true;
+}
+
+uint8_t* platformMapFile(const char* Path, uint64_t* Size, void** Handle) {
+	HANDLE file = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (file == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return 0;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	// NOTE: The mapping keeps the file open.
+	CloseHandle(file);
+
+	if (mapping == NULL) {
+		return 0;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (data == NULL) {
+		CloseHandle(mapping);
+		return 0;
+	}
+
+	*Size = fileSize.QuadPart;
+	*Handle = mapping;
+
+	return (uint8_t*)data;
+}
+
+void platformUnmapFile(uint8_t* Data, uint64_t Size, void* Handle) {
+	UnmapViewOfFile(Data);
+	CloseHandle((HANDLE)Handle);
+}
+
+// NOTE: Set LWNX_CAPTURE to a file name to record everything received, see lwCapture.h. Set LWNX_REPLAY to a capture to
+// play it back instead of connecting to a device, see lwSerialPortReplay.h.
 lwSerialPort* platformCreateSerialPort() {
-	return new lwSerialPortWin32();
+	const char* replayPath = getenv("LWNX_REPLAY");
+
+	if (replayPath != 0) {
+		return lwReplayCreateSerialPort(replayPath);
+	}
+
+	lwSerialPort* port = new lwSerialPortWin32();
+	const char* capturePath = getenv("LWNX_CAPTURE");
+
+	if (capturePath != 0) {
+		port = lwCaptureCreateSerialPort(port, capturePath);
+	}
+
+	return port;
 }
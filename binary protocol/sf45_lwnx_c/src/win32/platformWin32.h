@@ -12,7 +12,12 @@
 void platformInit();
 
 int64_t platformGetMicrosecond();
-int32_t platformGetMillisecond();
+int64_t platformGetMillisecond();
 bool platformSleep(int32_t TimeMS);
+bool platformSleepMicrosecond(int64_t TimeUs);
+
+// Maps a whole file read only. Returns its contents, or 0 if it can't be opened. Pass Handle to platformUnmapFile.
+uint8_t* platformMapFile(const char* Path, uint64_t* Size, void** Handle);
+void platformUnmapFile(uint8_t* Data, uint64_t Size, void* Handle);
 
 lwSerialPort* platformCreateSerialPort();
@@ -7,6 +7,7 @@
 #include <unistd.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdint.h>
 #include "time.h"
 
@@ -52,8 +53,9 @@ int portConnect(const char* Name, int BitRate) {
 	tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
 	tty.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
 	tty.c_oflag &= ~OPOST;
+	// NOTE: Reads return immediately, waiting for data is done with poll.
 	tty.c_cc[VMIN] = 0;
-	tty.c_cc[VTIME] = 1;
+	tty.c_cc[VTIME] = 0;
 
 	if (tcsetattr(result, TCSANOW, &tty) != 0) {
 		printf("Error from tcsetattr\n");
@@ -82,6 +84,15 @@ int portRead(int Serial, uint8_t* Buffer, int32_t BufferSize) {
 	return read(Serial, Buffer, BufferSize);
 }
 
+// Wait up to TimeoutMs for data to be available on the serial port.
+int portWait(int Serial, int32_t TimeoutMs) {
+	struct pollfd descriptor = {};
+	descriptor.fd = Serial;
+	descriptor.events = POLLIN;
+
+	return poll(&descriptor, 1, TimeoutMs);
+}
+
 //-------------------------------------------------------------------------
 // Main application.
 //-------------------------------------------------------------------------
@@ -109,13 +120,15 @@ int main(int args, char** argv) {
 		int byteH = 0;
 
 		while (true) {
-			// NOTE: This delay is just a temporary measure to prevent the loop from fully occupying the CPU.
-			// Ideally the rest of your program code would happen here. If the program requires waiting on the 
-			// serial port then you can use some form of select/poll that will not block the CPU.
-			usleep(1000);
+			// NOTE: Sleeps until data arrives instead of occupying the CPU. If the rest of your program code needs
+			// to run here as well then reduce the timeout, or wait on its other inputs in the same poll.
+			if (portWait(serial, 100) < 0) {
+				printf("Error waiting on serial port\n");
+				break;
+			}
 
 			uint8_t buffer[1024];
-			uint8_t r = portRead(serial, buffer, 1024);
+			int r = portRead(serial, buffer, 1024);
 
 			if (r == -1) {
 				printf("Error reading serial port\n");